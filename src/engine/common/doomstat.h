@@ -168,6 +168,12 @@ extern  dboolean    demorecording;
 // Quit after playing a demo from cmdline.
 extern  dboolean    singledemo;
 
+// Run a demo as fast as possible and report timings.
+extern  dboolean    timingdemo;
+
+// Don't render anything; no video is set up.
+extern  dboolean    nodrawers;
+
 extern  gamestate_t gamestate;
 
 
@@ -86,6 +86,10 @@ typedef    struct {
     short           special;
     short           tag;
 
+    // killough 1/30/98: improves searches for tags.
+    int             firsttag;
+    int             nexttag;
+
     // [d64] color indexes references for the lights lump
     short           colors[5];
 
@@ -182,6 +186,10 @@ typedef struct line_s {
     short           special;
     short           tag;
 
+    // killough 4/17/98: improves searches for tags.
+    int             firsttag;
+    int             nexttag;
+
     // Visual appearance: SideDefs.
     //  sidenum[1] will be -1 if one sided
     word            sidenum[2];
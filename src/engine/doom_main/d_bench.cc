@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <platform/app.hh>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "d_bench.h"
+
+namespace {
+  using Clock = std::chrono::steady_clock;
+
+  app::StringParam timedemo_json_param_("timedemojson");
+
+  struct BenchStat {
+      const char *name;
+      Clock::time_point start {};
+      Clock::duration accum {};
+      bool sampled {};
+      Vector<float> samples {};
+  };
+
+  BenchStat stats_[NUMBENCHSTATS] {
+      { "P_Ticker" },
+      { "R_RenderPlayerView" },
+      { "DL_ProcessDrawList" }
+  };
+
+  String demo_name_;
+  Clock::time_point wall_start_;
+  int start_tic_;
+
+  struct Summary {
+      size_t count {};
+      float min {};
+      float avg {};
+      float p99 {};
+      float max {};
+  };
+
+  String json_escape_(StringView str)
+  {
+      String out;
+
+      for (auto c : str) {
+          if (c == '"' || c == '\\')
+              out.push_back('\\');
+          out.push_back(c);
+      }
+
+      return out;
+  }
+
+  Summary summarize_(Vector<float>& samples)
+  {
+      Summary s;
+
+      if (samples.empty())
+          return s;
+
+      std::sort(samples.begin(), samples.end());
+
+      double total {};
+      for (auto x : samples)
+          total += x;
+
+      s.count = samples.size();
+      s.min = samples.front();
+      s.max = samples.back();
+      s.avg = static_cast<float>(total / samples.size());
+      s.p99 = samples[std::min(samples.size() - 1, (samples.size() * 99) / 100)];
+
+      return s;
+  }
+}
+
+//
+// D_BenchStart
+//
+
+void D_BenchStart(const char* demo) {
+    if(!timingdemo) {
+        return;
+    }
+
+    for(auto& stat : stats_) {
+        stat.accum = {};
+        stat.sampled = false;
+        stat.samples.clear();
+        stat.samples.reserve(TICRATE * 60 * 10);
+    }
+
+    demo_name_ = demo;
+    start_tic_ = gametic;
+    wall_start_ = Clock::now();
+}
+
+//
+// D_BenchBegin
+//
+
+void D_BenchBegin(benchstat_t stat) {
+    if(!timingdemo) {
+        return;
+    }
+
+    stats_[stat].start = Clock::now();
+}
+
+//
+// D_BenchEnd
+//
+
+void D_BenchEnd(benchstat_t stat) {
+    if(!timingdemo) {
+        return;
+    }
+
+    stats_[stat].accum += Clock::now() - stats_[stat].start;
+    stats_[stat].sampled = true;
+}
+
+//
+// D_BenchFrame
+//
+
+void D_BenchFrame(void) {
+    if(!timingdemo) {
+        return;
+    }
+
+    for(auto& stat : stats_) {
+        if(!stat.sampled) {
+            continue;
+        }
+
+        stat.samples.push_back(std::chrono::duration<float, std::milli>(stat.accum).count());
+        stat.accum = {};
+        stat.sampled = false;
+    }
+}
+
+//
+// D_BenchFinish
+// Prints the results and writes the JSON report
+//
+
+void D_BenchFinish(void) {
+    Summary summary[NUMBENCHSTATS];
+    double seconds;
+    int tics;
+    int i;
+
+    if(!timingdemo) {
+        return;
+    }
+
+    seconds = std::chrono::duration<double>(Clock::now() - wall_start_).count();
+    tics = gametic - start_tic_;
+
+    log::info("timedemo {}: {} tics in {:.3f} s ({:.1f} tics/s)",
+              demo_name_, tics, seconds, seconds > 0 ? tics / seconds : 0.0);
+
+    for(i = 0; i < NUMBENCHSTATS; i++) {
+        auto& s = summary[i];
+
+        s = summarize_(stats_[i].samples);
+        log::info("  {:<20} min {:7.3f} ms  avg {:7.3f} ms  p99 {:7.3f} ms  max {:7.3f} ms  ({} samples)",
+                  stats_[i].name, s.min, s.avg, s.p99, s.max, s.count);
+    }
+
+    String path = timedemo_json_param_ ? timedemo_json_param_.get() : "timedemo.json";
+    std::ofstream f(path);
+
+    f << fmt::format("{{\n  \"demo\": \"{}\",\n  \"nodraw\": {},\n  \"tics\": {},\n  \"seconds\": {:.6f},\n  \"stats\": {{\n",
+                     json_escape_(demo_name_), nodrawers ? "true" : "false", tics, seconds);
+
+    for(i = 0; i < NUMBENCHSTATS; i++) {
+        auto& s = summary[i];
+
+        f << fmt::format("    \"{}\": {{ \"samples\": {}, \"min_ms\": {:.6f}, \"avg_ms\": {:.6f}, "
+                         "\"p99_ms\": {:.6f}, \"max_ms\": {:.6f} }}{}\n",
+                         stats_[i].name, s.count, s.min, s.avg, s.p99, s.max,
+                         i + 1 < NUMBENCHSTATS ? "," : "");
+    }
+
+    f << "  }\n}\n";
+
+    if(!f.good()) {
+        log::warn("Couldn't write timedemo report to '{}'", path);
+        return;
+    }
+
+    log::info("Wrote timedemo report to '{}'", path);
+}
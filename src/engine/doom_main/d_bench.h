@@ -0,0 +1,24 @@
+// -*- mode: c++ -*-
+#ifndef __D_BENCH_H
+#define __D_BENCH_H
+
+//
+// Timedemo statistics. Sections are timed between D_BenchBegin and
+// D_BenchEnd, summed over a frame and sampled once per frame by
+// D_BenchFrame. All of these do nothing unless timingdemo is set.
+//
+
+typedef enum {
+    BS_TICKER,      // P_Ticker
+    BS_RENDER,      // R_RenderPlayerView
+    BS_DRAWLIST,    // DL_ProcessDrawList, all lists in a frame
+    NUMBENCHSTATS
+} benchstat_t;
+
+void D_BenchStart(const char* demo);
+void D_BenchBegin(benchstat_t stat);
+void D_BenchEnd(benchstat_t stat);
+void D_BenchFrame(void);
+void D_BenchFinish(void);
+
+#endif
@@ -34,6 +34,7 @@
 #include "z_zone.h"
 #include "gl_draw.h"
 #include "s_sound.h"
+#include "i_audio.h"
 #include "d_englsh.h"
 #include "r_drawlist.h"
 #include "i_video.h"
@@ -87,6 +88,10 @@ void D_DeveloperDisplay(void) {
     fixed_t px, py, pz, pa, pp;
     int y = 8;
     mobj_t* mo;
+    zonearenastats_t arenastats;
+    zonestats_t zonestats;
+    specialstats_t specialstats;
+    seqstats_t seqstats;
 
     if(!showstats) {
         glBindCalls = 0;
@@ -128,6 +133,16 @@ void D_DeveloperDisplay(void) {
     Draw_Text(0, y, WHITE, 0.35f, false, "Zone PU_AUTO Usage: %8d kb", Z_TagUsage(PU_AUTO) >> 10);
     y+=16;
 
+    Z_ArenaStats(&arenastats);
+    Draw_Text(0, y, WHITE, 0.35f, false, "Zone Level Arena: %d/%d kb (%d kb recycled, %d chunks)",
+              arenastats.used >> 10, arenastats.reserved >> 10, arenastats.recycled >> 10, arenastats.chunks);
+    y+=16;
+
+    Z_Stats(&zonestats);
+    Draw_Text(0, y, WHITE, 0.35f, false, "Zone Allocs/Tic: %d (%d kb), Peak: %d kb",
+              zonestats.ticallocs, zonestats.ticbytes >> 10, zonestats.peak >> 10);
+    y+=16;
+
     /*DRAW LIST INFORMATION*/
     Draw_Text(0, y, WHITE, 0.35f, false, "Draw List WALL Usage: %6d kb", DL_GetDrawListSize(DLT_WALL) >> 10);
     y+=16;
@@ -158,6 +173,11 @@ void D_DeveloperDisplay(void) {
 
         Draw_Text(0, y, WHITE, 0.35f, false, "P_Mobj Total Things: %i", p_nummobjthinkers);
         y+=16;
+
+        P_SpecialStats(&specialstats);
+        Draw_Text(0, y, WHITE, 0.35f, false, "P_Spec Scrolling Flats: %i, Walls: %i, Buttons: %i",
+                  specialstats.scrollsectors, specialstats.scrolllines, specialstats.buttons);
+        y+=16;
     }
 
     /*RENDERING INFORMATION*/
@@ -188,6 +208,16 @@ void D_DeveloperDisplay(void) {
     Draw_Text(0, y, WHITE, 0.35f, false, "Active Sounds: %i", S_GetActiveSounds());
     y+=16;
 
+    I_GetSequencerStats(&seqstats);
+    sevclr = seqstats.backlog ? YELLOW : WHITE;
+    Draw_Text(0, y, sevclr, 0.35f, false, "Audio Queue: %i (peak %i, backlog %i), %i cmds/s",
+              seqstats.depth, seqstats.peakdepth, seqstats.backlog, seqstats.commands);
+    y+=16;
+
+    Draw_Text(0, y, WHITE, 0.35f, false, "Audio Command Latency: %ius (max %ius)",
+              seqstats.latency, seqstats.maxlatency);
+    y+=16;
+
     Draw_Text(0, y, WHITE, 0.35f, false, "Mouse Cursor: %i, %i", mouse_x, mouse_y);
     y+=16;
 
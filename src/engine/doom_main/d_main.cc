@@ -58,6 +58,7 @@
 #include "d_main.h"
 #include "con_console.h"
 #include "d_devstat.h"
+#include "d_bench.h"
 #include "r_local.h"
 #include "r_wipe.h"
 #include "g_controls.h"
@@ -67,6 +68,8 @@
 #include "logger.hh"
 
 #include "net_client.h"
+#include "net_dedicated.h"
+#include "net_query.h"
 #include <wad.hh>
 #include <imp/NativeUI>
 
@@ -94,6 +97,7 @@ dboolean        setWindow       = true;
 int             validcount      = 1;
 dboolean        windowpause     = false;
 dboolean        devparm         = false;    // started game with -devparm
+dboolean        nodrawers       = false;    // -nodraw: timedemo without video
 dboolean        nomonsters      = false;    // checkparm of -nomonsters
 dboolean        respawnparm     = false;    // checkparm of -respawn
 dboolean        respawnitem     = false;    // checkparm of -respawnitem
@@ -254,6 +258,13 @@ int D_MiniLoop(void (*start)(void), void (*stop)(void),
         int realtics = 0;
         int availabletics = 0;
         int counts = 0;
+        dboolean interpolate;
+        dboolean skipdraw;
+
+        // timedemos and demo seeks run a single tic per frame with
+        // nothing in between
+        interpolate = i_interpolateframes && !timingdemo && !G_DemoSeeking();
+        skipdraw = nodrawers || G_DemoSeeking();
 
         windowpause = (menuactive ? true : false);
 
@@ -264,7 +275,7 @@ int D_MiniLoop(void (*start)(void), void (*stop)(void),
         realtics = entertic - oldentertics;
         oldentertics = entertic;
 
-        if(i_interpolateframes) {
+        if(interpolate) {
             renderinframe = true;
 
             if(I_StartDisplay()) {
@@ -358,7 +369,7 @@ int D_MiniLoop(void (*start)(void), void (*stop)(void),
                 I_Error("D_MiniLoop: lowtic < gametic");
             }
 
-            if(i_interpolateframes) {
+            if(interpolate) {
                 renderinframe = true;
 
                 if(I_StartDisplay()) {
@@ -396,7 +407,7 @@ int D_MiniLoop(void (*start)(void), void (*stop)(void),
                     I_Error("gametic>lowtic");
                 }
 
-                if(i_interpolateframes) {
+                if(interpolate) {
                     I_GetTime_SaveMS();
                 }
 
@@ -437,17 +448,24 @@ int D_MiniLoop(void (*start)(void), void (*stop)(void),
         S_UpdateSounds();
 
         // Update display, next frame, with current state.
-        if(i_interpolateframes) {
+        if(interpolate) {
             if(!I_StartDisplay()) {
                 goto freealloc;
             }
         }
 
-        if(draw && !action) {
-            draw();
+        if(skipdraw) {
+            NetUpdate();
+        }
+        else {
+            if(draw && !action) {
+                draw();
+            }
+            D_DrawInterface();
+            D_FinishDraw();
         }
-        D_DrawInterface();
-        D_FinishDraw();
+
+        D_BenchFrame();
 
     freealloc:
 
@@ -963,6 +981,13 @@ static int D_CheckDemo(void) {
         return 1;
     }
 
+    p = M_CheckParm("-timedemo");
+    if(p && p < myargc-1) {
+        singledemo = true;              // quit after one demo
+        G_PlayDemo(myargv[p+1]);
+        return 1;
+    }
+
     return 0;
 }
 
@@ -977,6 +1002,8 @@ namespace imp {
 [[noreturn]]
 void D_DoomMain(void) {
     devparm = M_CheckParm("-devparm");
+    timingdemo = M_CheckParm("-timedemo");
+    nodrawers = timingdemo && M_CheckParm("-nodraw");
 
     {
         // init subsystems
@@ -989,6 +1016,34 @@ void D_DoomMain(void) {
         I_Printf("Z_Init: Init Zone Memory Allocator\n");
         Z_Init();
 
+        //!
+        // @category net
+        //
+        // Start a dedicated server, routing packets but not participating
+        // in the game itself.
+        //
+
+        if(M_CheckParm("-dedicated") > 0) {
+            I_Printf("Dedicated server mode.\n");
+            NET_DedicatedServer();
+        }
+
+        //!
+        // @arg <address>
+        // @category net
+        //
+        // Print round trip times, resend counts and packet rates for
+        // each client of the server at the given address.
+        //
+
+        {
+            int p = M_CheckParm("-querystats");
+
+            if(p > 0 && p < myargc - 1) {
+                NET_QueryStats(myargv[p + 1]);
+            }
+        }
+
         I_Printf("CON_Init: Init Game Console\n");
         CON_Init();
 
@@ -1031,8 +1086,10 @@ void D_DoomMain(void) {
         I_Printf("ST_Init: Init status bar.\n");
         ST_Init();
 
-        I_Printf("GL_Init: Init OpenGL\n");
-        GL_Init();
+        if(!nodrawers) {
+            I_Printf("GL_Init: Init OpenGL\n");
+            GL_Init();
+        }
 
         native_ui::console_show(false);
 
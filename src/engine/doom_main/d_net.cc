@@ -38,6 +38,7 @@
 #include "con_console.h"
 #include "SDL.h"
 #include "i_video.h"
+#include "g_demo.h"
 
 #define FEATURE_MULTIPLAYER 1
 
@@ -86,6 +87,11 @@ dboolean renderinframe = false;
 static int GetAdjustedTime(void) {
     int time_ms;
 
+    // timedemos and demo seeks always have the next tic ready
+    if(timingdemo || G_DemoSeeking()) {
+        return gametic + ticdup;
+    }
+
     time_ms = I_GetTimeMS();
 
     if(net_cl_new_sync) {
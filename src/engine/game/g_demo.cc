@@ -34,6 +34,11 @@
 #include "m_misc.h"
 #include "m_random.h"
 #include "con_console.h"
+#include "p_saveg.h"
+#include "p_setup.h"
+#include "am_map.h"
+#include "s_sound.h"
+#include "d_bench.h"
 
 #ifdef _MSVC_VER
 #include "i_opndir.h"
@@ -44,6 +49,7 @@
 #endif
 
 void        G_DoLoadLevel(void);
+void        D_StartGameLoop(void);
 dboolean    G_CheckDemoStatus(void);
 void        G_ReadDemoTiccmd(ticcmd_t* cmd);
 void        G_WriteDemoTiccmd(ticcmd_t* cmd);
@@ -57,6 +63,7 @@ dboolean        netdemo         = false;
 byte*           demobuffer;
 byte*           demoend;
 dboolean        singledemo      = false;    // quit after playing a demo from cmdline
+dboolean        timingdemo      = false;    // -timedemo: run flat out and report timings
 dboolean        endDemo;
 dboolean        iwadDemo        = false;
 
@@ -212,6 +219,196 @@ void G_RecordDemo(const char* name) {
     G_CheckDemoStatus();
 }
 
+//
+// DEMO SEEKING
+//
+// While a demo plays back the world is snapshotted every few seconds.
+// Seeking restores the closest snapshot at or before the wanted tic and
+// then runs the game forward without drawing until it gets there.
+//
+
+IntCvar p_demosnapshot("p_demosnapshot", "Seconds between demo playback snapshots (0 disables seeking)", 10);
+
+typedef struct {
+    int     tic;        // demo tics played before the snapshot
+    int     offset;     // position in the demo stream
+    int     length;
+    byte*   data;
+} demosnapshot_t;
+
+static demosnapshot_t*  demosnapshots;
+static int              numdemosnapshots;
+static int              maxdemosnapshots;
+
+static int              demorestore = -1;   // snapshot to load at the start of the next tic
+
+static int              demotic;            // tics read from the demo so far
+static int              demoseektic = -1;   // tic being fast forwarded to, or -1
+
+//
+// G_ClearDemoSnapshots
+//
+
+static void G_ClearDemoSnapshots(void) {
+    int i;
+
+    for(i = 0; i < numdemosnapshots; i++) {
+        Z_Free(demosnapshots[i].data);
+    }
+
+    // the clock ran ahead of real time if a seek was cut short
+    if(demoseektic >= 0) {
+        D_StartGameLoop();
+    }
+
+    numdemosnapshots = 0;
+    demorestore = -1;
+    demotic = 0;
+    demoseektic = -1;
+}
+
+//
+// G_DemoRestore
+// Loads the snapshot picked by G_DemoSeek in place of the running level
+//
+
+static void G_DemoRestore(void) {
+    demosnapshot_t* snap;
+    int map;
+
+    snap = &demosnapshots[demorestore];
+    demorestore = -1;
+    map = gamemap;
+
+    // tear the level down the way P_Stop would
+    S_ResetSound();
+
+    if(automapactive) {
+        AM_Stop();
+    }
+
+    Z_FreeTags(PU_LEVEL, PU_PURGELEVEL-1);
+
+    if(!P_ReadSnapshot(snap->data, snap->length)) {
+        I_Error("G_DemoRestore: couldn't restore snapshot at tic %i", snap->tic);
+    }
+
+    if(gamemap != map) {
+        S_StartMusic(P_GetMapInfo(gamemap)->music);
+    }
+
+    demo_p = demobuffer + snap->offset;
+    demotic = snap->tic;
+}
+
+//
+// G_DemoTicker
+// Called at the start of every tic that reads a demo ticcmd
+//
+
+void G_DemoTicker(void) {
+    demosnapshot_t* snap;
+    int interval;
+
+    if(demorestore >= 0) {
+        // the level may have ended since the seek was asked for
+        if(gamestate == GS_LEVEL) {
+            G_DemoRestore();
+        }
+        else {
+            demorestore = -1;
+        }
+    }
+
+    interval = *p_demosnapshot * TICRATE;
+
+    if(interval > 0 && !iwadDemo && !timingdemo && gamestate == GS_LEVEL) {
+        // after a rewind the snapshots ahead are already taken
+        if(!numdemosnapshots ||
+                demotic - demosnapshots[numdemosnapshots - 1].tic >= interval) {
+            if(numdemosnapshots == maxdemosnapshots) {
+                maxdemosnapshots = maxdemosnapshots ? maxdemosnapshots * 2 : 64;
+                demosnapshots = (demosnapshot_t*)Z_Realloc(demosnapshots,
+                                sizeof(demosnapshot_t) * maxdemosnapshots, PU_STATIC, 0);
+            }
+
+            snap = &demosnapshots[numdemosnapshots++];
+            snap->tic = demotic;
+            snap->offset = demo_p - demobuffer;
+            snap->data = P_WriteSnapshot(&snap->length);
+        }
+    }
+
+    if(demoseektic >= 0 && demotic >= demoseektic) {
+        demoseektic = -1;
+
+        // the clock ran ahead of real time while seeking
+        D_StartGameLoop();
+    }
+
+    demotic++;
+}
+
+//
+// G_DemoSeek
+// Jumps demo playback to the given tic
+//
+
+void G_DemoSeek(int tic) {
+    int snap;
+    int i;
+
+    if(!demoplayback || iwadDemo || gameaction != ga_nothing) {
+        return;
+    }
+
+    if(tic < 0) {
+        tic = 0;
+    }
+
+    snap = -1;
+    for(i = 0; i < numdemosnapshots; i++) {
+        if(demosnapshots[i].tic > tic) {
+            break;
+        }
+
+        snap = i;
+    }
+
+    // going back needs a snapshot; going forward only uses one if it
+    // skips ahead of where playback already is
+    if(tic < demotic) {
+        if(snap < 0) {
+            return;
+        }
+
+        demorestore = snap;
+    }
+    else if(snap >= 0 && demosnapshots[snap].tic > demotic) {
+        demorestore = snap;
+    }
+
+    demoseektic = tic;
+    S_ResetSound();
+}
+
+//
+// G_DemoTic
+// Where playback is, or is heading if a seek is in progress
+//
+
+int G_DemoTic(void) {
+    return demoseektic >= 0 ? demoseektic : demotic;
+}
+
+//
+// G_DemoSeeking
+//
+
+dboolean G_DemoSeeking(void) {
+    return demoseektic >= 0;
+}
+
 //
 // G_PlayDemo
 //
@@ -225,6 +422,10 @@ void G_PlayDemo(const char* name) {
     endDemo = false;
 
     p = M_CheckParm("-playdemo");
+    if(!p) {
+        p = M_CheckParm("-timedemo");
+    }
+
     if(p && p < myargc-1) {
         // 20120107 bkw: add .lmp extension if missing.
         if(dstrrchr(myargv[p+1], '.')) {
@@ -313,6 +514,9 @@ void G_PlayDemo(const char* name) {
     usergame = false;
     demoplayback = true;
 
+    G_ClearDemoSnapshots();
+    D_BenchStart(p && p < myargc-1 ? filename : name);
+
     G_RunGame();
     iwadDemo = false;
 }
@@ -334,10 +538,16 @@ dboolean G_CheckDemoStatus(void) {
     }
 
     if(demoplayback) {
+        if(timingdemo) {
+            D_BenchFinish();
+        }
+
         if(singledemo) {
             I_Quit();
         }
 
+        G_ClearDemoSnapshots();
+
         netdemo         = false;
         netgame         = false;
         deathmatch      = false;
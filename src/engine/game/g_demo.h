@@ -32,6 +32,10 @@ void G_RecordDemo(const char* name);
 void G_PlayDemo(const char* name);
 void G_ReadDemoTiccmd(ticcmd_t* cmd);
 void G_WriteDemoTiccmd(ticcmd_t* cmd);
+void G_DemoTicker(void);
+void G_DemoSeek(int tic);
+int G_DemoTic(void);
+dboolean G_DemoSeeking(void);
 
 extern char             demoname[256];  // name of demo lump
 extern dboolean         demorecording;  // currently recording a demo
@@ -41,6 +45,7 @@ extern byte*            demobuffer;
 extern byte*            demo_p;
 extern byte*            demoend;
 extern dboolean         singledemo;
+extern dboolean         timingdemo;     // benchmark: play as fast as possible
 extern dboolean         endDemo;        // signal recorder to stop on next tick
 extern dboolean         iwadDemo;       // hide hud, end playback after one level
 
@@ -32,6 +32,7 @@
 #include "doomdef.h"
 #include "doomstat.h"
 #include "z_zone.h"
+#include "net_packet.h"
 #include "f_finale.h"
 #include "m_misc.h"
 #include "m_menu.h"
@@ -967,6 +968,13 @@ dboolean G_Responder(event_t* ev) {
         }
 
         if(demoplayback && gameaction == ga_nothing) {
+            // seek through the demo, ten seconds at a time
+            if(ev->type == ev_keydown && !iwadDemo &&
+                    (ev->data1 == KEY_LEFTARROW || ev->data1 == KEY_RIGHTARROW)) {
+                G_DemoSeek(G_DemoTic() + (ev->data1 == KEY_LEFTARROW ? -10 : 10) * TICRATE);
+                return true;
+            }
+
             if(ev->type == ev_keydown ||
                     ev->type == ev_gamepad) {
                 G_CheckDemoStatus();
@@ -1039,6 +1047,10 @@ void G_Ticker(void) {
         basetic++;    // For tracers and RNG -- we must maintain sync
     }
     else {
+        if(demoplayback && gameaction == ga_nothing) {
+            G_DemoTicker();
+        }
+
         // get commands, check consistency,
         // and build new consistency check
         buf = (gametic / ticdup) % BACKUPTICS;
@@ -1628,6 +1640,8 @@ void G_Init(void) {
     G_AddCommand("setcamerachase", CMD_PlayerCamera, 1);
     G_AddCommand("enddemo", CMD_EndDemo, 0);
     AM_RegisterCommands();
+    Z_RegisterCommands();
+    NET_RegisterCommands();
 }
 
 //
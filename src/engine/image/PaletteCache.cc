@@ -1,3 +1,4 @@
+#include <mutex>
 #include <unordered_map>
 
 #include "PaletteCache.hh"
@@ -17,6 +18,9 @@ using HashMap = std::unordered_map<Key, T, Hash, KeyEq>;
 namespace {
   HashMap<String, Palette> palettes_;
 
+  // Textures are decoded on the thread pool
+  std::mutex palettes_lock_;
+
   Palette default_palette_()
   {
       static Palette data {};
@@ -34,6 +38,8 @@ namespace {
 
 Palette cache::palette(StringView name)
 {
+    std::lock_guard<std::mutex> lock(palettes_lock_);
+
     auto sname = name.to_string();
     auto it = palettes_.find(sname);
     if (it != palettes_.cend())
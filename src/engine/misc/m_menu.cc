@@ -3389,23 +3389,22 @@ void M_LoadGame(int choice) {
 // Read the strings from the savegame files
 //
 void M_ReadSaveStrings(void) {
-    int     handle;
     int     i;
-    // char    name[256];
+    char*   name;
 
     for(i = 0; i < load_end; i++) {
-        // sprintf(name, SAVEGAMENAME"%d.dsg", i);
+        // the description is inside the (possibly compressed) archive
+        name = P_GetSaveGameName(i);
 
-        // handle = open(name, O_RDONLY | 0, 0666);
-        handle = open(P_GetSaveGameName(i), O_RDONLY | 0, 0666);
-        if(handle == -1) {
+        if(!name || !M_FileExists(name) || !P_ReadSaveDescription(name, savegamestrings[i])) {
             dstrcpy(&savegamestrings[i][0],EMPTYSTRING);
             DoomLoadMenu[i].status = 0;
-            continue;
         }
-        read(handle, &savegamestrings[i], MENUSTRINGSIZE);
-        close(handle);
-        DoomLoadMenu[i].status = 1;
+        else {
+            DoomLoadMenu[i].status = 1;
+        }
+
+        free(name);
     }
 }
 
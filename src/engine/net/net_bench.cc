@@ -0,0 +1,1030 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+// DESCRIPTION:
+//      Loopback network benchmark.  Runs a server and several simulated
+//      clients in one process, joined by in-memory links that can drop,
+//      reorder and delay packets, and reports tic throughput, resends,
+//      window stalls and input latency.
+//
+//      Time is simulated: the clock advances one millisecond per step,
+//      so a run is repeatable for a given seed and does not sleep.
+//
+//-----------------------------------------------------------------------------
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <imp/NativeUI>
+
+#include "doomdef.h"
+#include "d_net.h"
+#include "i_system.h"
+#include "m_misc.h"
+#include "con_console.h"
+#include "g_actions.h"
+#include "net_common.h"
+#include "net_defs.h"
+#include "net_packet.h"
+#include "net_server.h"
+#include "net_structrw.h"
+
+#define TICTIME (1000 / TICRATE)
+
+// Clients stop making tics this far ahead of the server, as d_net does
+
+#define MAXLAG (BACKUPTICS / 2 - 1)
+
+// Extra delay for a packet picked to be reordered, so that later
+// packets overtake it
+
+#define REORDER_DELAY (TICTIME * 2)
+
+typedef int benchstate_t;
+enum
+{
+    BENCH_CONNECTING,
+    BENCH_WAITING_START,
+    BENCH_IN_GAME,
+};
+
+typedef struct
+{
+    dboolean active;
+    int seq;
+    int time;
+    net_ticdiff_t cmd;
+} bench_send_t;
+
+typedef struct
+{
+    dboolean active;
+    int resend_time;
+} bench_recv_t;
+
+typedef struct
+{
+    int index;
+    char name[16];
+    benchstate_t state;
+    net_connection_t connection;
+
+    net_addr_t server_addr;     // the server, as this client sends to it
+    net_addr_t client_addr;     // this client, as the server sees it
+
+    int last_syn_time;
+    int num_players;
+    dboolean controller;
+    dboolean sent_start;
+    int extratics;
+    int features;
+
+    int maketic;
+    ticcmd_t last_ticcmd;
+    bench_send_t send_queue[BACKUPTICS];
+
+    int recvwindow_start;
+    bench_recv_t recvwindow[BACKUPTICS];
+    dboolean need_to_acknowledge;
+    int gamedata_recv_time;
+
+    // statistics
+
+    int stalls;
+    int resend_requests;
+    int resends;
+    int latency_count;
+    long long latency_total;
+    int latency_max;
+
+    // as counted by the server
+
+    int server_resend_requests;
+    int server_resends;
+} bench_client_t;
+
+typedef struct
+{
+    net_packet_t *packet;
+    net_addr_t *from;
+    bench_client_t *to;         // NULL when bound for the server
+    int deliver_time;
+} bench_inflight_t;
+
+static int bench_time;
+
+static int num_clients = 4;
+static int num_tics = TICRATE * 120;
+static int link_delay = 20;
+static int link_jitter = 0;
+static int link_loss = 0;
+static int link_reorder = 0;
+static int extratics = 1;
+
+static net_server_t *server;
+static bench_client_t clients[MAXPLAYERS];
+
+static bench_inflight_t *inflight;
+static int num_inflight;
+static int max_inflight;
+
+static int packets_sent;
+static long long bytes_sent;
+static int packets_dropped;
+static int packets_reordered;
+
+//-----------------------------------------------------------------------------
+//
+// Engine services used by the net code
+//
+//-----------------------------------------------------------------------------
+
+int myargc;
+char **myargv;
+
+int M_CheckParm(const char *check)
+{
+    int i;
+
+    for (i=1; i<myargc; ++i)
+    {
+        if (!strcasecmp(check, myargv[i]))
+            return i;
+    }
+
+    return 0;
+}
+
+int I_GetTimeMS(void)
+{
+    return bench_time;
+}
+
+void I_Sleep(unsigned long usecs)
+{
+    bench_time += usecs;
+}
+
+void *(Z_Malloc)(int size, int tag, void *user, const char *file, int line)
+{
+    return malloc(size);
+}
+
+void CON_Printf(rcolor clr, const char *s, ...)
+{
+}
+
+void G_AddCommand(const char *name, actionproc_t proc, int64 data)
+{
+}
+
+void NET_CL_Run(void)
+{
+}
+
+void imp::native_ui::console_add_line(StringView message)
+{
+}
+
+//-----------------------------------------------------------------------------
+//
+// Links
+//
+//-----------------------------------------------------------------------------
+
+// Loss, jitter and reordering only start once a client is in the game.
+// The connection handshake has no retries for a lost ACK, and the
+// benchmark is about game data anyway.
+
+static void BenchLink_Queue(net_packet_t *packet, net_addr_t *from,
+                            bench_client_t *to)
+{
+    bench_inflight_t *p;
+    bench_client_t *c;
+    int delay;
+
+    ++packets_sent;
+    bytes_sent += packet->len;
+
+    c = to != NULL ? to : (bench_client_t *) from->handle;
+    delay = link_delay;
+
+    if (c->state == BENCH_IN_GAME)
+    {
+        if (rand() % 100 < link_loss)
+        {
+            ++packets_dropped;
+            return;
+        }
+
+        if (link_jitter > 0)
+            delay += rand() % (link_jitter + 1);
+
+        if (rand() % 100 < link_reorder)
+        {
+            delay += REORDER_DELAY;
+            ++packets_reordered;
+        }
+    }
+
+    if (num_inflight == max_inflight)
+    {
+        max_inflight = max_inflight ? max_inflight * 2 : 256;
+        inflight = (bench_inflight_t *) realloc(inflight,
+                                   max_inflight * sizeof(bench_inflight_t));
+    }
+
+    p = &inflight[num_inflight++];
+    p->packet = NET_PacketDup(packet);
+    p->from = from;
+    p->to = to;
+    p->deliver_time = bench_time + delay;
+}
+
+static void BenchClient_Packet(bench_client_t *c, net_packet_t *packet);
+
+static void BenchLink_Deliver(void)
+{
+    bench_inflight_t p;
+    int i, j;
+
+    // Deliver in send order among packets that are due, keeping the
+    // rest in place
+
+    for (i=0, j=0; i<num_inflight; ++i)
+    {
+        if (inflight[i].deliver_time > bench_time)
+        {
+            inflight[j++] = inflight[i];
+            continue;
+        }
+
+        p = inflight[i];
+
+        if (p.to == NULL)
+        {
+            NET_SV_ServerPacket(server, p.packet, p.from);
+        }
+        else
+        {
+            BenchClient_Packet(p.to, p.packet);
+        }
+
+        NET_FreePacket(p.packet);
+    }
+
+    num_inflight = j;
+}
+
+//-----------------------------------------------------------------------------
+//
+// Network module for the links.  Every client has two addresses: the one
+// it sends to, and the one the server sees it as.
+//
+//-----------------------------------------------------------------------------
+
+static net_addr_t monitor_addr;
+
+static dboolean BenchModule_Init(void)
+{
+    return true;
+}
+
+static void BenchModule_ParseStats(net_packet_t *packet)
+{
+    net_clientstats_t stats;
+    unsigned int packet_type;
+    unsigned int count;
+    unsigned int i;
+    int j;
+
+    if (!NET_ReadInt16(packet, &packet_type)
+     || packet_type != NET_PACKET_TYPE_STATS_RESPONSE
+     || !NET_ReadInt8(packet, &count))
+    {
+        return;
+    }
+
+    for (i=0; i<count; ++i)
+    {
+        if (!NET_ReadClientStats(packet, &stats))
+            break;
+
+        for (j=0; j<num_clients; ++j)
+        {
+            if (!strcmp(stats.name, clients[j].name))
+            {
+                clients[j].server_resend_requests = stats.resends_requested;
+                clients[j].server_resends = stats.resends_served;
+            }
+        }
+    }
+}
+
+static void BenchModule_SendPacket(net_addr_t *addr, net_packet_t *packet)
+{
+    bench_client_t *c;
+
+    if (addr == &monitor_addr)
+    {
+        // Stats are read straight away, with a read position of our own
+
+        net_packet_t *reply = NET_PacketDup(packet);
+
+        BenchModule_ParseStats(reply);
+        NET_FreePacket(reply);
+        return;
+    }
+
+    c = (bench_client_t *) addr->handle;
+
+    if (addr == &c->server_addr)
+    {
+        BenchLink_Queue(packet, &c->client_addr, NULL);
+    }
+    else
+    {
+        BenchLink_Queue(packet, &c->server_addr, c);
+    }
+}
+
+static dboolean BenchModule_RecvPacket(net_addr_t **addr, net_packet_t **packet)
+{
+    // Packets are pushed to their receivers by BenchLink_Deliver
+
+    return false;
+}
+
+static void BenchModule_AddrToString(net_addr_t *addr, char *buffer, int buffer_len)
+{
+    if (addr == &monitor_addr)
+    {
+        snprintf(buffer, buffer_len, "monitor");
+    }
+    else
+    {
+        snprintf(buffer, buffer_len, "bench client %i",
+                 ((bench_client_t *) addr->handle)->index);
+    }
+}
+
+static void BenchModule_FreeAddress(net_addr_t *addr)
+{
+}
+
+static net_addr_t *BenchModule_ResolveAddress(char *address)
+{
+    return NULL;
+}
+
+static net_module_t bench_module =
+{
+    BenchModule_Init,
+    BenchModule_Init,
+    BenchModule_SendPacket,
+    BenchModule_RecvPacket,
+    BenchModule_AddrToString,
+    BenchModule_FreeAddress,
+    BenchModule_ResolveAddress,
+    NULL,
+};
+
+//-----------------------------------------------------------------------------
+//
+// Simulated clients.  These speak the same protocol as net_client.cc,
+// feeding it random ticcmds instead of player input.
+//
+//-----------------------------------------------------------------------------
+
+// -nocompacttics turns the compact encoding off at both ends
+
+static int BenchClient_Features(void)
+{
+    return M_CheckParm("-nocompacttics") > 0 ? 0 : NET_FEATURE_COMPACT_TICS;
+}
+
+static void BenchClient_SendSYN(bench_client_t *c)
+{
+    net_packet_t *packet;
+    md5_digest_t md5sum;
+
+    memset(md5sum, 0, sizeof(md5sum));
+
+    packet = NET_NewPacket(32);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_SYN);
+    NET_WriteInt32(packet, NET_MAGIC_NUMBER);
+    NET_WriteString(packet, "Doom64EX");
+    NET_WriteInt8(packet, 0);
+    NET_WriteMD5Sum(packet, md5sum);
+    NET_WriteString(packet, c->name);
+    NET_WriteInt8(packet, BenchClient_Features());
+    NET_Conn_SendPacket(&c->connection, packet);
+    NET_FreePacket(packet);
+
+    c->last_syn_time = bench_time;
+}
+
+static void BenchClient_SendGameStart(bench_client_t *c)
+{
+    net_gamesettings_t settings;
+    net_packet_t *packet;
+
+    memset(&settings, 0, sizeof(settings));
+    settings.ticdup = 1;
+    settings.extratics = extratics;
+    settings.map = 1;
+    settings.skill = 2;
+    settings.new_sync = 1;
+
+    packet = NET_Conn_NewReliable(&c->connection, NET_PACKET_TYPE_GAMESTART);
+    NET_WriteSettings(packet, &settings);
+
+    c->sent_start = true;
+}
+
+static int BenchClient_Latency(bench_client_t *c)
+{
+    if (c->latency_count == 0)
+        return 0;
+
+    return (int) (c->latency_total / c->latency_count);
+}
+
+static void BenchClient_SendTics(bench_client_t *c, int start, int end)
+{
+    net_full_ticcmd_t cmds[256];
+    net_packet_t *packet;
+    int i;
+
+    if (start < 0)
+        start = 0;
+
+    packet = NET_NewPacket(512);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA);
+    NET_WriteInt8(packet, c->recvwindow_start & 0xff);
+    NET_WriteInt8(packet, start & 0xff);
+    NET_WriteInt8(packet, end - start + 1);
+
+    if (c->features & NET_FEATURE_COMPACT_TICS)
+    {
+        memset(cmds, 0, sizeof(net_full_ticcmd_t) * (end - start + 1));
+
+        for (i=start; i<=end; ++i)
+        {
+            cmds[i - start].latency = BenchClient_Latency(c);
+            cmds[i - start].playeringame[0] = true;
+            cmds[i - start].cmds[0] = c->send_queue[i % BACKUPTICS].cmd;
+        }
+
+        NET_WriteCompactTiccmds(packet, cmds, end - start + 1);
+    }
+    else
+    {
+        for (i=start; i<=end; ++i)
+        {
+            NET_WriteInt16(packet, BenchClient_Latency(c));
+            NET_WriteTiccmdDiff(packet, &c->send_queue[i % BACKUPTICS].cmd, 0);
+        }
+    }
+
+    NET_Conn_SendPacket(&c->connection, packet);
+    NET_FreePacket(packet);
+
+    c->need_to_acknowledge = false;
+}
+
+static void BenchClient_SendAck(bench_client_t *c)
+{
+    net_packet_t *packet;
+
+    packet = NET_NewPacket(10);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA_ACK);
+    NET_WriteInt8(packet, c->recvwindow_start & 0xff);
+    NET_Conn_SendPacket(&c->connection, packet);
+    NET_FreePacket(packet);
+
+    c->need_to_acknowledge = false;
+}
+
+static void BenchClient_SendResendRequest(bench_client_t *c, int start, int end)
+{
+    net_packet_t *packet;
+    int index;
+    int i;
+
+    packet = NET_NewPacket(16);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_GAMEDATA_RESEND);
+    NET_WriteInt32(packet, start);
+    NET_WriteInt8(packet, end - start + 1);
+    NET_Conn_SendPacket(&c->connection, packet);
+    NET_FreePacket(packet);
+
+    ++c->resend_requests;
+
+    for (i=start; i<=end; ++i)
+    {
+        index = i - c->recvwindow_start;
+
+        if (index >= 0 && index < BACKUPTICS)
+            c->recvwindow[index].resend_time = bench_time;
+    }
+}
+
+// Make a random ticcmd, as if the player were moving about: keys are
+// held for a while, turning comes in short bursts
+
+static void BenchClient_MakeTic(bench_client_t *c)
+{
+    bench_send_t *sendobj;
+    ticcmd_t cmd;
+
+    cmd = c->last_ticcmd;
+
+    if (rand() % 10 == 0)
+        cmd.forwardmove = ((rand() % 3) - 1) * 50;
+    if (rand() % 10 == 0)
+        cmd.sidemove = ((rand() % 3) - 1) * 40;
+    if (rand() % 4 == 0)
+        cmd.angleturn = rand() % 3 == 0 ? (rand() % 1024) - 512 : 0;
+    if (rand() % 20 == 0)
+        cmd.buttons ^= 1;
+
+    sendobj = &c->send_queue[c->maketic % BACKUPTICS];
+    sendobj->active = true;
+    sendobj->seq = c->maketic;
+    sendobj->time = bench_time;
+    NET_TiccmdDiff(&c->last_ticcmd, &cmd, &sendobj->cmd);
+
+    c->last_ticcmd = cmd;
+
+    BenchClient_SendTics(c, c->maketic - c->extratics, c->maketic);
+
+    ++c->maketic;
+}
+
+static void BenchClient_ParseWaitingData(bench_client_t *c, net_packet_t *packet)
+{
+    unsigned int num_players;
+    unsigned int num_drones;
+    unsigned int is_controller;
+
+    if (!NET_ReadInt8(packet, &num_players)
+     || !NET_ReadInt8(packet, &num_drones)
+     || !NET_ReadInt8(packet, &is_controller))
+    {
+        return;
+    }
+
+    c->num_players = num_players;
+    c->controller = is_controller != 0;
+}
+
+static void BenchClient_ParseGameStart(bench_client_t *c, net_packet_t *packet)
+{
+    net_gamesettings_t settings;
+    unsigned int num_players;
+    signed int player_number;
+    unsigned int features;
+
+    if (!NET_ReadInt8(packet, &num_players)
+     || !NET_ReadSInt8(packet, &player_number)
+     || !NET_ReadSettings(packet, &settings))
+    {
+        return;
+    }
+
+    if (!NET_ReadInt8(packet, &features))
+        features = 0;
+
+    if (c->state != BENCH_WAITING_START)
+        return;
+
+    c->extratics = settings.extratics;
+    c->features = features & BenchClient_Features();
+    c->state = BENCH_IN_GAME;
+}
+
+static void BenchClient_ParseGameData(bench_client_t *c, net_packet_t *packet)
+{
+    net_full_ticcmd_t cmds[256];
+    unsigned int seq, count;
+    int resend_start, resend_end;
+    unsigned int i;
+    int index;
+
+    if (!NET_ReadInt8(packet, &seq)
+     || !NET_ReadInt8(packet, &count))
+    {
+        return;
+    }
+
+    if (!c->need_to_acknowledge)
+    {
+        c->need_to_acknowledge = true;
+        c->gamedata_recv_time = bench_time;
+    }
+
+    seq = NET_ExpandTicNum(c->recvwindow_start, seq);
+
+    if (c->features & NET_FEATURE_COMPACT_TICS)
+    {
+        if (!NET_ReadCompactTiccmds(packet, cmds, count))
+            return;
+    }
+
+    for (i=0; i<count; ++i)
+    {
+        if (!(c->features & NET_FEATURE_COMPACT_TICS)
+         && !NET_ReadFullTiccmd(packet, &cmds[i], 0))
+        {
+            return;
+        }
+
+        index = seq - c->recvwindow_start + i;
+
+        if (index >= 0 && index < BACKUPTICS)
+            c->recvwindow[index].active = true;
+    }
+
+    // Ask for any tics missing before this packet
+
+    resend_end = seq - c->recvwindow_start;
+
+    if (resend_end <= 0)
+        return;
+
+    if (resend_end >= BACKUPTICS)
+        resend_end = BACKUPTICS - 1;
+
+    index = resend_end - 1;
+    resend_start = resend_end;
+
+    while (index >= 0
+        && !c->recvwindow[index].active
+        && c->recvwindow[index].resend_time == 0)
+    {
+        resend_start = index;
+        --index;
+    }
+
+    if (resend_start < resend_end)
+    {
+        BenchClient_SendResendRequest(c, c->recvwindow_start + resend_start,
+                                      c->recvwindow_start + resend_end - 1);
+    }
+}
+
+static void BenchClient_ParseResendRequest(bench_client_t *c, net_packet_t *packet)
+{
+    unsigned int start, end;
+    unsigned int count;
+
+    if (!NET_ReadInt32(packet, &start)
+     || !NET_ReadInt8(packet, &count))
+    {
+        return;
+    }
+
+    end = start + count - 1;
+
+    while (start <= end
+        && (!c->send_queue[start % BACKUPTICS].active
+         || c->send_queue[start % BACKUPTICS].seq != (int) start))
+    {
+        ++start;
+    }
+
+    while (start <= end
+        && (!c->send_queue[end % BACKUPTICS].active
+         || c->send_queue[end % BACKUPTICS].seq != (int) end))
+    {
+        --end;
+    }
+
+    if (start <= end)
+    {
+        ++c->resends;
+        BenchClient_SendTics(c, start, end);
+    }
+}
+
+static void BenchClient_Packet(bench_client_t *c, net_packet_t *packet)
+{
+    unsigned int packet_type;
+
+    if (!NET_ReadInt16(packet, &packet_type))
+        return;
+
+    if (NET_Conn_Packet(&c->connection, packet, &packet_type))
+        return;
+
+    switch (packet_type)
+    {
+        case NET_PACKET_TYPE_WAITING_DATA:
+            BenchClient_ParseWaitingData(c, packet);
+            break;
+
+        case NET_PACKET_TYPE_GAMESTART:
+            BenchClient_ParseGameStart(c, packet);
+            break;
+
+        case NET_PACKET_TYPE_GAMEDATA:
+            BenchClient_ParseGameData(c, packet);
+            break;
+
+        case NET_PACKET_TYPE_GAMEDATA_RESEND:
+            BenchClient_ParseResendRequest(c, packet);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Run the tics the server has sent in full, measuring how long each of
+// this client's own commands took to come back
+
+static void BenchClient_AdvanceWindow(bench_client_t *c)
+{
+    bench_send_t *sendobj;
+    int latency;
+
+    while (c->recvwindow[0].active)
+    {
+        sendobj = &c->send_queue[c->recvwindow_start % BACKUPTICS];
+
+        if (sendobj->active && sendobj->seq == c->recvwindow_start)
+        {
+            latency = bench_time - sendobj->time;
+
+            c->latency_total += latency;
+            ++c->latency_count;
+
+            if (latency > c->latency_max)
+                c->latency_max = latency;
+        }
+
+        memmove(c->recvwindow, c->recvwindow + 1,
+                sizeof(bench_recv_t) * (BACKUPTICS - 1));
+        memset(&c->recvwindow[BACKUPTICS-1], 0, sizeof(bench_recv_t));
+
+        ++c->recvwindow_start;
+    }
+}
+
+static void BenchClient_CheckResends(bench_client_t *c)
+{
+    int resend_start = -1;
+    int resend_end = -1;
+    dboolean need_resend;
+    int i;
+
+    for (i=0; i<BACKUPTICS; ++i)
+    {
+        need_resend = !c->recvwindow[i].active
+                   && c->recvwindow[i].resend_time != 0
+                   && bench_time > c->recvwindow[i].resend_time + 300;
+
+        if (need_resend)
+        {
+            if (resend_start < 0)
+                resend_start = i;
+
+            resend_end = i;
+        }
+        else if (resend_start >= 0)
+        {
+            BenchClient_SendResendRequest(c, c->recvwindow_start + resend_start,
+                                          c->recvwindow_start + resend_end);
+            resend_start = -1;
+        }
+    }
+
+    if (resend_start >= 0)
+    {
+        BenchClient_SendResendRequest(c, c->recvwindow_start + resend_start,
+                                      c->recvwindow_start + resend_end);
+    }
+
+    if (c->need_to_acknowledge && bench_time - c->gamedata_recv_time > 200)
+    {
+        BenchClient_SendAck(c);
+    }
+}
+
+static void BenchClient_Run(bench_client_t *c)
+{
+    NET_Conn_Run(&c->connection);
+
+    switch (c->state)
+    {
+        case BENCH_CONNECTING:
+            if (c->connection.state == NET_CONN_STATE_CONNECTED)
+            {
+                c->state = BENCH_WAITING_START;
+            }
+            else if (bench_time - c->last_syn_time > 1000)
+            {
+                BenchClient_SendSYN(c);
+            }
+            break;
+
+        case BENCH_WAITING_START:
+            if (c->controller && !c->sent_start
+             && c->num_players == num_clients)
+            {
+                BenchClient_SendGameStart(c);
+            }
+            break;
+
+        case BENCH_IN_GAME:
+            BenchClient_AdvanceWindow(c);
+            BenchClient_CheckResends(c);
+
+            // Keep making tics after num_tics, as a game would, so
+            // that tics lost at the end are noticed and resent
+
+            if (bench_time % TICTIME == 0)
+            {
+                if (c->maketic - c->recvwindow_start >= MAXLAG)
+                    ++c->stalls;
+                else
+                    BenchClient_MakeTic(c);
+            }
+            break;
+    }
+}
+
+//-----------------------------------------------------------------------------
+//
+// Benchmark
+//
+//-----------------------------------------------------------------------------
+
+static int GetArg(const char *name, int defaultvalue)
+{
+    int p;
+
+    p = M_CheckParm(name);
+
+    if (p > 0 && p < myargc - 1)
+        return atoi(myargv[p+1]);
+
+    return defaultvalue;
+}
+
+static void QueryServerStats(void)
+{
+    net_packet_t *packet;
+
+    monitor_addr.module = &bench_module;
+
+    packet = NET_NewPacket(10);
+    NET_WriteInt16(packet, NET_PACKET_TYPE_STATS_QUERY);
+    NET_SV_ServerPacket(server, packet, &monitor_addr);
+    NET_FreePacket(packet);
+}
+
+static void PrintResults(double wall_seconds, dboolean finished)
+{
+    int game_tics = num_tics;
+    bench_client_t *c;
+    int i;
+
+    for (i=0; i<num_clients; ++i)
+    {
+        if (clients[i].recvwindow_start < game_tics)
+            game_tics = clients[i].recvwindow_start;
+    }
+
+    printf("netbench: %i clients, %i tics, %i ms delay, %i ms jitter, "
+           "%i%% loss, %i%% reordered\n",
+           num_clients, num_tics, link_delay, link_jitter,
+           link_loss, link_reorder);
+
+    if (!finished)
+    {
+        printf("  did not finish: %i of %i tics run\n", game_tics, num_tics);
+    }
+
+    printf("  simulated time: %.1f s, %.1f tics/s\n",
+           bench_time / 1000.0, game_tics * 1000.0 / bench_time);
+    printf("  wall time:      %.3f s, %.0f tics/s\n",
+           wall_seconds, wall_seconds > 0 ? game_tics / wall_seconds : 0);
+    printf("  packets:        %i sent, %lli bytes, %i dropped, %i reordered\n",
+           packets_sent, bytes_sent, packets_dropped, packets_reordered);
+    printf("\n  client  tics  stalls  resend-req  resent  latency avg/max  "
+           "server resend-req/served\n");
+
+    for (i=0; i<num_clients; ++i)
+    {
+        c = &clients[i];
+
+        printf("  %6i  %4i  %6i  %10i  %6i  %7i/%-7i  %10i/%-6i\n",
+               c->index, c->recvwindow_start, c->stalls,
+               c->resend_requests, c->resends,
+               BenchClient_Latency(c), c->latency_max,
+               c->server_resend_requests, c->server_resends);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::chrono::steady_clock::time_point start;
+    std::chrono::duration<double> elapsed;
+    dboolean finished = false;
+    int time_limit;
+    int i;
+
+    myargc = argc;
+    myargv = argv;
+
+    num_clients = GetArg("-clients", num_clients);
+    num_tics = GetArg("-tics", num_tics);
+    link_delay = GetArg("-delay", link_delay);
+    link_jitter = GetArg("-jitter", link_jitter);
+    link_loss = GetArg("-loss", link_loss);
+    link_reorder = GetArg("-reorder", link_reorder);
+    extratics = GetArg("-extratics", extratics);
+    srand(GetArg("-seed", 1));
+
+    // With a single client the server has nobody else's tics to wait
+    // for, so there is no game traffic to measure
+
+    if (num_clients < 2 || num_clients > MAXPLAYERS)
+    {
+        fprintf(stderr, "netbench: -clients must be between 2 and %i\n",
+                MAXPLAYERS);
+        return 1;
+    }
+
+    server = NET_SV_NewServer();
+
+    for (i=0; i<num_clients; ++i)
+    {
+        bench_client_t *c = &clients[i];
+
+        c->index = i;
+        snprintf(c->name, sizeof(c->name), "bench%i", i);
+        c->state = BENCH_CONNECTING;
+        c->last_syn_time = -1000;
+        c->server_addr.module = &bench_module;
+        c->server_addr.handle = c;
+        c->client_addr.module = &bench_module;
+        c->client_addr.handle = c;
+
+        NET_Conn_InitClient(&c->connection, &c->server_addr);
+    }
+
+    // Give up if the game runs at under a quarter of real time
+
+    time_limit = 10000 + num_tics * TICTIME * 4;
+    start = std::chrono::steady_clock::now();
+
+    for (bench_time=1; bench_time<time_limit; ++bench_time)
+    {
+        BenchLink_Deliver();
+
+        for (i=0; i<num_clients; ++i)
+        {
+            BenchClient_Run(&clients[i]);
+        }
+
+        NET_SV_RunServer(server);
+
+        finished = true;
+
+        for (i=0; i<num_clients; ++i)
+        {
+            if (clients[i].recvwindow_start < num_tics)
+                finished = false;
+        }
+
+        if (finished)
+            break;
+    }
+
+    elapsed = std::chrono::steady_clock::now() - start;
+
+    QueryServerStats();
+    PrintResults(elapsed.count(), finished);
+
+    return finished ? 0 : 1;
+}
+
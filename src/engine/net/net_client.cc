@@ -176,8 +176,26 @@ md5_digest_t net_local_wad_md5sum;
 
 static fixed_t average_latency;
 
+// NET_FEATURE_* flags the server agreed to in the game start packet
+
+static int net_cl_features;
+
 #define NET_CL_ExpandTicNum(b) NET_ExpandTicNum(recvwindow_start, (b))
 
+// Protocol features this client offers the server
+
+static int NET_CL_Features(void)
+{
+    // -nocompacttics: see NET_SV_Features
+
+    if (M_CheckParm("-nocompacttics") > 0)
+    {
+        return 0;
+    }
+
+    return NET_FEATURE_COMPACT_TICS;
+}
+
 void W_Checksum(md5_digest_t digest);
 
 // Called when a player leaves the game
@@ -485,15 +503,35 @@ static void NET_CL_SendTics(int start, int end)
 
     // Add the tics.
 
-    for (i=start; i<=end; ++i)
+    if (net_cl_features & NET_FEATURE_COMPACT_TICS)
+    {
+        net_full_ticcmd_t cmds[256];
+
+        // Our command goes in slot 0 of each tic
+
+        memset(cmds, 0, sizeof(net_full_ticcmd_t) * (end - start + 1));
+
+        for (i=start; i<=end; ++i)
+        {
+            cmds[i - start].latency = average_latency / FRACUNIT;
+            cmds[i - start].playeringame[0] = true;
+            cmds[i - start].cmds[0] = send_queue[i % BACKUPTICS].cmd;
+        }
+
+        NET_WriteCompactTiccmds(packet, cmds, end - start + 1);
+    }
+    else
     {
-        net_server_send_t *sendobj;
+        for (i=start; i<=end; ++i)
+        {
+            net_server_send_t *sendobj;
 
-        sendobj = &send_queue[i % BACKUPTICS];
+            sendobj = &send_queue[i % BACKUPTICS];
 
-        NET_WriteInt16(packet, average_latency / FRACUNIT);
+            NET_WriteInt16(packet, average_latency / FRACUNIT);
 
-        NET_WriteTiccmdDiff(packet, &sendobj->cmd, 0);
+            NET_WriteTiccmdDiff(packet, &sendobj->cmd, 0);
+        }
     }
     
     // Send the packet
@@ -622,6 +660,7 @@ static void NET_CL_ParseGameStart(net_packet_t *packet)
     net_gamesettings_t settings;
     unsigned int num_players;
     signed int player_number;
+    unsigned int features;
     unsigned int i;
 
     if (!NET_ReadInt8(packet, &num_players)
@@ -631,6 +670,13 @@ static void NET_CL_ParseGameStart(net_packet_t *packet)
         return;
     }
 
+    // Features the server agreed to; older servers send none
+
+    if (!NET_ReadInt8(packet, &features))
+    {
+        features = 0;
+    }
+
     if (client_state != CLIENT_STATE_WAITING_START)
     {
         return;
@@ -681,6 +727,7 @@ static void NET_CL_ParseGameStart(net_packet_t *packet)
     compatflags     = settings.compatflags;
     gameflags       = settings.gameflags;
     net_cl_new_sync = settings.new_sync != 0;
+    net_cl_features = features & NET_CL_Features();
 
     if (net_cl_new_sync == false)
     {
@@ -815,6 +862,7 @@ static void NET_CL_CheckResends(void)
 
 static void NET_CL_ParseGameData(net_packet_t *packet)
 {
+    net_full_ticcmd_t cmds[256];
     net_server_recv_t *recvobj;
     unsigned int seq, num_tics;
     unsigned int nowtime;
@@ -845,13 +893,23 @@ static void NET_CL_ParseGameData(net_packet_t *packet)
 
     seq = NET_CL_ExpandTicNum(seq);
 
+    if ((net_cl_features & NET_FEATURE_COMPACT_TICS)
+     && !NET_ReadCompactTiccmds(packet, cmds, num_tics))
+    {
+        return;
+    }
+
     for (i=0; i<num_tics; ++i)
     {
         net_full_ticcmd_t cmd;
 
         index = seq - recvwindow_start + i;
 
-        if (!NET_ReadFullTiccmd(packet, &cmd, 0))
+        if (net_cl_features & NET_FEATURE_COMPACT_TICS)
+        {
+            cmd = cmds[i];
+        }
+        else if (!NET_ReadFullTiccmd(packet, &cmd, 0))
         {
             return;
         }
@@ -1145,6 +1203,7 @@ static void NET_CL_SendSYN(void)
     NET_WriteInt8(packet, drone);
     NET_WriteMD5Sum(packet, net_local_wad_md5sum);
     NET_WriteString(packet, net_player_name);
+    NET_WriteInt8(packet, NET_CL_Features());
     NET_Conn_SendPacket(&client_connection, packet);
     NET_FreePacket(packet);
 }
@@ -57,6 +57,8 @@ static void NET_Conn_Init(net_connection_t *conn, net_addr_t *addr)
     conn->reliable_packets = NULL;
     conn->reliable_send_seq = 0;
     conn->reliable_recv_seq = 0;
+    conn->packets_sent = 0;
+    conn->packets_recv = 0;
 }
 
 // Initialise as a client connection
@@ -82,6 +84,7 @@ void NET_Conn_InitServer(net_connection_t *conn, net_addr_t *addr)
 void NET_Conn_SendPacket(net_connection_t *conn, net_packet_t *packet)
 {
     conn->keepalive_send_time = I_GetTimeMS();
+    ++conn->packets_sent;
     NET_SendPacket(conn->addr, packet);
 }
 
@@ -268,6 +271,7 @@ dboolean NET_Conn_Packet(net_connection_t *conn, net_packet_t *packet,
                         unsigned int *packet_type)
 {
     conn->keepalive_recv_time = I_GetTimeMS();
+    ++conn->packets_recv;
 
     // Is this a reliable packet?
 
@@ -451,6 +455,60 @@ void NET_Conn_Run(net_connection_t *conn)
     }
 }
 
+// Returns how many milliseconds from nowtime until NET_Conn_Run next
+// has something to do on its own, without any packets arriving.
+// The checks in NET_Conn_Run are strict, hence the extra millisecond.
+
+int NET_Conn_NextEvent(net_connection_t *conn, int nowtime)
+{
+    int next;
+
+    if (conn->state == NET_CONN_STATE_CONNECTED)
+    {
+        next = conn->keepalive_recv_time + CONNECTION_TIMEOUT_LEN * 1000 + 1;
+
+        if (conn->keepalive_send_time + KEEPALIVE_PERIOD * 1000 + 1 < next)
+        {
+            next = conn->keepalive_send_time + KEEPALIVE_PERIOD * 1000 + 1;
+        }
+
+        if (conn->reliable_packets != NULL)
+        {
+            if (conn->reliable_packets->last_send_time < 0)
+            {
+                return 0;
+            }
+
+            if (conn->reliable_packets->last_send_time + 1001 < next)
+            {
+                next = conn->reliable_packets->last_send_time + 1001;
+            }
+        }
+    }
+    else if (conn->state == NET_CONN_STATE_WAITING_ACK
+          || conn->state == NET_CONN_STATE_DISCONNECTING)
+    {
+        if (conn->last_send_time < 0)
+        {
+            return 0;
+        }
+
+        next = conn->last_send_time + 1001;
+    }
+    else if (conn->state == NET_CONN_STATE_DISCONNECTED_SLEEP)
+    {
+        next = conn->last_send_time + 5001;
+    }
+    else
+    {
+        // disconnected, waiting to be cleaned up
+
+        return 0;
+    }
+
+    return next > nowtime ? next - nowtime : 0;
+}
+
 net_packet_t *NET_Conn_NewReliable(net_connection_t *conn, int packet_type)
 {
     net_packet_t *packet;
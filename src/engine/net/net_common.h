@@ -97,6 +97,11 @@ typedef struct
     net_reliable_packet_t *reliable_packets;
     int reliable_send_seq;
     int reliable_recv_seq;
+
+    // packet counters, for statistics
+
+    unsigned int packets_sent;
+    unsigned int packets_recv;
 } net_connection_t;
 
 
@@ -107,6 +112,7 @@ dboolean NET_Conn_Packet(net_connection_t *conn, net_packet_t *packet,
                         unsigned int *packet_type);
 void NET_Conn_Disconnect(net_connection_t *conn);
 void NET_Conn_Run(net_connection_t *conn);
+int NET_Conn_NextEvent(net_connection_t *conn, int nowtime);
 net_packet_t *NET_Conn_NewReliable(net_connection_t *conn, int packet_type);
 
 // Other miscellaneous common functions
@@ -23,14 +23,37 @@
 // Dedicated server code.
 // 
 
+#include <system/thread_pool.hh>
+
 #include "doomtype.h"
 #include "i_system.h"
 #include "m_misc.h"
 
 #include "net_defs.h"
+#include "net_packet.h"
 #include "net_sdl.h"
 #include "net_server.h"
 
+#define MAX_MATCHES 32
+
+// Packets received for a match since it last ran.  UDP is allowed to
+// drop packets, so a full queue simply discards new arrivals.
+
+#define MATCH_QUEUE_SIZE 256
+
+typedef struct
+{
+    net_server_t *server;
+    int socket;
+    int port;
+    int queued;
+    net_packet_t *packets[MATCH_QUEUE_SIZE];
+    net_addr_t *addrs[MATCH_QUEUE_SIZE];
+} match_t;
+
+static match_t *matches;
+static int num_matches;
+
 // 
 // People can become confused about how dedicated servers work.  Game
 // options are specified to the controlling player who is the first to
@@ -63,18 +86,122 @@ static void CheckForClientOptions(void)
     }
 }
 
+// Feed a match the packets queued for it and run it.  Called on the
+// worker threads; each match only touches its own server and socket.
+
+static void RunMatch(match_t *match)
+{
+    int i;
+
+    for (i=0; i<match->queued; ++i)
+    {
+        NET_SV_ServerPacket(match->server, match->packets[i], match->addrs[i]);
+        NET_FreePacket(match->packets[i]);
+    }
+
+    match->queued = 0;
+
+    NET_SV_RunServer(match->server);
+}
+
+// Read everything waiting on the sockets and queue it for its match
+
+static void ReceivePackets(void)
+{
+    net_packet_t *packet;
+    net_addr_t *addr;
+    match_t *match;
+    int socket;
+    int i;
+
+    while (NET_SDL_RecvPacketFrom(&socket, &addr, &packet))
+    {
+        match = NULL;
+
+        for (i=0; i<num_matches; ++i)
+        {
+            if (matches[i].socket == socket)
+            {
+                match = &matches[i];
+                break;
+            }
+        }
+
+        if (match == NULL || match->queued >= MATCH_QUEUE_SIZE)
+        {
+            NET_FreePacket(packet);
+            continue;
+        }
+
+        match->packets[match->queued] = packet;
+        match->addrs[match->queued] = addr;
+        ++match->queued;
+    }
+}
+
+static void InitMatches(void)
+{
+    int base_port;
+    int p;
+    int i;
+
+    //!
+    // @category net
+    // @arg <n>
+    //
+    // Host n independent games on consecutive ports, starting at the
+    // port given with -port.
+    //
+
+    num_matches = 1;
+
+    p = M_CheckParm("-matches");
+    if (p > 0 && p < myargc - 1)
+        num_matches = atoi(myargv[p+1]);
+
+    if (num_matches < 1 || num_matches > MAX_MATCHES)
+    {
+        I_Error("NET_DedicatedServer: -matches must be between 1 and %i",
+                MAX_MATCHES);
+    }
+
+    matches = (match_t*) calloc(num_matches, sizeof(match_t));
+    base_port = NET_SDL_Port();
+
+    for (i=0; i<num_matches; ++i)
+    {
+        matches[i].server = NET_SV_NewServer();
+        matches[i].port = base_port + i;
+        matches[i].socket = NET_SDL_OpenPort(matches[i].port);
+
+        I_Printf("NET_DedicatedServer: match %i on port %i\n",
+                 i, matches[i].port);
+    }
+}
+
 void NET_DedicatedServer(void)
 {
-    CheckForClientOptions();
+    int timeout;
+    int i;
 
-    NET_SV_Init();
+    CheckForClientOptions();
 
-    NET_SV_AddModule(&net_sdl_module);
+    InitMatches();
 
     while (true)
     {
-        NET_SV_Run();
-        I_Sleep(10);
+        sys::ThreadPool::global().for_each(num_matches, [](size_t m) {
+            RunMatch(&matches[m]);
+        });
+
+        timeout = NET_SV_NextEvent(matches[0].server);
+
+        for (i=1; i<num_matches; ++i)
+        {
+            timeout = MIN(timeout, NET_SV_NextEvent(matches[i].server));
+        }
+
+        NET_SDL_WaitPacket(timeout);
+        ReceivePackets();
     }
 }
-
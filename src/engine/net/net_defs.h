@@ -74,6 +74,11 @@ struct _net_module_s
     // Try to resolve a name to an address
 
     net_addr_t *(*ResolveAddress)(char *addr);
+
+    // Block until a packet may be waiting or timeout milliseconds
+    // have passed. NULL if the module can only be polled.
+
+    dboolean (*WaitPacket)(int timeout);
 };
 
 // net_addr_t
@@ -113,8 +118,16 @@ typedef enum
     NET_PACKET_TYPE_QUERY_RESPONSE,
     NET_PACKET_TYPE_CVAR_UPDATE,
     NET_PACKET_TYPE_CHEAT_REQUEST,
+    NET_PACKET_TYPE_STATS_QUERY,
+    NET_PACKET_TYPE_STATS_RESPONSE,
 } net_packet_type_t;
 
+// Optional protocol features.  The client offers them at the end of its
+// SYN and the server confirms the ones it will use at the end of the game
+// start packet; ends that know nothing about them send and read neither.
+
+#define NET_FEATURE_COMPACT_TICS    (1 << 0)    // NET_WriteCompactTiccmds
+
 typedef struct 
 {
     int ticdup;
@@ -173,5 +186,18 @@ typedef struct
     const char *description;
 } net_querydata_t;
 
+// Per-client statistics sent in response to stats queries
+
+typedef struct
+{
+    const char *name;
+    int player_number;          // -1 for drones
+    int latency;                // round trip reported by the client, ms
+    int resends_requested;      // resend requests sent to the client
+    int resends_served;         // resend requests answered for the client
+    int packets_in;             // packets per second received
+    int packets_out;            // packets per second sent
+} net_clientstats_t;
+
 #endif /* #ifndef NET_DEFS_H */
 
@@ -114,12 +114,34 @@ dboolean NET_RecvPacket(net_context_t *context,
     return false;
 }
 
-// Note: this prints into a static buffer, calling again overwrites
-// the first result
+// Wait for a packet on any module of the context, for at most timeout
+// milliseconds. Only a lone module that supports waiting can block;
+// otherwise the modules have to be polled, so just nap briefly.
+
+void NET_WaitContext(net_context_t *context, int timeout)
+{
+    if (timeout <= 0)
+    {
+        return;
+    }
+
+    if (context->num_modules == 1 && context->modules[0]->WaitPacket != NULL)
+    {
+        context->modules[0]->WaitPacket(timeout);
+    }
+    else
+    {
+        I_Sleep(timeout < 10 ? timeout : 10);
+    }
+}
+
+// Note: this prints into a per-thread static buffer, calling again
+// overwrites the first result. The dedicated server calls this from
+// several match threads at once.
 
 char *NET_AddrToString(net_addr_t *addr)
 {
-    static char buf[128];
+    static thread_local char buf[128];
 
     addr->module->AddrToString(addr, buf, sizeof(buf) - 1);
 
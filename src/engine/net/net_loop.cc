@@ -60,6 +60,7 @@ static void QueuePush(packet_queue_t *queue, net_packet_t *packet)
     {
         // queue is full
         
+        NET_FreePacket(packet);
         return;
     }
 
@@ -151,6 +152,7 @@ net_module_t net_loop_client_module =
     NET_CL_AddrToString,
     NET_CL_FreeAddress,
     NET_CL_ResolveAddress,
+    NULL,
 };
 
 //-----------------------------------------------------------------------------
@@ -219,6 +221,7 @@ net_module_t net_loop_server_module =
     NET_SV_AddrToString,
     NET_SV_FreeAddress,
     NET_SV_ResolveAddress,
+    NULL,
 };
 
 
@@ -23,43 +23,190 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <stdlib.h>
 #include <string.h>
 #include "net_packet.h"
-#include "z_zone.h"
+#include "con_console.h"
+#include "g_actions.h"
 
-static int total_packet_memory = 0;
+// Packets are allocated with malloc rather than the zone so that servers
+// running on worker threads can create and free them.  Freed packets are
+// kept in per-size pools since every tic sends and receives several.
+
+// Payload buffers are reference counted: NET_PacketDup hands out a new
+// packet that shares the payload, and a shared payload is copied before
+// it is written to.  The count sits just in front of the data.
+
+typedef struct
+{
+    std::atomic<int> refcount;
+    int sizeclass;              // -1 if too large to pool
+} net_buffer_t;
+
+#define NUMSIZECLASSES  4
+#define MINSIZECLASS    6       // 64 bytes, up to 4096, above the UDP MTU
+#define POOLSIZE        256     // free buffers kept per size class
+
+typedef struct
+{
+    void *next;
+} net_freenode_t;
+
+static std::mutex pool_mutex;
+static net_freenode_t *free_buffers[NUMSIZECLASSES];
+static int num_free_buffers[NUMSIZECLASSES];
+static net_freenode_t *free_packets;
+static int num_free_packets;
+
+static std::atomic<int> total_packet_memory { 0 };
+static std::atomic<int> pool_hits { 0 };
+static std::atomic<int> pool_misses { 0 };
+static std::atomic<int> payload_shares { 0 };
+static std::atomic<int> payload_copies { 0 };
+
+static int NET_SizeClass(int size)
+{
+    int sizeclass;
+
+    for (sizeclass=0; sizeclass<NUMSIZECLASSES; ++sizeclass)
+    {
+        if (size <= (1 << (MINSIZECLASS + sizeclass)))
+            return sizeclass;
+    }
+
+    return -1;
+}
+
+// Allocates a payload buffer of at least size bytes, returning its data
+// and setting *alloced to the usable size
+
+static byte *NET_AllocBuffer(int size, size_t *alloced)
+{
+    net_buffer_t *buffer = NULL;
+    int sizeclass;
+
+    sizeclass = NET_SizeClass(size);
+
+    if (sizeclass >= 0)
+    {
+        size = 1 << (MINSIZECLASS + sizeclass);
+
+        std::lock_guard<std::mutex> lock(pool_mutex);
+
+        if (free_buffers[sizeclass] != NULL)
+        {
+            buffer = (net_buffer_t *) free_buffers[sizeclass];
+            free_buffers[sizeclass] = (net_freenode_t *) free_buffers[sizeclass]->next;
+            --num_free_buffers[sizeclass];
+        }
+    }
+
+    if (buffer != NULL)
+    {
+        ++pool_hits;
+    }
+    else
+    {
+        ++pool_misses;
+        buffer = (net_buffer_t *) malloc(sizeof(net_buffer_t) + size);
+        total_packet_memory += sizeof(net_buffer_t) + size;
+    }
+
+    new (&buffer->refcount) std::atomic<int>(1);
+    buffer->sizeclass = sizeclass;
+    *alloced = size;
+
+    return (byte *) (buffer + 1);
+}
+
+static void NET_ReleaseBuffer(byte *data, size_t alloced)
+{
+    net_buffer_t *buffer = ((net_buffer_t *) data) - 1;
+    int sizeclass;
+
+    if (--buffer->refcount > 0)
+        return;
+
+    sizeclass = buffer->sizeclass;
+
+    if (sizeclass >= 0)
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+
+        if (num_free_buffers[sizeclass] < POOLSIZE)
+        {
+            ((net_freenode_t *) buffer)->next = free_buffers[sizeclass];
+            free_buffers[sizeclass] = (net_freenode_t *) buffer;
+            ++num_free_buffers[sizeclass];
+            return;
+        }
+    }
+
+    total_packet_memory -= sizeof(net_buffer_t) + alloced;
+    free(buffer);
+}
+
+static net_packet_t *NET_AllocPacketHeader(void)
+{
+    net_packet_t *packet = NULL;
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+
+        if (free_packets != NULL)
+        {
+            packet = (net_packet_t *) free_packets;
+            free_packets = (net_freenode_t *) free_packets->next;
+            --num_free_packets;
+        }
+    }
+
+    if (packet == NULL)
+    {
+        packet = (net_packet_t *) malloc(sizeof(net_packet_t));
+        total_packet_memory += sizeof(net_packet_t);
+    }
+
+    return packet;
+}
 
 net_packet_t *NET_NewPacket(int initial_size)
 {
     net_packet_t *packet;
 
-    packet = (net_packet_t *) Z_Malloc(sizeof(net_packet_t), PU_STATIC, 0);
+    packet = NET_AllocPacketHeader();
     
     if (initial_size == 0)
         initial_size = 256;
 
-    packet->alloced = initial_size;
-    packet->data = (byte*) Z_Malloc(initial_size, PU_STATIC, 0);
+    packet->data = NET_AllocBuffer(initial_size, &packet->alloced);
     packet->len = 0;
     packet->pos = 0;
 
-    total_packet_memory += sizeof(net_packet_t) + initial_size;
-
     //printf("total packet memory: %i bytes\n", total_packet_memory);
     //printf("%p: allocated\n", packet);
 
     return packet;
 }
 
-// duplicates an existing packet
+// duplicates an existing packet.  The payload is shared rather than
+// copied; the duplicate has its own read position.
 
 net_packet_t *NET_PacketDup(net_packet_t *packet)
 {
     net_packet_t *newpacket;
 
-    newpacket = NET_NewPacket(packet->len);
-    memcpy(newpacket->data, packet->data, packet->len);
+    newpacket = NET_AllocPacketHeader();
+    newpacket->data = packet->data;
     newpacket->len = packet->len;
+    newpacket->alloced = packet->alloced;
+    newpacket->pos = 0;
+
+    ++(((net_buffer_t *) packet->data) - 1)->refcount;
+    ++payload_shares;
 
     return newpacket;
 }
@@ -68,9 +215,42 @@ void NET_FreePacket(net_packet_t *packet)
 {
     //printf("%p: destroyed\n", packet);
     
-    total_packet_memory -= sizeof(net_packet_t) + packet->alloced;
-    Z_Free(packet->data);
-    Z_Free(packet);
+    NET_ReleaseBuffer(packet->data, packet->alloced);
+
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+
+        if (num_free_packets < POOLSIZE * NUMSIZECLASSES)
+        {
+            ((net_freenode_t *) packet)->next = free_packets;
+            free_packets = (net_freenode_t *) packet;
+            ++num_free_packets;
+            return;
+        }
+    }
+
+    total_packet_memory -= sizeof(net_packet_t);
+    free(packet);
+}
+
+void NET_PacketPoolStats(net_poolstats_t *stats)
+{
+    int i;
+
+    stats->hits = pool_hits;
+    stats->misses = pool_misses;
+    stats->shares = payload_shares;
+    stats->copies = payload_copies;
+    stats->memory = total_packet_memory;
+
+    std::lock_guard<std::mutex> lock(pool_mutex);
+
+    stats->pooled = num_free_packets;
+
+    for (i=0; i<NUMSIZECLASSES; ++i)
+    {
+        stats->pooled += num_free_buffers[i];
+    }
 }
 
 // Read a byte from the packet, returning true if read
@@ -209,32 +389,42 @@ char *NET_ReadString(net_packet_t *packet)
     return start;
 }
 
-// Dynamically increases the size of a packet
+// Makes room for size more bytes at the end of a packet, taking a
+// private copy of the payload first if it is shared
 
-static void NET_IncreasePacket(net_packet_t *packet)
+static void NET_ReservePacket(net_packet_t *packet, size_t size)
 {
+    net_buffer_t *buffer = ((net_buffer_t *) packet->data) - 1;
+    size_t newsize;
     byte *newdata;
 
-    total_packet_memory -= packet->alloced;
-   
-    packet->alloced *= 2;
+    if (packet->len + size <= packet->alloced && buffer->refcount == 1)
+        return;
+
+    newsize = packet->alloced;
+
+    while (packet->len + size > newsize)
+    {
+        newsize *= 2;
+    }
+
+    if (buffer->refcount > 1)
+        ++payload_copies;
 
-    newdata = (byte*) Z_Malloc(packet->alloced, PU_STATIC, 0);
+    newdata = NET_AllocBuffer(newsize, &newsize);
 
     memcpy(newdata, packet->data, packet->len);
 
-    Z_Free(packet->data);
+    NET_ReleaseBuffer(packet->data, packet->alloced);
     packet->data = newdata;
-
-    total_packet_memory += packet->alloced;
+    packet->alloced = newsize;
 }
 
 // Write a single byte to the packet
 
 void NET_WriteInt8(net_packet_t *packet, unsigned int i)
 {
-    if (packet->len + 1 > packet->alloced)
-        NET_IncreasePacket(packet);
+    NET_ReservePacket(packet, 1);
 
     packet->data[packet->len] = i;
     packet->len += 1;
@@ -246,8 +436,7 @@ void NET_WriteInt16(net_packet_t *packet, unsigned int i)
 {
     byte *p;
     
-    if (packet->len + 2 > packet->alloced)
-        NET_IncreasePacket(packet);
+    NET_ReservePacket(packet, 2);
 
     p = packet->data + packet->len;
 
@@ -264,8 +453,7 @@ void NET_WriteInt32(net_packet_t *packet, unsigned int i)
 {
     byte *p;
 
-    if (packet->len + 4 > packet->alloced)
-        NET_IncreasePacket(packet);
+    NET_ReservePacket(packet, 4);
 
     p = packet->data + packet->len;
 
@@ -281,12 +469,7 @@ void NET_WriteString(net_packet_t *packet, StringView string)
 {
     byte *p;
 
-    // Increase the packet size until large enough to hold the string
-
-    while (packet->len + string.length() + 1 > packet->alloced)
-    {
-        NET_IncreasePacket(packet);
-    }
+    NET_ReservePacket(packet, string.length() + 1);
 
     p = packet->data + packet->len;
 
@@ -294,3 +477,24 @@ void NET_WriteString(net_packet_t *packet, StringView string)
 
     packet->len += string.length() + 1;
 }
+
+//
+// CMD_PacketStats
+//
+
+static CMD(PacketStats)
+{
+    net_poolstats_t stats;
+
+    NET_PacketPoolStats(&stats);
+
+    CON_Printf(WHITE, "Packet pool: %i hits, %i misses, %i pooled, %i kb\n",
+               stats.hits, stats.misses, stats.pooled, stats.memory >> 10);
+    CON_Printf(WHITE, "Payloads: %i shared, %i copied on write\n",
+               stats.shares, stats.copies);
+}
+
+void NET_RegisterCommands(void)
+{
+    G_AddCommand("packetstats", CMD_PacketStats, 0);
+}
@@ -28,9 +28,23 @@
 
 #include "net_defs.h"
 
+// Packet pool statistics, counted since startup
+
+typedef struct
+{
+    int hits;       // allocations served from the pool
+    int misses;     // allocations that went to malloc
+    int shares;     // duplicates that share their payload
+    int copies;     // shared payloads copied before being written
+    int pooled;     // free packets and buffers held in the pool
+    int memory;     // bytes allocated for packets, pooled or not
+} net_poolstats_t;
+
 net_packet_t *NET_NewPacket(int initial_size);
 net_packet_t *NET_PacketDup(net_packet_t *packet);
 void NET_FreePacket(net_packet_t *packet);
+void NET_PacketPoolStats(net_poolstats_t *stats);
+void NET_RegisterCommands(void);
 
 dboolean NET_ReadInt8(net_packet_t *packet, unsigned int *data);
 dboolean NET_ReadInt16(net_packet_t *packet, unsigned int *data);
@@ -270,6 +270,107 @@ void NET_QueryAddress(char *addr)
     exit(0);
 }
 
+// Print the per-client statistics from a stats response
+
+static dboolean NET_Query_PrintStats(net_packet_t *packet)
+{
+    unsigned int packet_type;
+    unsigned int num_clients;
+    net_clientstats_t stats;
+    unsigned int i;
+
+    if (!NET_ReadInt16(packet, &packet_type)
+     || packet_type != NET_PACKET_TYPE_STATS_RESPONSE
+     || !NET_ReadInt8(packet, &num_clients))
+    {
+        return false;
+    }
+
+    formatted_printf(18, "Name");
+    formatted_printf(8, "Player");
+    formatted_printf(8, "RTT");
+    formatted_printf(16, "Resends (s/r)");
+    puts("Packets/s (in/out)");
+
+    for (i=0; i<70; ++i)
+        putchar('=');
+    putchar('\n');
+
+    for (i=0; i<num_clients; ++i)
+    {
+        if (!NET_ReadClientStats(packet, &stats))
+        {
+            return false;
+        }
+
+        formatted_printf(18, "%s", stats.name);
+
+        if (stats.player_number < 0)
+            formatted_printf(8, "drone");
+        else
+            formatted_printf(8, "%i", stats.player_number + 1);
+
+        formatted_printf(8, "%ims", stats.latency);
+        formatted_printf(16, "%i/%i", stats.resends_requested, stats.resends_served);
+        printf("%i/%i\n", stats.packets_in, stats.packets_out);
+    }
+
+    return true;
+}
+
+void NET_QueryStats(char *addr)
+{
+    net_addr_t *net_addr;
+    net_addr_t *from;
+    net_packet_t *request;
+    net_packet_t *packet;
+    int start_time;
+    int last_send_time;
+
+    NET_Query_Init();
+
+    net_addr = NET_ResolveAddress(query_context, addr);
+
+    if (net_addr == NULL)
+    {
+        I_Error("NET_QueryStats: Host '%s' not found!", addr);
+    }
+
+    printf("\nQuerying statistics from '%s'...\n\n", addr);
+
+    last_send_time = -1;
+    start_time = I_GetTimeMS();
+
+    while (I_GetTimeMS() < start_time + 5000)
+    {
+        if (last_send_time < 0 || I_GetTimeMS() > last_send_time + 1000)
+        {
+            request = NET_NewPacket(10);
+            NET_WriteInt16(request, NET_PACKET_TYPE_STATS_QUERY);
+            NET_SendPacket(net_addr, request);
+            NET_FreePacket(request);
+
+            last_send_time = I_GetTimeMS();
+        }
+
+        NET_WaitContext(query_context, 100);
+
+        if (NET_RecvPacket(query_context, &from, &packet))
+        {
+            dboolean done = from == net_addr && NET_Query_PrintStats(packet);
+
+            NET_FreePacket(packet);
+
+            if (done)
+            {
+                exit(0);
+            }
+        }
+    }
+
+    I_Error("No response from '%s'", addr);
+}
+
 net_addr_t *NET_FindLANServer(void)
 {
     NET_Query_Init();
@@ -28,6 +28,7 @@
 #include "net_defs.h"
 
 extern void NET_QueryAddress(char *addr);
+extern void NET_QueryStats(char *addr);
 extern void NET_LANQuery(void);
 extern net_addr_t *NET_FindLANServer(void);
 
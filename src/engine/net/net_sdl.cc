@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <mutex>
 #include <SDL_net.h>
 
 #include "doomdef.h"
@@ -44,16 +45,27 @@
 
 #define DEFAULT_PORT 2342
 
+// Socket 0 is used by the client and the in-game server; a dedicated
+// server hosting several games opens one more per game
+
+#define MAX_SOCKETS 64
+
 static int port = DEFAULT_PORT;
-static UDPsocket udpsocket;
+static UDPsocket udpsockets[MAX_SOCKETS];
+static int num_sockets;
 static UDPpacket *recvpacket;
+static SDLNet_SocketSet socketset;
 
 typedef struct
 {
     net_addr_t net_addr;
     IPaddress sdl_addr;
+    int socket;
 } addrpair_t;
 
+// Addresses are freed by servers running on worker threads
+
+static std::mutex addr_mutex;
 static addrpair_t **addr_table;
 static int addr_table_size = -1;
 
@@ -63,8 +75,7 @@ static void NET_SDL_InitAddrTable(void)
 {
     addr_table_size = 16;
 
-    addr_table = (addrpair_t**) Z_Malloc(sizeof(addrpair_t *) * addr_table_size,
-                          PU_STATIC, 0);
+    addr_table = (addrpair_t**) malloc(sizeof(addrpair_t *) * addr_table_size);
     memset(addr_table, 0, sizeof(addrpair_t *) * addr_table_size);
 }
 
@@ -77,8 +88,9 @@ static dboolean AddressesEqual(IPaddress *a, IPaddress *b)
 // Finds an address by searching the table.  If the address is not found,
 // it is added to the table.
 
-static net_addr_t *NET_SDL_FindAddress(IPaddress *addr)
+static net_addr_t *NET_SDL_FindAddress(IPaddress *addr, int socket)
 {
+    std::lock_guard<std::mutex> lock(addr_mutex);
     addrpair_t *new_entry;
     int empty_entry = -1;
     int i;
@@ -91,6 +103,7 @@ static net_addr_t *NET_SDL_FindAddress(IPaddress *addr)
     for (i=0; i<addr_table_size; ++i)
     {
         if (addr_table[i] != NULL
+         && addr_table[i]->socket == socket
          && AddressesEqual(addr, &addr_table[i]->sdl_addr))
         {
             return &addr_table[i]->net_addr;
@@ -118,22 +131,22 @@ static net_addr_t *NET_SDL_FindAddress(IPaddress *addr)
         // the existing table in.  replace the old table.
 
         new_addr_table_size = addr_table_size * 2;
-        new_addr_table = (addrpair_t**) Z_Malloc(sizeof(addrpair_t *) * new_addr_table_size,
-                                  PU_STATIC, 0);
+        new_addr_table = (addrpair_t**) malloc(sizeof(addrpair_t *) * new_addr_table_size);
         memset(new_addr_table, 0, sizeof(addrpair_t *) * new_addr_table_size);
         memcpy(new_addr_table, addr_table, 
                sizeof(addrpair_t *) * addr_table_size);
-        Z_Free(addr_table);
+        free(addr_table);
         addr_table = new_addr_table;
         addr_table_size = new_addr_table_size;
     }
 
     // Add a new entry
     
-    new_entry = (addrpair_t*) Z_Malloc(sizeof(addrpair_t), PU_STATIC, 0);
+    new_entry = (addrpair_t*) malloc(sizeof(addrpair_t));
 
     new_entry->sdl_addr = *addr;
-    new_entry->net_addr.handle = &new_entry->sdl_addr;
+    new_entry->socket = socket;
+    new_entry->net_addr.handle = new_entry;
     new_entry->net_addr.module = &net_sdl_module;
 
     addr_table[empty_entry] = new_entry;
@@ -143,13 +156,14 @@ static net_addr_t *NET_SDL_FindAddress(IPaddress *addr)
 
 static void NET_SDL_FreeAddress(net_addr_t *addr)
 {
+    std::lock_guard<std::mutex> lock(addr_mutex);
     int i;
     
     for (i=0; i<addr_table_size; ++i)
     {
-        if (addr == &addr_table[i]->net_addr)
+        if (addr_table[i] != NULL && addr == &addr_table[i]->net_addr)
         {
-            Z_Free(addr_table[i]);
+            free(addr_table[i]);
             addr_table[i] = NULL;
             return;
         }
@@ -158,7 +172,67 @@ static void NET_SDL_FreeAddress(net_addr_t *addr)
     I_Error("NET_SDL_FreeAddress: Attempted to remove an unused address!");
 }
 
-static dboolean NET_SDL_InitClient(void)
+// Watch the sockets so that NET_SDL_WaitPacket can block on them
+
+static void NET_SDL_InitSocketSet(void)
+{
+    int i;
+
+    if (socketset != NULL)
+    {
+        SDLNet_FreeSocketSet(socketset);
+    }
+
+    socketset = SDLNet_AllocSocketSet(num_sockets);
+
+    if (socketset == NULL)
+    {
+        I_Error("NET_SDL_InitSocketSet: Unable to watch the sockets: %s",
+                SDLNet_GetError());
+    }
+
+    for (i=0; i<num_sockets; ++i)
+    {
+        if (udpsockets[i] != NULL)
+        {
+            SDLNet_UDP_AddSocket(socketset, udpsockets[i]);
+        }
+    }
+}
+
+// Open a socket on the given port (0 for any) into the given slot
+
+static dboolean NET_SDL_OpenSocket(int slot, int sock_port)
+{
+    SDLNet_Init();
+
+    udpsockets[slot] = SDLNet_UDP_Open((Uint16)sock_port);
+
+    if (udpsockets[slot] == NULL)
+    {
+        return false;
+    }
+
+    if (slot >= num_sockets)
+    {
+        num_sockets = slot + 1;
+    }
+
+    if (recvpacket == NULL)
+    {
+        recvpacket = SDLNet_AllocPacket(1500);
+    }
+
+    NET_SDL_InitSocketSet();
+
+#ifdef DROP_PACKETS
+    srand(time(NULL));
+#endif
+
+    return true;
+}
+
+static void NET_SDL_CheckPort(void)
 {
     int p;
 
@@ -173,63 +247,72 @@ static dboolean NET_SDL_InitClient(void)
     p = M_CheckParm("-port");
     if (p > 0)
         port = atoi(myargv[p+1]);
+}
 
-    SDLNet_Init();
-
-    udpsocket = SDLNet_UDP_Open(0);
+static dboolean NET_SDL_InitClient(void)
+{
+    NET_SDL_CheckPort();
 
-    if (udpsocket == NULL)
+    if (!NET_SDL_OpenSocket(0, 0))
     {
         I_Error("NET_SDL_InitClient: Unable to open a socket!");
     }
-    
-    recvpacket = SDLNet_AllocPacket(1500);
-
-#ifdef DROP_PACKETS
-    srand(time(NULL));
-#endif
 
     return true;
 }
 
 static dboolean NET_SDL_InitServer(void)
 {
-    int p;
-    
-    p = M_CheckParm("-port");
-    if (p > 0)
-        port = atoi(myargv[p+1]);
+    NET_SDL_CheckPort();
 
-    SDLNet_Init();
+    if (!NET_SDL_OpenSocket(0, port))
+    {
+        I_Error("NET_SDL_InitServer: Unable to bind to port %i", port);
+    }
+
+    return true;
+}
+
+int NET_SDL_Port(void)
+{
+    NET_SDL_CheckPort();
 
-    udpsocket = SDLNet_UDP_Open((Uint16)port);
+    return port;
+}
+
+int NET_SDL_OpenPort(int sock_port)
+{
+    int slot = num_sockets > 0 ? num_sockets : 1;
 
-    if (udpsocket == NULL)
+    if (slot >= MAX_SOCKETS)
     {
-        I_Error("NET_SDL_InitServer: Unable to bind to port %i", port);
+        I_Error("NET_SDL_OpenPort: Too many sockets");
     }
 
-    recvpacket = SDLNet_AllocPacket(1500);
-#ifdef DROP_PACKETS
-    srand(time(NULL));
-#endif
+    if (!NET_SDL_OpenSocket(slot, sock_port))
+    {
+        I_Error("NET_SDL_OpenPort: Unable to bind to port %i", sock_port);
+    }
 
-    return true;
+    return slot;
 }
 
 static void NET_SDL_SendPacket(net_addr_t *addr, net_packet_t *packet)
 {
     UDPpacket sdl_packet;
     IPaddress ip;
+    int socket;
    
     if (addr == &net_broadcast_addr)
     {
         SDLNet_ResolveHost(&ip, NULL, (Uint16)port);
         ip.host = INADDR_BROADCAST;
+        socket = 0;
     }
     else
     {
-        ip = *((IPaddress *) addr->handle);
+        ip = ((addrpair_t *) addr->handle)->sdl_addr;
+        socket = ((addrpair_t *) addr->handle)->socket;
     }
 
 #if 0
@@ -258,48 +341,75 @@ static void NET_SDL_SendPacket(net_addr_t *addr, net_packet_t *packet)
     sdl_packet.len = packet->len;
     sdl_packet.address = ip;
 
-    if (!SDLNet_UDP_Send(udpsocket, -1, &sdl_packet))
+    if (!SDLNet_UDP_Send(udpsockets[socket], -1, &sdl_packet))
     {
         I_Error("NET_SDL_SendPacket: Error transmitting packet: %s",
                 SDLNet_GetError());
     }
 }
 
-static dboolean NET_SDL_RecvPacket(net_addr_t **addr, net_packet_t **packet)
+dboolean NET_SDL_RecvPacketFrom(int *socket, net_addr_t **addr, net_packet_t **packet)
 {
     int result;
+    int i;
 
-    result = SDLNet_UDP_Recv(udpsocket, recvpacket);
-
-    if (result < 0)
+    for (i=0; i<num_sockets; ++i)
     {
-        I_Error("NET_SDL_RecvPacket: Error receiving packet: %s",
-                SDLNet_GetError());
-    }
+        if (udpsockets[i] == NULL)
+        {
+            continue;
+        }
 
-    // no packets received
+        result = SDLNet_UDP_Recv(udpsockets[i], recvpacket);
 
-    if (result == 0)
-        return false;
+        if (result < 0)
+        {
+            I_Error("NET_SDL_RecvPacket: Error receiving packet: %s",
+                    SDLNet_GetError());
+        }
 
-    // Put the data into a new packet structure
+        // no packets received
 
-    *packet = NET_NewPacket(recvpacket->len);
-    memcpy((*packet)->data, recvpacket->data, recvpacket->len);
-    (*packet)->len = recvpacket->len;
+        if (result == 0)
+            continue;
 
-    // Address
+        // Put the data into a new packet structure
 
-    *addr = NET_SDL_FindAddress(&recvpacket->address);
+        *packet = NET_NewPacket(recvpacket->len);
+        memcpy((*packet)->data, recvpacket->data, recvpacket->len);
+        (*packet)->len = recvpacket->len;
 
-    return true;
+        // Address
+
+        *addr = NET_SDL_FindAddress(&recvpacket->address, i);
+        *socket = i;
+
+        return true;
+    }
+
+    return false;
+}
+
+static dboolean NET_SDL_RecvPacket(net_addr_t **addr, net_packet_t **packet)
+{
+    int socket;
+
+    return NET_SDL_RecvPacketFrom(&socket, addr, packet);
+}
+
+dboolean NET_SDL_WaitPacket(int timeout)
+{
+    if (timeout < 0)
+        timeout = 0;
+
+    return SDLNet_CheckSockets(socketset, (Uint32)timeout) > 0;
 }
 
 void NET_SDL_AddrToString(net_addr_t *addr, char *buffer, int buffer_len)
 {
     IPaddress *ip;
 
-    ip = (IPaddress *) addr->handle;
+    ip = &((addrpair_t *) addr->handle)->sdl_addr;
     
     snprintf(buffer, buffer_len, 
              "%i.%i.%i.%i",
@@ -346,7 +456,7 @@ net_addr_t *NET_SDL_ResolveAddress(char *address)
     }
     else
     {
-        return NET_SDL_FindAddress(&ip);
+        return NET_SDL_FindAddress(&ip, 0);
     }
 }
 
@@ -361,5 +471,6 @@ net_module_t net_sdl_module =
     NET_SDL_AddrToString,
     NET_SDL_FreeAddress,
     NET_SDL_ResolveAddress,
+    NET_SDL_WaitPacket,
 };
 
@@ -30,5 +30,13 @@
 
 extern net_module_t net_sdl_module;
 
+// Hosting several games in one process: each game gets its own port,
+// and packets are read from all of them at once
+
+int NET_SDL_Port(void);
+int NET_SDL_OpenPort(int port);
+dboolean NET_SDL_RecvPacketFrom(int *socket, net_addr_t **addr, net_packet_t **packet);
+dboolean NET_SDL_WaitPacket(int timeout);
+
 #endif /* #ifndef NET_SDL_H */
 
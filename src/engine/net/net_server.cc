@@ -56,6 +56,7 @@ typedef enum
 
 typedef struct 
 {
+    net_server_t *server;
     dboolean active;
     int player_number;
     net_addr_t *addr;
@@ -89,6 +90,22 @@ typedef struct
 
     md5_digest_t wad_md5sum;
 
+    // NET_FEATURE_* flags agreed with this client
+
+    int features;
+
+    // Statistics: the latest round trip the client reported, resend
+    // requests in each direction, and packet rates over the last second
+
+    int latency;
+    unsigned int resends_requested;
+    unsigned int resends_served;
+    int stats_time;
+    unsigned int stats_sent;
+    unsigned int stats_recv;
+    int packets_out;
+    int packets_in;
+
 } net_client_t;
 
 // structure used for the recv window
@@ -112,21 +129,34 @@ typedef struct
     net_ticdiff_t diff;
 } net_client_recv_t;
 
-static net_server_state_t server_state;
-static dboolean server_initialised = false;
-static net_client_t clients[MAXNETNODES];
-static net_client_t *sv_players[MAXPLAYERS];
-static net_context_t *server_context;
-static unsigned int sv_gamemode;
-static unsigned int sv_gamemission;
-static net_gamesettings_t sv_settings;
+// Everything about one game hosted by the server
+
+struct _net_server_s
+{
+    net_server_state_t state;
+    net_client_t clients[MAXNETNODES];
+    net_client_t *players[MAXPLAYERS];
+
+    // Context to receive packets from, or NULL if packets are handed
+    // over through NET_SV_ServerPacket
+
+    net_context_t *context;
+
+    unsigned int gamemode;
+    unsigned int gamemission;
+    net_gamesettings_t settings;
+
+    // receive window
+
+    unsigned int recvwindow_start;
+    net_client_recv_t recvwindow[BACKUPTICS][MAXPLAYERS];
+};
 
-// receive window
+// The server run by NET_SV_Init for a game hosted by a player
 
-static unsigned int recvwindow_start;
-static net_client_recv_t recvwindow[BACKUPTICS][MAXPLAYERS];
+static net_server_t *default_server;
 
-#define NET_SV_ExpandTicNum(b) NET_ExpandTicNum(recvwindow_start, (b))
+#define NET_SV_ExpandTicNum(sv, b) NET_ExpandTicNum((sv)->recvwindow_start, (b))
 
 static void NET_SV_DisconnectClient(net_client_t *client)
 {
@@ -165,7 +195,7 @@ static void NET_SV_SendConsoleMessage(net_client_t *client, char *s, ...)
 
 // Send a message to all clients
 
-static void NET_SV_BroadcastMessage(const char *s, ...)
+static void NET_SV_BroadcastMessage(net_server_t *sv, const char *s, ...)
 {
     char buf[1024];
     va_list args;
@@ -177,9 +207,9 @@ static void NET_SV_BroadcastMessage(const char *s, ...)
     
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]))
         {
-            NET_SV_SendConsoleMessage(&clients[i], buf);
+            NET_SV_SendConsoleMessage(&sv->clients[i], buf);
         }
     }
 
@@ -189,7 +219,7 @@ static void NET_SV_BroadcastMessage(const char *s, ...)
 
 // Assign player numbers to connected clients
 
-static void NET_SV_AssignPlayers(void)
+static void NET_SV_AssignPlayers(net_server_t *sv)
 {
     int i;
     int pl;
@@ -198,30 +228,30 @@ static void NET_SV_AssignPlayers(void)
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]))
         {
-            if (!clients[i].drone)
+            if (!sv->clients[i].drone)
             {
-                sv_players[pl] = &clients[i];
-                sv_players[pl]->player_number = pl;
+                sv->players[pl] = &sv->clients[i];
+                sv->players[pl]->player_number = pl;
                 ++pl;
             }
             else
             {
-                clients[i].player_number = -1;
+                sv->clients[i].player_number = -1;
             }
         }
     }
 
     for (; pl<MAXPLAYERS; ++pl)
     {
-        sv_players[pl] = NULL;
+        sv->players[pl] = NULL;
     }
 }
 
 // Returns the number of players currently connected.
 
-static int NET_SV_NumPlayers(void)
+static int NET_SV_NumPlayers(net_server_t *sv)
 {
     int i;
     int result;
@@ -230,7 +260,7 @@ static int NET_SV_NumPlayers(void)
 
     for (i=0; i<MAXPLAYERS; ++i)
     {
-        if (sv_players[i] != NULL && ClientConnected(sv_players[i]))
+        if (sv->players[i] != NULL && ClientConnected(sv->players[i]))
         {
             result += 1;
         }
@@ -241,7 +271,7 @@ static int NET_SV_NumPlayers(void)
 
 // Returns the number of drones currently connected.
 
-static int NET_SV_NumDrones(void)
+static int NET_SV_NumDrones(net_server_t *sv)
 {
     int i;
     int result;
@@ -250,7 +280,7 @@ static int NET_SV_NumDrones(void)
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]) && clients[i].drone)
+        if (ClientConnected(&sv->clients[i]) && sv->clients[i].drone)
         {
             result += 1;
         }
@@ -261,7 +291,7 @@ static int NET_SV_NumDrones(void)
 
 // returns the number of clients connected
 
-static int NET_SV_NumClients(void)
+static int NET_SV_NumClients(net_server_t *sv)
 {
     int count;
     int i;
@@ -270,7 +300,7 @@ static int NET_SV_NumClients(void)
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]))
         {
             ++count;
         }
@@ -282,18 +312,18 @@ static int NET_SV_NumClients(void)
 // Find the latest tic which has been acknowledged as received by
 // all clients.
 
-static unsigned int NET_SV_LatestAcknowledged(void)
+static unsigned int NET_SV_LatestAcknowledged(net_server_t *sv)
 {
     unsigned int lowtic = UINT_MAX;
     int i;
 
     for (i=0; i<MAXNETNODES; ++i) 
     {
-        if (ClientConnected(&clients[i]))
+        if (ClientConnected(&sv->clients[i]))
         {
-            if (clients[i].acknowledged < lowtic)
+            if (sv->clients[i].acknowledged < lowtic)
             {
-                lowtic = clients[i].acknowledged;
+                lowtic = sv->clients[i].acknowledged;
             }
         }
     }
@@ -305,21 +335,21 @@ static unsigned int NET_SV_LatestAcknowledged(void)
 // Possibly advance the recv window if all connected clients have
 // used the data in the window
 
-static void NET_SV_AdvanceWindow(void)
+static void NET_SV_AdvanceWindow(net_server_t *sv)
 {
     unsigned int lowtic;
     int i;
 
-    if (NET_SV_NumPlayers() <= 0)
+    if (NET_SV_NumPlayers(sv) <= 0)
     {
         return;
     }
 
-    lowtic = NET_SV_LatestAcknowledged();
+    lowtic = NET_SV_LatestAcknowledged(sv);
 
     // Advance the recv window until it catches up with lowtic
 
-    while (recvwindow_start < lowtic)
+    while (sv->recvwindow_start < lowtic)
     {    
         dboolean should_advance;
 
@@ -330,12 +360,12 @@ static void NET_SV_AdvanceWindow(void)
 
         for (i=0; i<MAXPLAYERS; ++i)
         {
-            if (sv_players[i] == NULL || !ClientConnected(sv_players[i]))
+            if (sv->players[i] == NULL || !ClientConnected(sv->players[i]))
             {
                 continue;
             }
 
-            if (!recvwindow[0][i].active)
+            if (!sv->recvwindow[0][i].active)
             {
                 should_advance = false;
                 break;
@@ -353,9 +383,9 @@ static void NET_SV_AdvanceWindow(void)
         
         // Advance the window
 
-        memcpy(recvwindow, recvwindow + 1, sizeof(*recvwindow) * (BACKUPTICS - 1));
-        memset(&recvwindow[BACKUPTICS-1], 0, sizeof(*recvwindow));
-        ++recvwindow_start;
+        memcpy(sv->recvwindow, sv->recvwindow + 1, sizeof(*sv->recvwindow) * (BACKUPTICS - 1));
+        memset(&sv->recvwindow[BACKUPTICS-1], 0, sizeof(*sv->recvwindow));
+        ++sv->recvwindow_start;
 
         //printf("SV: advanced to %i\n", recvwindow_start);
     }
@@ -363,7 +393,7 @@ static void NET_SV_AdvanceWindow(void)
 
 // returns a pointer to the client which controls the server
 
-static net_client_t *NET_SV_Controller(void)
+static net_client_t *NET_SV_Controller(net_server_t *sv)
 {
     int i;
 
@@ -371,9 +401,9 @@ static net_client_t *NET_SV_Controller(void)
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (ClientConnected(&clients[i]) && !clients[i].drone)
+        if (ClientConnected(&sv->clients[i]) && !sv->clients[i].drone)
         {
-            return &clients[i];
+            return &sv->clients[i];
         }
     }
 
@@ -382,17 +412,17 @@ static net_client_t *NET_SV_Controller(void)
 
 // Given an address, find the corresponding client
 
-static net_client_t *NET_SV_FindClient(net_addr_t *addr)
+static net_client_t *NET_SV_FindClient(net_server_t *sv, net_addr_t *addr)
 {
     int i;
 
     for (i=0; i<MAXNETNODES; ++i) 
     {
-        if (clients[i].active && clients[i].addr == addr)
+        if (sv->clients[i].active && sv->clients[i].addr == addr)
         {
             // found the client
 
-            return &clients[i];
+            return &sv->clients[i];
         }
     }
 
@@ -430,12 +460,43 @@ static void NET_SV_InitNewClient(net_client_t *client,
 
     client->last_gamedata_time = 0;
 
+    client->latency = 0;
+    client->resends_requested = 0;
+    client->resends_served = 0;
+    client->stats_time = I_GetTimeMS();
+    client->stats_sent = 0;
+    client->stats_recv = 0;
+    client->packets_out = 0;
+    client->packets_in = 0;
+
     memset(client->sendqueue, 0xff, sizeof(client->sendqueue));
 }
 
 // parse a SYN from a client(initiating a connection)
 
-static void NET_SV_ParseSYN(net_packet_t *packet, 
+// Protocol features this server will agree to
+
+static int NET_SV_Features(void)
+{
+    int features = NET_FEATURE_COMPACT_TICS;
+
+    //!
+    // @category net
+    //
+    // Send and receive ticcmds in the original uncompressed format,
+    // even to clients that support the compact one.
+    //
+
+    if (M_CheckParm("-nocompacttics") > 0)
+    {
+        features &= ~NET_FEATURE_COMPACT_TICS;
+    }
+
+    return features;
+}
+
+static void NET_SV_ParseSYN(net_server_t *sv,
+                            net_packet_t *packet, 
                             net_client_t *client,
                             net_addr_t *addr)
 {
@@ -443,6 +504,7 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
     unsigned int cl_gamemode=0, cl_gamemission=0;
     unsigned int cl_recording_lowres=0;
     unsigned int cl_drone;
+    unsigned int cl_features;
     md5_digest_t wad_md5sum;
     char *player_name;
     char *client_version;
@@ -517,12 +579,19 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
     {
         return;
     }
+
+    // Optional features the client supports; older clients send none
+
+    if (!NET_ReadInt8(packet, &cl_features))
+    {
+        cl_features = 0;
+    }
     
     // received a valid SYN
 
     // not accepting new connections?
     
-    if (server_state != SERVER_WAITING_START)
+    if (sv->state != SERVER_WAITING_START)
     {
         NET_SV_SendReject(addr, "Server is not currently accepting connections");
         return;
@@ -536,9 +605,9 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
 
         for (i=0; i<MAXNETNODES; ++i)
         {
-            if (!clients[i].active)
+            if (!sv->clients[i].active)
             {
-                client = &clients[i];
+                client = &sv->clients[i];
                 break;
             }
         }
@@ -568,11 +637,11 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
         // Before accepting a new client, check that there is a slot
         // free
 
-        NET_SV_AssignPlayers();
-        num_players = NET_SV_NumPlayers();
+        NET_SV_AssignPlayers(sv);
+        num_players = NET_SV_NumPlayers(sv);
 
         if ((!cl_drone && num_players >= MAXPLAYERS)
-         || NET_SV_NumClients() >= MAXNETNODES)
+         || NET_SV_NumClients(sv) >= MAXNETNODES)
         {
             NET_SV_SendReject(addr, "Server is full!");
             return;
@@ -586,8 +655,8 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
 
         if (num_players == 0 && !cl_drone)
         {
-            sv_gamemode = cl_gamemode;
-            sv_gamemission = cl_gamemission;
+            sv->gamemode = cl_gamemode;
+            sv->gamemission = cl_gamemission;
         }
 
         // Save the MD5 checksums
@@ -597,7 +666,7 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
         // Check the connecting client is playing the same game as all
         // the other clients
 
-        if (cl_gamemode != sv_gamemode || cl_gamemission != sv_gamemission)
+        if (cl_gamemode != sv->gamemode || cl_gamemission != sv->gamemission)
         {
             NET_SV_SendReject(addr, "You are playing the wrong game!");
             return;
@@ -609,6 +678,7 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
 
         client->recording_lowres = cl_recording_lowres;
         client->drone = cl_drone;
+        client->features = cl_features & NET_SV_Features();
     }
 
     if (client->connection.state == NET_CONN_STATE_WAITING_ACK)
@@ -622,12 +692,13 @@ static void NET_SV_ParseSYN(net_packet_t *packet,
 
 static void NET_SV_ParseGameStart(net_packet_t *packet, net_client_t *client)
 {
+    net_server_t *sv = client->server;
     net_gamesettings_t settings;
     net_packet_t *startpacket;
     int nowtime;
     int i;
     
-    if (client != NET_SV_Controller())
+    if (client != NET_SV_Controller(sv))
     {
         // Only the controller can start a new game
 
@@ -648,7 +719,7 @@ static void NET_SV_ParseGameStart(net_packet_t *packet, net_client_t *client)
         return;
     }
 
-    if (server_state != SERVER_WAITING_START)
+    if (sv->state != SERVER_WAITING_START)
     {
         // Can only start a game if we are in the waiting start state.
 
@@ -657,7 +728,7 @@ static void NET_SV_ParseGameStart(net_packet_t *packet, net_client_t *client)
 
     // Assign player numbers
 
-    NET_SV_AssignPlayers();
+    NET_SV_AssignPlayers(sv);
 
     // Check if anyone is recording a demo and set lowres_turn if so.
 
@@ -665,7 +736,7 @@ static void NET_SV_ParseGameStart(net_packet_t *packet, net_client_t *client)
 
     for (i=0; i<MAXPLAYERS; ++i)
     {
-        if (sv_players[i] != NULL && sv_players[i]->recording_lowres)
+        if (sv->players[i] != NULL && sv->players[i]->recording_lowres)
         {
             settings.lowres_turn = true;
         }
@@ -677,32 +748,34 @@ static void NET_SV_ParseGameStart(net_packet_t *packet, net_client_t *client)
 
     for (i=0; i<MAXNETNODES; ++i) 
     {
-        if (!ClientConnected(&clients[i]))
+        if (!ClientConnected(&sv->clients[i]))
             continue;
 
-        clients[i].last_gamedata_time = nowtime;
+        sv->clients[i].last_gamedata_time = nowtime;
 
-        startpacket = NET_Conn_NewReliable(&clients[i].connection,
+        startpacket = NET_Conn_NewReliable(&sv->clients[i].connection,
                                            NET_PACKET_TYPE_GAMESTART);
 
-        NET_WriteInt8(startpacket, NET_SV_NumPlayers());
-        NET_WriteInt8(startpacket, clients[i].player_number);
+        NET_WriteInt8(startpacket, NET_SV_NumPlayers(sv));
+        NET_WriteInt8(startpacket, sv->clients[i].player_number);
         NET_WriteSettings(startpacket, &settings);
+        NET_WriteInt8(startpacket, sv->clients[i].features);
     }
 
     // Change server state
 
-    server_state = SERVER_IN_GAME;
-    sv_settings = settings;
+    sv->state = SERVER_IN_GAME;
+    sv->settings = settings;
 
-    memset(recvwindow, 0, sizeof(recvwindow));
-    recvwindow_start = 0;
+    memset(sv->recvwindow, 0, sizeof(sv->recvwindow));
+    sv->recvwindow_start = 0;
 }
 
 // Send a resend request to a client
 
 static void NET_SV_SendResendRequest(net_client_t *client, int start, int end)
 {
+    net_server_t *sv = client->server;
     net_packet_t *packet;
     net_client_recv_t *recvobj;
     int i;
@@ -720,13 +793,15 @@ static void NET_SV_SendResendRequest(net_client_t *client, int start, int end)
     NET_Conn_SendPacket(&client->connection, packet);
     NET_FreePacket(packet);
 
+    ++client->resends_requested;
+
     // Store the time we send the resend request
 
     nowtime = I_GetTimeMS();
 
     for (i=start; i<=end; ++i)
     {
-        index = i - recvwindow_start;
+        index = i - sv->recvwindow_start;
 
         if (index >= BACKUPTICS)
         {
@@ -735,7 +810,7 @@ static void NET_SV_SendResendRequest(net_client_t *client, int start, int end)
             continue;
         }
         
-        recvobj = &recvwindow[index][client->player_number];
+        recvobj = &sv->recvwindow[index][client->player_number];
 
         recvobj->resend_time = nowtime;
     }
@@ -745,6 +820,7 @@ static void NET_SV_SendResendRequest(net_client_t *client, int start, int end)
 
 static void NET_SV_CheckResends(net_client_t *client)
 {
+    net_server_t *sv = client->server;
     int i;
     int player;
     int resend_start, resend_end;
@@ -761,7 +837,7 @@ static void NET_SV_CheckResends(net_client_t *client)
         net_client_recv_t *recvobj;
         dboolean need_resend;
 
-        recvobj = &recvwindow[i][player];
+        recvobj = &sv->recvwindow[i][player];
 
         // if need_resend is true, this tic needs another retransmit
         // request (300ms timeout)
@@ -789,8 +865,8 @@ static void NET_SV_CheckResends(net_client_t *client)
 
                 //printf("SV: resend request timed out: %i-%i\n", resend_start, resend_end);
                 NET_SV_SendResendRequest(client, 
-                                         recvwindow_start + resend_start,
-                                         recvwindow_start + resend_end);
+                                         sv->recvwindow_start + resend_start,
+                                         sv->recvwindow_start + resend_end);
 
                 resend_start = -1;
             }
@@ -800,8 +876,8 @@ static void NET_SV_CheckResends(net_client_t *client)
     if (resend_start >= 0)
     {
         NET_SV_SendResendRequest(client, 
-                                 recvwindow_start + resend_start,
-                                 recvwindow_start + resend_end);
+                                 sv->recvwindow_start + resend_start,
+                                 sv->recvwindow_start + resend_end);
     }
 }
 
@@ -809,7 +885,9 @@ static void NET_SV_CheckResends(net_client_t *client)
 
 static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
 {
+    net_server_t *sv = client->server;
     net_client_recv_t *recvobj;
+    net_full_ticcmd_t cmds[256];
     unsigned int seq;
     unsigned int ackseq;
     unsigned int num_tics;
@@ -819,7 +897,7 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
     int resend_start, resend_end;
     int index;
 
-    if (server_state != SERVER_IN_GAME)
+    if (sv->state != SERVER_IN_GAME)
     {
         return;
     }
@@ -847,23 +925,46 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
 
     // Expand 8-bit values to the full sequence number
 
-    ackseq = NET_SV_ExpandTicNum(ackseq);
-    seq = NET_SV_ExpandTicNum(seq);
+    ackseq = NET_SV_ExpandTicNum(sv, ackseq);
+    seq = NET_SV_ExpandTicNum(sv, seq);
 
-    // Sanity checks
+    // Read the tics.  Each carries this client's command in slot 0.
 
-    for (i=0; i<num_tics; ++i)
+    if (client->features & NET_FEATURE_COMPACT_TICS)
     {
-        net_ticdiff_t diff;
-        signed int latency;
-
-        if (!NET_ReadSInt16(packet, &latency)
-         || !NET_ReadTiccmdDiff(packet, &diff, 0))
+        if (!NET_ReadCompactTiccmds(packet, cmds, num_tics))
         {
             return;
         }
 
-        index = seq + i - recvwindow_start;
+        for (i=0; i<num_tics; ++i)
+        {
+            if (!cmds[i].playeringame[0])
+            {
+                return;
+            }
+        }
+    }
+    else
+    {
+        for (i=0; i<num_tics; ++i)
+        {
+            if (!NET_ReadSInt16(packet, &cmds[i].latency)
+             || !NET_ReadTiccmdDiff(packet, &cmds[i].cmds[0], 0))
+            {
+                return;
+            }
+        }
+    }
+
+    // Sanity checks
+
+    for (i=0; i<num_tics; ++i)
+    {
+        net_ticdiff_t diff = cmds[i].cmds[0];
+        signed int latency = cmds[i].latency;
+
+        index = seq + i - sv->recvwindow_start;
 
         if (index < 0 || index >= BACKUPTICS)
         {
@@ -872,11 +973,12 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
             continue;
         }
 
-        recvobj = &recvwindow[index][player];
+        recvobj = &sv->recvwindow[index][player];
         recvobj->active = true;
         recvobj->diff = diff;
         recvobj->latency = latency;
 
+        client->latency = latency;
         client->last_gamedata_time = nowtime;
     }
 
@@ -893,7 +995,7 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
 
     //printf("SV: %p: %i\n", client, seq);
 
-    resend_end = seq - recvwindow_start;
+    resend_end = seq - sv->recvwindow_start;
 
     if (resend_end <= 0)
         return;
@@ -906,7 +1008,7 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
     
     while (index >= 0)
     {
-        recvobj = &recvwindow[index][player];
+        recvobj = &sv->recvwindow[index][player];
 
         if (recvobj->active)
         {
@@ -932,21 +1034,22 @@ static void NET_SV_ParseGameData(net_packet_t *packet, net_client_t *client)
     {
             /*
         printf("missed %i-%i before %i, send resend\n",
-                        recvwindow_start + resend_start,
-                        recvwindow_start + resend_end - 1,
+                        sv->recvwindow_start + resend_start,
+                        sv->recvwindow_start + resend_end - 1,
                         seq);
                         */
         NET_SV_SendResendRequest(client, 
-                                 recvwindow_start + resend_start, 
-                                 recvwindow_start + resend_end - 1);
+                                 sv->recvwindow_start + resend_start, 
+                                 sv->recvwindow_start + resend_end - 1);
     }
 }
 
 static void NET_SV_ParseGameDataACK(net_packet_t *packet, net_client_t *client)
 {
+    net_server_t *sv = client->server;
     unsigned int ackseq;
 
-    if (server_state != SERVER_IN_GAME)
+    if (sv->state != SERVER_IN_GAME)
     {
         return;
     }
@@ -960,7 +1063,7 @@ static void NET_SV_ParseGameDataACK(net_packet_t *packet, net_client_t *client)
 
     // Expand 8-bit values to the full sequence number
 
-    ackseq = NET_SV_ExpandTicNum(ackseq);
+    ackseq = NET_SV_ExpandTicNum(sv, ackseq);
 
     // Higher acknowledgement point than we already have?
 
@@ -973,6 +1076,7 @@ static void NET_SV_ParseGameDataACK(net_packet_t *packet, net_client_t *client)
 static void NET_SV_SendTics(net_client_t *client, 
                             unsigned int start, unsigned int end)
 {
+    net_full_ticcmd_t cmds[256];
     net_packet_t *packet;
     unsigned int i;
 
@@ -1000,7 +1104,19 @@ static void NET_SV_SendTics(net_client_t *client,
 
         // Add command
        
-        NET_WriteFullTiccmd(packet, cmd, 0);
+        if (client->features & NET_FEATURE_COMPACT_TICS)
+        {
+            cmds[i - start] = *cmd;
+        }
+        else
+        {
+            NET_WriteFullTiccmd(packet, cmd, 0);
+        }
+    }
+
+    if (client->features & NET_FEATURE_COMPACT_TICS)
+    {
+        NET_WriteCompactTiccmds(packet, cmds, end - start + 1);
     }
     
     // Send packet
@@ -1052,11 +1168,12 @@ static void NET_SV_ParseResendRequest(net_packet_t *packet, net_client_t *client
     // Resend those tics
 
     NET_SV_SendTics(client, start, last);
+    ++client->resends_served;
 }
 
 // Send a response back to the client
 
-void NET_SV_SendQueryResponse(net_addr_t *addr)
+static void NET_SV_SendQueryResponse(net_server_t *sv, net_addr_t *addr)
 {
     net_packet_t *reply;
     net_querydata_t querydata;
@@ -1067,17 +1184,17 @@ void NET_SV_SendQueryResponse(net_addr_t *addr)
 
     // Server state
 
-    querydata.server_state = server_state;
+    querydata.server_state = sv->state;
 
     // Number of players/maximum players
 
-    querydata.num_players = NET_SV_NumPlayers();
+    querydata.num_players = NET_SV_NumPlayers(sv);
     querydata.max_players = MAXPLAYERS;
 
     // Game mode/mission
 
-    querydata.gamemode = sv_gamemode;
-    querydata.gamemission = sv_gamemission;
+    querydata.gamemode = sv->gamemode;
+    querydata.gamemission = sv->gamemission;
 
     // Server description.  This is currently hard-coded.
 
@@ -1092,8 +1209,48 @@ void NET_SV_SendQueryResponse(net_addr_t *addr)
     NET_FreePacket(reply);
 }
 
+// Send the per-client statistics back to whoever asked
+
+static void NET_SV_SendStatsResponse(net_server_t *sv, net_addr_t *addr)
+{
+    net_packet_t *reply;
+    net_clientstats_t stats;
+    int num_clients;
+    int i;
+
+    num_clients = NET_SV_NumClients(sv);
+
+    reply = NET_NewPacket(64 + num_clients * 32);
+    NET_WriteInt16(reply, NET_PACKET_TYPE_STATS_RESPONSE);
+    NET_WriteInt8(reply, num_clients);
+
+    for (i=0; i<MAXNETNODES; ++i)
+    {
+        net_client_t *client = &sv->clients[i];
+
+        if (!ClientConnected(client))
+        {
+            continue;
+        }
+
+        stats.name = client->name;
+        stats.player_number = client->drone ? -1 : client->player_number;
+        stats.latency = client->latency;
+        stats.resends_requested = client->resends_requested;
+        stats.resends_served = client->resends_served;
+        stats.packets_in = client->packets_in;
+        stats.packets_out = client->packets_out;
+
+        NET_WriteClientStats(reply, &stats);
+    }
+
+    NET_SendPacket(addr, reply);
+    NET_FreePacket(reply);
+}
+
 static void NET_SV_ParseCheatRequest(net_packet_t* packet, net_client_t *client)
 {
+    net_server_t *sv = client->server;
     int player;
     char *buff;
     int type;
@@ -1115,8 +1272,8 @@ static void NET_SV_ParseCheatRequest(net_packet_t* packet, net_client_t *client)
 
     for(i = 0; i < MAXNETNODES; ++i)
     {
-        if(clients[i].active)
-            NET_Conn_SendPacket(&clients[i].connection, packet2);
+        if(sv->clients[i].active)
+            NET_Conn_SendPacket(&sv->clients[i].connection, packet2);
     }
 
     NET_FreePacket(packet2);
@@ -1124,14 +1281,14 @@ static void NET_SV_ParseCheatRequest(net_packet_t* packet, net_client_t *client)
 
 // Process a packet received by the server
 
-static void NET_SV_Packet(net_packet_t *packet, net_addr_t *addr)
+static void NET_SV_Packet(net_server_t *sv, net_packet_t *packet, net_addr_t *addr)
 {
     net_client_t *client;
     unsigned int packet_type;
 
     // Find which client this packet came from
 
-    client = NET_SV_FindClient(addr);
+    client = NET_SV_FindClient(sv, addr);
 
     // Read the packet type
 
@@ -1144,11 +1301,15 @@ static void NET_SV_Packet(net_packet_t *packet, net_addr_t *addr)
 
     if (packet_type == NET_PACKET_TYPE_SYN)
     {
-        NET_SV_ParseSYN(packet, client, addr);
+        NET_SV_ParseSYN(sv, packet, client, addr);
     }
     else if (packet_type == NET_PACKET_TYPE_QUERY)
     {
-        NET_SV_SendQueryResponse(addr);
+        NET_SV_SendQueryResponse(sv, addr);
+    }
+    else if (packet_type == NET_PACKET_TYPE_STATS_QUERY)
+    {
+        NET_SV_SendStatsResponse(sv, addr);
     }
     else if (client == NULL)
     {
@@ -1189,7 +1350,7 @@ static void NET_SV_Packet(net_packet_t *packet, net_addr_t *addr)
     // If this address is not in the list of clients, be sure to
     // free it back.
 
-    if (NET_SV_FindClient(addr) == NULL)
+    if (NET_SV_FindClient(sv, addr) == NULL)
     {
         NET_FreeAddress(addr);
     }
@@ -1198,16 +1359,17 @@ static void NET_SV_Packet(net_packet_t *packet, net_addr_t *addr)
 
 static void NET_SV_SendWaitingData(net_client_t *client)
 {
+    net_server_t *sv = client->server;
     net_packet_t *packet;
     net_client_t *controller;
     int num_players;
     int i;
 
-    NET_SV_AssignPlayers();
+    NET_SV_AssignPlayers(sv);
 
-    controller = NET_SV_Controller();
+    controller = NET_SV_Controller(sv);
 
-    num_players = NET_SV_NumPlayers();
+    num_players = NET_SV_NumPlayers(sv);
 
     // time to send the client another status packet
 
@@ -1220,7 +1382,7 @@ static void NET_SV_SendWaitingData(net_client_t *client)
 
     // send the number of drone clients
 
-    NET_WriteInt8(packet, NET_SV_NumDrones());
+    NET_WriteInt8(packet, NET_SV_NumDrones(sv));
 
     // indicate whether the client is the controller
 
@@ -1238,11 +1400,11 @@ static void NET_SV_SendWaitingData(net_client_t *client)
 
         // name
 
-        NET_WriteString(packet, sv_players[i]->name);
+        NET_WriteString(packet, sv->players[i]->name);
 
         // address
 
-        addr = NET_AddrToString(sv_players[i]->addr);
+        addr = NET_AddrToString(sv->players[i]->addr);
 
         NET_WriteString(packet, addr);
     }
@@ -1266,6 +1428,7 @@ static void NET_SV_SendWaitingData(net_client_t *client)
 
 static void NET_SV_PumpSendQueue(net_client_t *client)
 {
+    net_server_t *sv = client->server;
     net_full_ticcmd_t cmd;
     int recv_index;
     int i;
@@ -1274,14 +1437,14 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
     // If a client has not sent any acknowledgments for a while,
     // wait until they catch up.
 
-    if (client->sendseq - NET_SV_LatestAcknowledged() > 40)
+    if (client->sendseq - NET_SV_LatestAcknowledged(sv) > 40)
     {
         return;
     }
     
     // Work out the index into the receive window
    
-    recv_index = client->sendseq - recvwindow_start;
+    recv_index = client->sendseq - sv->recvwindow_start;
 
     if (recv_index < 0 || recv_index >= BACKUPTICS)
     {
@@ -1293,19 +1456,19 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
 
     for (i=0; i<MAXPLAYERS; ++i)
     {
-        if (sv_players[i] == client)
+        if (sv->players[i] == client)
         {
             // Client does not rely on itself for data
 
             continue;
         }
 
-        if (sv_players[i] == NULL || !ClientConnected(sv_players[i]))
+        if (sv->players[i] == NULL || !ClientConnected(sv->players[i]))
         {
             continue;
         }
 
-        if (!recvwindow[recv_index][i].active)
+        if (!sv->recvwindow[recv_index][i].active)
         {
             // We do not have this player's ticcmd, so we cannot
             // generate a complete command yet.
@@ -1328,7 +1491,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
     {
         net_client_recv_t *recvobj;
 
-        if (sv_players[i] == client)
+        if (sv->players[i] == client)
         {
             // Not the player we are sending to
 
@@ -1336,7 +1499,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
             continue;
         }
         
-        if (sv_players[i] == NULL || !recvwindow[recv_index][i].active)
+        if (sv->players[i] == NULL || !sv->recvwindow[recv_index][i].active)
         {
             cmd.playeringame[i] = false;
             continue;
@@ -1344,7 +1507,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
 
         cmd.playeringame[i] = true;
 
-        recvobj = &recvwindow[recv_index][i];
+        recvobj = &sv->recvwindow[recv_index][i];
 
         cmd.cmds[i] = recvobj->diff;
 
@@ -1360,7 +1523,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
 
     // Transmit the new tic to the client
 
-    starttic = client->sendseq - sv_settings.extratics;
+    starttic = client->sendseq - sv->settings.extratics;
     endtic = client->sendseq;
 
     if (starttic < 0)
@@ -1380,6 +1543,7 @@ static void NET_SV_PumpSendQueue(net_client_t *client)
 
 void NET_SV_CheckDeadlock(net_client_t *client)
 {
+    net_server_t *sv = client->server;
     int nowtime;
     int i;
 
@@ -1401,38 +1565,41 @@ void NET_SV_CheckDeadlock(net_client_t *client)
 
         for (i=0; i<BACKUPTICS; ++i)
         {
-            if (!recvwindow[client->player_number][i].active)
+            if (!sv->recvwindow[client->player_number][i].active)
             {
                 //printf("Possible deadlock: Sending resend request\n");
 
                 // Found a tic we haven't received.  Send a resend request.
 
                 NET_SV_SendResendRequest(client,
-                                         recvwindow_start + i,
-                                         recvwindow_start + i + 5);
-
-                client->last_gamedata_time = nowtime;
+                                         sv->recvwindow_start + i,
+                                         sv->recvwindow_start + i + 5);
                 break;
             }
         }
+
+        // Check again in a second, whether or not anything was missing.
+        // New game data moves this along anyway.
+
+        client->last_gamedata_time = nowtime;
     }
 }
 
 // Called when all players have disconnected.  Return to listening for 
 // players to start a new game, and disconnect any drones still connected.
 
-static void NET_SV_GameEnded(void)
+static void NET_SV_GameEnded(net_server_t *sv)
 {
     int i;
 
-    server_state = SERVER_WAITING_START;
+    sv->state = SERVER_WAITING_START;
 //    sv_gamemode = indetermined;
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (clients[i].active)
+        if (sv->clients[i].active)
         {
-            NET_SV_DisconnectClient(&clients[i]);
+            NET_SV_DisconnectClient(&sv->clients[i]);
         }
     }
 }
@@ -1441,14 +1608,32 @@ static void NET_SV_GameEnded(void)
 
 static void NET_SV_RunClient(net_client_t *client)
 {
+    net_server_t *sv = client->server;
+    int nowtime;
+
     // Run common code
 
     NET_Conn_Run(&client->connection);
+
+    // Update the packet rates once a second
+
+    nowtime = I_GetTimeMS();
+
+    if (nowtime - client->stats_time >= 1000)
+    {
+        int elapsed = nowtime - client->stats_time;
+
+        client->packets_out = (client->connection.packets_sent - client->stats_sent) * 1000 / elapsed;
+        client->packets_in = (client->connection.packets_recv - client->stats_recv) * 1000 / elapsed;
+        client->stats_sent = client->connection.packets_sent;
+        client->stats_recv = client->connection.packets_recv;
+        client->stats_time = nowtime;
+    }
     
     if (client->connection.state == NET_CONN_STATE_DISCONNECTED
      && client->connection.disconnect_reason == NET_DISCONNECT_TIMEOUT)
     {
-        NET_SV_BroadcastMessage("Client '%s' timed out and disconnected",
+        NET_SV_BroadcastMessage(sv, "Client '%s' timed out and disconnected",
                                 client->name);
     }
     
@@ -1467,9 +1652,9 @@ static void NET_SV_RunClient(net_client_t *client)
         //
 	// Disconnect any drones still connected.
 
-        if (NET_SV_NumPlayers() <= 0)
+        if (NET_SV_NumPlayers(sv) <= 0)
         {
-            NET_SV_GameEnded();
+            NET_SV_GameEnded(sv);
         }
     }
     
@@ -1480,7 +1665,7 @@ static void NET_SV_RunClient(net_client_t *client)
         return;
     }
 
-    if (server_state == SERVER_WAITING_START)
+    if (sv->state == SERVER_WAITING_START)
     {
         // Waiting for the game to start
 
@@ -1494,43 +1679,106 @@ static void NET_SV_RunClient(net_client_t *client)
         }
     }
 
-    if (server_state == SERVER_IN_GAME)
+    if (sv->state == SERVER_IN_GAME)
     {
         NET_SV_PumpSendQueue(client);
         NET_SV_CheckDeadlock(client);
     }
 }
 
+// Allocate a server with no clients, waiting for players to join
+
+net_server_t *NET_SV_NewServer(void)
+{
+    net_server_t *sv;
+    int i;
+
+    sv = (net_server_t *) calloc(1, sizeof(net_server_t));
+
+    // no clients yet
+
+    for (i=0; i<MAXNETNODES; ++i)
+    {
+        sv->clients[i].server = sv;
+        sv->clients[i].active = false;
+    }
+
+    NET_SV_AssignPlayers(sv);
+
+    sv->state = SERVER_WAITING_START;
+//    sv_gamemode = indetermined;
+
+    return sv;
+}
+
 // Add a network module to the server context
 
 void NET_SV_AddModule(net_module_t *module)
 {
     module->InitServer();
-    NET_AddModule(server_context, module);
+    NET_AddModule(default_server->context, module);
 }
 
 // Initialise server and wait for connections
 
 void NET_SV_Init(void)
 {
-    int i;
+    default_server = NET_SV_NewServer();
 
     // initialise send/receive context
 
-    server_context = NET_NewContext();
+    default_server->context = NET_NewContext();
+}
 
-    // no clients yet
-   
-    for (i=0; i<MAXNETNODES; ++i) 
+// Handle a packet received for a server. The packet is not freed.
+
+void NET_SV_ServerPacket(net_server_t *sv, net_packet_t *packet, net_addr_t *addr)
+{
+    NET_SV_Packet(sv, packet, addr);
+}
+
+// Do the work a server has to do independent of the packets it
+// receives. Servers only touch their own state, so different
+// servers can be run at the same time.
+
+void NET_SV_RunServer(net_server_t *sv)
+{
+    net_addr_t *addr;
+    net_packet_t *packet;
+    int i;
+
+    if (sv->context != NULL)
     {
-        clients[i].active = false;
+        while (NET_RecvPacket(sv->context, &addr, &packet))
+        {
+            NET_SV_Packet(sv, packet, addr);
+            NET_FreePacket(packet);
+        }
     }
 
-    NET_SV_AssignPlayers();
+    // "Run" any clients that may have things to do, independent of responses
+    // to received packets
 
-    server_state = SERVER_WAITING_START;
-//    sv_gamemode = indetermined;
-    server_initialised = true;
+    for (i=0; i<MAXNETNODES; ++i)
+    {
+        if (sv->clients[i].active)
+        {
+            NET_SV_RunClient(&sv->clients[i]);
+        }
+    }
+
+    if (sv->state == SERVER_IN_GAME)
+    {
+        NET_SV_AdvanceWindow(sv);
+
+        for (i=0; i<MAXPLAYERS; ++i)
+        {
+            if (sv->players[i] != NULL && ClientConnected(sv->players[i]))
+            {
+                NET_SV_CheckResends(sv->players[i]);
+            }
+        }
+    }
 }
 
 // Run server code to check for new packets/send packets as the server
@@ -1538,44 +1786,104 @@ void NET_SV_Init(void)
 
 void NET_SV_Run(void)
 {
-    net_addr_t *addr;
-    net_packet_t *packet;
-    int i;
-
-    if (!server_initialised)
+    if (default_server == NULL)
     {
         return;
     }
 
-    while (NET_RecvPacket(server_context, &addr, &packet)) 
-    {
-        NET_SV_Packet(packet, addr);
-        NET_FreePacket(packet);
-    }
+    NET_SV_RunServer(default_server);
+}
 
-    // "Run" any clients that may have things to do, independent of responses
-    // to received packets
+// Work out how long the server can sleep before NET_SV_RunServer has
+// timed work to do: connection timers, the once a second waiting
+// data, deadlock checks and expired resend requests. Everything
+// else only happens in response to a packet.
+
+int NET_SV_NextEvent(net_server_t *sv)
+{
+    int nowtime;
+    int next;
+    int i, j;
+
+    nowtime = I_GetTimeMS();
+    next = 1000;
 
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (clients[i].active)
+        net_client_t *client = &sv->clients[i];
+        int wait;
+
+        if (!client->active)
+        {
+            continue;
+        }
+
+        wait = NET_Conn_NextEvent(&client->connection, nowtime);
+        next = MIN(next, wait);
+
+        wait = client->stats_time + 1000 - nowtime;
+        next = MIN(next, wait);
+
+        if (!ClientConnected(client))
+        {
+            continue;
+        }
+
+        if (sv->state == SERVER_WAITING_START)
+        {
+            if (client->last_send_time < 0)
+            {
+                return 0;
+            }
+
+            wait = client->last_send_time + 1001 - nowtime;
+            next = MIN(next, wait);
+        }
+        else if (sv->state == SERVER_IN_GAME && !client->drone)
         {
-            NET_SV_RunClient(&clients[i]);
+            wait = client->last_gamedata_time + 1001 - nowtime;
+            next = MIN(next, wait);
         }
     }
 
-    if (server_state == SERVER_IN_GAME)
+    if (sv->state == SERVER_IN_GAME)
     {
-        NET_SV_AdvanceWindow();
-
         for (i=0; i<MAXPLAYERS; ++i)
         {
-            if (sv_players[i] != NULL && ClientConnected(sv_players[i]))
+            if (sv->players[i] == NULL || !ClientConnected(sv->players[i]))
+            {
+                continue;
+            }
+
+            for (j=0; j<BACKUPTICS; ++j)
             {
-                NET_SV_CheckResends(sv_players[i]);
+                net_client_recv_t *recvobj = &sv->recvwindow[j][i];
+
+                if (!recvobj->active && recvobj->resend_time != 0)
+                {
+                    int wait = (int)recvobj->resend_time + 301 - nowtime;
+                    next = MIN(next, wait);
+                }
             }
         }
     }
+
+    // Every timer above is pushed forward when it fires, so an overdue
+    // one only means NET_SV_RunServer hasn't got to it yet
+
+    return next > 1 ? next : 1;
+}
+
+// Block until a packet arrives or the server has timed work to do
+
+void NET_SV_Wait(void)
+{
+    if (default_server == NULL)
+    {
+        return;
+    }
+
+    NET_WaitContext(default_server->context, NET_SV_NextEvent(default_server));
 }
 
 void NET_SV_Shutdown(void)
@@ -1583,8 +1891,9 @@ void NET_SV_Shutdown(void)
     int i;
     dboolean running;
     int start_time;
+    net_server_t *sv = default_server;
 
-    if (!server_initialised)
+    if (sv == NULL)
     {
         return;
     }
@@ -1595,9 +1904,9 @@ void NET_SV_Shutdown(void)
     
     for (i=0; i<MAXNETNODES; ++i)
     {
-        if (clients[i].active)
+        if (sv->clients[i].active)
         {
-            NET_SV_DisconnectClient(&clients[i]);
+            NET_SV_DisconnectClient(&sv->clients[i]);
         }
     }
 
@@ -1614,7 +1923,7 @@ void NET_SV_Shutdown(void)
 
         for (i=0; i<MAXNETNODES; ++i)
         {
-            if (clients[i].active)
+            if (sv->clients[i].active)
             {
                 running = true;
             }
@@ -1643,6 +1952,12 @@ void NET_SV_UpdateCvars(const Cvar &cvar)
 {
     net_packet_t *packet;
     int i;
+    net_server_t *sv = default_server;
+
+    if (sv == NULL)
+    {
+        return;
+    }
 
     // FIXME: Fix cvar sending from clients
 #if 0
@@ -1660,8 +1975,8 @@ void NET_SV_UpdateCvars(const Cvar &cvar)
 
     for(i = 0; i < MAXNETNODES; ++i)
     {
-        if(clients[i].active)
-            NET_Conn_SendPacket(&clients[i].connection, packet);
+        if(sv->clients[i].active)
+            NET_Conn_SendPacket(&sv->clients[i].connection, packet);
     }
 
     NET_FreePacket(packet);
@@ -25,6 +25,9 @@
 #define NET_SERVER_H
 
 #include <core/cvar.hh>
+#include "net_defs.h"
+
+typedef struct _net_server_s net_server_t;
 
 // initialise server and wait for connections
 
@@ -34,6 +37,10 @@ void NET_SV_Init(void);
 
 void NET_SV_Run(void);
 
+// Block until NET_SV_Run next has work to do
+
+void NET_SV_Wait(void);
+
 // Shut down the server
 // Blocks until all clients disconnect, or until a 5 second timeout
 
@@ -47,5 +54,25 @@ void NET_SV_AddModule(net_module_t *module);
 
 void NET_SV_UpdateCvars(const Cvar &cvar);
 
+//
+// Servers hosted side by side in one process. Each one is a separate
+// game; its owner hands it the packets received for it and runs it.
+// Different servers may be run from different threads.
+//
+
+net_server_t *NET_SV_NewServer(void);
+
+// Handle a packet received for the server. The caller frees the packet.
+
+void NET_SV_ServerPacket(net_server_t *sv, net_packet_t *packet, net_addr_t *addr);
+
+// Do the server's timed work: resends, keepalives, timeouts
+
+void NET_SV_RunServer(net_server_t *sv);
+
+// Milliseconds until NET_SV_RunServer next has timed work to do
+
+int NET_SV_NextEvent(net_server_t *sv);
+
 #endif /* #ifndef NET_SERVER_H */
 
@@ -99,6 +99,28 @@ void NET_WriteQueryData(net_packet_t *packet, net_querydata_t *query) {
     NET_WriteString(packet, query->description);
 }
 
+dboolean NET_ReadClientStats(net_packet_t *packet, net_clientstats_t *stats) {
+    stats->name = NET_ReadString(packet);
+
+    return stats->name != NULL
+           && NET_ReadSInt8(packet, &stats->player_number)
+           && NET_ReadSInt16(packet, &stats->latency)
+           && NET_ReadInt32(packet, (unsigned int *) &stats->resends_requested)
+           && NET_ReadInt32(packet, (unsigned int *) &stats->resends_served)
+           && NET_ReadInt16(packet, (unsigned int *) &stats->packets_in)
+           && NET_ReadInt16(packet, (unsigned int *) &stats->packets_out);
+}
+
+void NET_WriteClientStats(net_packet_t *packet, net_clientstats_t *stats) {
+    NET_WriteString(packet, stats->name);
+    NET_WriteInt8(packet, stats->player_number);
+    NET_WriteInt16(packet, stats->latency);
+    NET_WriteInt32(packet, stats->resends_requested);
+    NET_WriteInt32(packet, stats->resends_served);
+    NET_WriteInt16(packet, stats->packets_in);
+    NET_WriteInt16(packet, stats->packets_out);
+}
+
 void NET_WriteTiccmdDiff(net_packet_t *packet, net_ticdiff_t *diff,
                          dboolean lowres_turn) {
     // Header
@@ -314,6 +336,359 @@ void NET_WriteFullTiccmd(net_packet_t *packet, net_full_ticcmd_t *cmd, dboolean
     }
 }
 
+// 
+// Compact ticcmd runs
+//
+// Used instead of a series of full ticcmds when both ends agreed on
+// NET_FEATURE_COMPACT_TICS at connect time.  The tics are bit-packed:
+// playeringame and latency are only sent when they change from the
+// previous tic, and a player whose diff is empty for several tics in a
+// row is sent as a single run length rather than once per tic.
+// 
+
+typedef struct {
+    net_packet_t *packet;
+    unsigned int buffer;
+    int bits;
+} net_bitstream_t;
+
+static void NET_WriteBits(net_bitstream_t *stream, unsigned int value, int bits) {
+    while (bits-- > 0) {
+        stream->buffer = (stream->buffer << 1) | ((value >> bits) & 1);
+
+        if (++stream->bits == 8) {
+            NET_WriteInt8(stream->packet, stream->buffer);
+            stream->buffer = 0;
+            stream->bits = 0;
+        }
+    }
+}
+
+static void NET_FlushBits(net_bitstream_t *stream) {
+    if (stream->bits > 0) {
+        NET_WriteBits(stream, 0, 8 - stream->bits);
+    }
+}
+
+static dboolean NET_ReadBits(net_bitstream_t *stream, unsigned int *value, int bits) {
+    *value = 0;
+
+    while (bits-- > 0) {
+        if (stream->bits == 0) {
+            if (!NET_ReadInt8(stream->packet, &stream->buffer)) {
+                return false;
+            }
+            stream->bits = 8;
+        }
+
+        --stream->bits;
+        *value = (*value << 1) | ((stream->buffer >> stream->bits) & 1);
+    }
+
+    return true;
+}
+
+// Signed values that are usually small (turning, pitch) take 8 bits
+// rather than 17
+
+static void NET_WriteSmallSigned(net_bitstream_t *stream, int value) {
+    unsigned int zigzag = value < 0 ? (~(unsigned int) value << 1) | 1 : (unsigned int) value << 1;
+
+    if (zigzag < 128) {
+        NET_WriteBits(stream, 0, 1);
+        NET_WriteBits(stream, zigzag, 7);
+    } else {
+        NET_WriteBits(stream, 1, 1);
+        NET_WriteBits(stream, value & 0xffff, 16);
+    }
+}
+
+static dboolean NET_ReadSmallSigned(net_bitstream_t *stream, int *value) {
+    unsigned int large, val;
+
+    if (!NET_ReadBits(stream, &large, 1)) {
+        return false;
+    }
+
+    if (large) {
+        if (!NET_ReadBits(stream, &val, 16)) {
+            return false;
+        }
+        *value = (short) val;
+    } else {
+        if (!NET_ReadBits(stream, &val, 7)) {
+            return false;
+        }
+        *value = (val & 1) ? ~(int) (val >> 1) : (int) (val >> 1);
+    }
+
+    return true;
+}
+
+static void NET_WriteCompactDiff(net_bitstream_t *stream, net_ticdiff_t *diff) {
+    NET_WriteBits(stream, diff->diff, 8);
+
+    if (diff->diff & NET_TICDIFF_FORWARD)
+        NET_WriteBits(stream, diff->cmd.forwardmove & 0xff, 8);
+    if (diff->diff & NET_TICDIFF_SIDE)
+        NET_WriteBits(stream, diff->cmd.sidemove & 0xff, 8);
+    if (diff->diff & NET_TICDIFF_TURN)
+        NET_WriteSmallSigned(stream, diff->cmd.angleturn);
+    if (diff->diff & NET_TICDIFF_BUTTONS)
+        NET_WriteBits(stream, diff->cmd.buttons, 8);
+    if (diff->diff & NET_TICDIFF_CONSISTENCY)
+        NET_WriteBits(stream, diff->cmd.consistency, 8);
+    if (diff->diff & NET_TICDIFF_CHATCHAR)
+        NET_WriteBits(stream, diff->cmd.chatchar, 8);
+    if (diff->diff & NET_TICDIFF_BUTTONS2)
+        NET_WriteBits(stream, diff->cmd.buttons2, 8);
+    if (diff->diff & NET_TICDIFF_PITCH)
+        NET_WriteSmallSigned(stream, diff->cmd.pitch);
+}
+
+static dboolean NET_ReadCompactDiff(net_bitstream_t *stream, net_ticdiff_t *diff) {
+    unsigned int val;
+    int sval;
+
+    memset(&diff->cmd, 0, sizeof(ticcmd_t));
+
+    if (!NET_ReadBits(stream, &diff->diff, 8))
+        return false;
+
+    if (diff->diff & NET_TICDIFF_FORWARD) {
+        if (!NET_ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.forwardmove = (signed char) val;
+    }
+
+    if (diff->diff & NET_TICDIFF_SIDE) {
+        if (!NET_ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.sidemove = (signed char) val;
+    }
+
+    if (diff->diff & NET_TICDIFF_TURN) {
+        if (!NET_ReadSmallSigned(stream, &sval))
+            return false;
+        diff->cmd.angleturn = sval;
+    }
+
+    if (diff->diff & NET_TICDIFF_BUTTONS) {
+        if (!NET_ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.buttons = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_CONSISTENCY) {
+        if (!NET_ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.consistency = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_CHATCHAR) {
+        if (!NET_ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.chatchar = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_BUTTONS2) {
+        if (!NET_ReadBits(stream, &val, 8))
+            return false;
+        diff->cmd.buttons2 = val;
+    }
+
+    if (diff->diff & NET_TICDIFF_PITCH) {
+        if (!NET_ReadSmallSigned(stream, &sval))
+            return false;
+        diff->cmd.pitch = sval;
+    }
+
+    return true;
+}
+
+// Idle runs: 3 bits for runs of up to 7 tics, 11 for longer ones
+
+#define NET_MAXIDLERUN (7 + 255)
+
+static void NET_WriteIdleRun(net_bitstream_t *stream, int run) {
+    if (run - 1 < 7) {
+        NET_WriteBits(stream, run - 1, 3);
+    } else {
+        NET_WriteBits(stream, 7, 3);
+        NET_WriteBits(stream, run - 1 - 7, 8);
+    }
+}
+
+static dboolean NET_ReadIdleRun(net_bitstream_t *stream, int *run) {
+    unsigned int val, extra;
+
+    if (!NET_ReadBits(stream, &val, 3))
+        return false;
+
+    if (val == 7) {
+        if (!NET_ReadBits(stream, &extra, 8))
+            return false;
+        val += extra;
+    }
+
+    *run = val + 1;
+
+    return true;
+}
+
+void NET_WriteCompactTiccmds(net_packet_t *packet, net_full_ticcmd_t *cmds, int count) {
+    net_bitstream_t stream;
+    int idle[MAXPLAYERS];
+    dboolean same;
+    int run;
+    int i, p, t;
+
+    stream.packet = packet;
+    stream.buffer = 0;
+    stream.bits = 0;
+
+    memset(idle, 0, sizeof(idle));
+
+    for (t = 0; t < count; ++t) {
+        net_full_ticcmd_t *cmd = &cmds[t];
+
+        // Players in game
+
+        same = t > 0 && !memcmp(cmd->playeringame, cmds[t-1].playeringame,
+                                sizeof(cmd->playeringame));
+        NET_WriteBits(&stream, same, 1);
+
+        if (!same) {
+            for (p = 0; p < MAXPLAYERS; ++p) {
+                NET_WriteBits(&stream, cmd->playeringame[p], 1);
+            }
+        }
+
+        // Latency
+
+        same = t > 0 && cmd->latency == cmds[t-1].latency;
+        NET_WriteBits(&stream, same, 1);
+
+        if (!same) {
+            NET_WriteBits(&stream, cmd->latency & 0xffff, 16);
+        }
+
+        // Player commands
+
+        for (p = 0; p < MAXPLAYERS; ++p) {
+            if (!cmd->playeringame[p]) {
+                idle[p] = 0;
+                continue;
+            }
+
+            if (idle[p] > 0) {
+                // Covered by an earlier idle run
+                --idle[p];
+                continue;
+            }
+
+            if (cmd->cmds[p].diff == 0) {
+                // Count how long this player stays idle
+
+                for (run = 1, i = t + 1; i < count && run < NET_MAXIDLERUN; ++i, ++run) {
+                    if (!cmds[i].playeringame[p] || cmds[i].cmds[p].diff != 0)
+                        break;
+                }
+
+                NET_WriteBits(&stream, 1, 1);
+                NET_WriteIdleRun(&stream, run);
+                idle[p] = run - 1;
+            } else {
+                NET_WriteBits(&stream, 0, 1);
+                NET_WriteCompactDiff(&stream, &cmd->cmds[p]);
+            }
+        }
+    }
+
+    NET_FlushBits(&stream);
+}
+
+dboolean NET_ReadCompactTiccmds(net_packet_t *packet, net_full_ticcmd_t *cmds, int count) {
+    net_bitstream_t stream;
+    int idle[MAXPLAYERS];
+    unsigned int val;
+    int p, t;
+
+    stream.packet = packet;
+    stream.buffer = 0;
+    stream.bits = 0;
+
+    memset(idle, 0, sizeof(idle));
+
+    for (t = 0; t < count; ++t) {
+        net_full_ticcmd_t *cmd = &cmds[t];
+
+        // Players in game
+
+        if (!NET_ReadBits(&stream, &val, 1))
+            return false;
+
+        if (val) {
+            if (t == 0)
+                return false;
+
+            memcpy(cmd->playeringame, cmds[t-1].playeringame, sizeof(cmd->playeringame));
+        } else {
+            for (p = 0; p < MAXPLAYERS; ++p) {
+                if (!NET_ReadBits(&stream, &val, 1))
+                    return false;
+                cmd->playeringame[p] = val != 0;
+            }
+        }
+
+        // Latency
+
+        if (!NET_ReadBits(&stream, &val, 1))
+            return false;
+
+        if (val) {
+            if (t == 0)
+                return false;
+
+            cmd->latency = cmds[t-1].latency;
+        } else {
+            if (!NET_ReadBits(&stream, &val, 16))
+                return false;
+            cmd->latency = (short) val;
+        }
+
+        // Player commands
+
+        for (p = 0; p < MAXPLAYERS; ++p) {
+            if (!cmd->playeringame[p]) {
+                idle[p] = 0;
+                continue;
+            }
+
+            if (idle[p] > 0) {
+                --idle[p];
+                memset(&cmd->cmds[p], 0, sizeof(net_ticdiff_t));
+                continue;
+            }
+
+            if (!NET_ReadBits(&stream, &val, 1))
+                return false;
+
+            if (val) {
+                if (!NET_ReadIdleRun(&stream, &idle[p]))
+                    return false;
+
+                --idle[p];
+                memset(&cmd->cmds[p], 0, sizeof(net_ticdiff_t));
+            } else if (!NET_ReadCompactDiff(&stream, &cmd->cmds[p])) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 dboolean NET_ReadMD5Sum(net_packet_t *packet, md5_digest_t digest) {
     unsigned int b;
     int i;
@@ -32,6 +32,9 @@ extern dboolean NET_ReadSettings(net_packet_t *packet, net_gamesettings_t *setti
 extern void NET_WriteQueryData(net_packet_t *packet, net_querydata_t *querydata);
 extern dboolean NET_ReadQueryData(net_packet_t *packet, net_querydata_t *querydata);
 
+extern void NET_WriteClientStats(net_packet_t *packet, net_clientstats_t *stats);
+extern dboolean NET_ReadClientStats(net_packet_t *packet, net_clientstats_t *stats);
+
 extern void NET_WriteTiccmdDiff(net_packet_t *packet, net_ticdiff_t *diff, dboolean lowres_turn);
 extern dboolean NET_ReadTiccmdDiff(net_packet_t *packet, net_ticdiff_t *diff, dboolean lowres_turn);
 extern void NET_TiccmdDiff(ticcmd_t *tic1, ticcmd_t *tic2, net_ticdiff_t *diff);
@@ -40,6 +43,9 @@ extern void NET_TiccmdPatch(ticcmd_t *src, net_ticdiff_t *diff, ticcmd_t *dest);
 dboolean NET_ReadFullTiccmd(net_packet_t *packet, net_full_ticcmd_t *cmd, dboolean lowres_turn);
 void NET_WriteFullTiccmd(net_packet_t *packet, net_full_ticcmd_t *cmd, dboolean lowres_turn);
 
+dboolean NET_ReadCompactTiccmds(net_packet_t *packet, net_full_ticcmd_t *cmds, int count);
+void NET_WriteCompactTiccmds(net_packet_t *packet, net_full_ticcmd_t *cmds, int count);
+
 dboolean NET_ReadMD5Sum(net_packet_t *packet, md5_digest_t digest);
 void NET_WriteMD5Sum(net_packet_t *packet, md5_digest_t digest);
 
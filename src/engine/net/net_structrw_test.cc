@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include <climits>
+#include <cstring>
+#include <vector>
+
+#include "doomdef.h"
+#include "net_packet.h"
+#include "net_structrw.h"
+
+// NET_MAXIDLERUN in net_structrw.cc
+static const int max_idle_run = 7 + 255;
+
+std::vector<net_full_ticcmd_t> create_ticcmds(int count, int players)
+{
+    std::vector<net_full_ticcmd_t> cmds(count);
+
+    for (auto& cmd : cmds)
+    {
+        std::memset(&cmd, 0, sizeof(cmd));
+        cmd.latency = 100;
+
+        for (int p = 0; p < players; p++)
+            cmd.playeringame[p] = true;
+    }
+
+    return cmds;
+}
+
+void set_turn(net_full_ticcmd_t& cmd, int player, short angleturn, short pitch)
+{
+    cmd.cmds[player].diff |= NET_TICDIFF_TURN | NET_TICDIFF_PITCH;
+    cmd.cmds[player].cmd.angleturn = angleturn;
+    cmd.cmds[player].cmd.pitch = pitch;
+}
+
+size_t compact_size(std::vector<net_full_ticcmd_t>& cmds)
+{
+    auto packet = NET_NewPacket(10);
+    NET_WriteCompactTiccmds(packet, cmds.data(), static_cast<int>(cmds.size()));
+
+    size_t len = packet->len;
+    NET_FreePacket(packet);
+    return len;
+}
+
+void check_round_trip(std::vector<net_full_ticcmd_t>& in)
+{
+    int count = static_cast<int>(in.size());
+    std::vector<net_full_ticcmd_t> out(count);
+
+    auto packet = NET_NewPacket(10);
+    NET_WriteCompactTiccmds(packet, in.data(), count);
+
+    std::memset(out.data(), 0x55, sizeof(net_full_ticcmd_t) * count);
+    ASSERT_TRUE(NET_ReadCompactTiccmds(packet, out.data(), count));
+    ASSERT_EQ(packet->len, packet->pos);
+
+    for (int t = 0; t < count; t++)
+    {
+        ASSERT_EQ(in[t].latency, out[t].latency);
+
+        for (int p = 0; p < MAXPLAYERS; p++)
+        {
+            ASSERT_EQ(in[t].playeringame[p], out[t].playeringame[p]);
+            if (!in[t].playeringame[p])
+                continue;
+
+            ASSERT_EQ(in[t].cmds[p].diff, out[t].cmds[p].diff);
+            ASSERT_EQ(0, std::memcmp(&in[t].cmds[p].cmd, &out[t].cmds[p].cmd, sizeof(ticcmd_t)));
+        }
+    }
+
+    NET_FreePacket(packet);
+}
+
+TEST(CompactTiccmds, every_field)
+{
+    auto cmds = create_ticcmds(3, 2);
+
+    auto& diff = cmds[1].cmds[0];
+    diff.diff = 0xff;
+    diff.cmd.forwardmove = -50;
+    diff.cmd.sidemove = 40;
+    diff.cmd.angleturn = -512;
+    diff.cmd.buttons = 0x81;
+    diff.cmd.consistency = 0xaa;
+    diff.cmd.chatchar = 'x';
+    diff.cmd.buttons2 = 0x03;
+    diff.cmd.pitch = 12;
+
+    cmds[2].latency = -1000;
+    cmds[2].cmds[1].diff = NET_TICDIFF_FORWARD;
+    cmds[2].cmds[1].cmd.forwardmove = 127;
+
+    check_round_trip(cmds);
+}
+
+TEST(CompactTiccmds, players_joining_and_leaving)
+{
+    auto cmds = create_ticcmds(6, 2);
+
+    cmds[2].playeringame[2] = true;
+    cmds[3].playeringame[2] = true;
+    cmds[3].cmds[2].diff = NET_TICDIFF_BUTTONS;
+    cmds[3].cmds[2].cmd.buttons = 1;
+    cmds[4].playeringame[0] = false;
+    cmds[5].playeringame[0] = false;
+
+    check_round_trip(cmds);
+}
+
+TEST(CompactTiccmds, idle_runs)
+{
+    // Either side of the short run limit and of NET_MAXIDLERUN
+    for (int count : { 1, 7, 8, 9, max_idle_run - 1, max_idle_run, max_idle_run + 1, 2 * max_idle_run + 3 })
+    {
+        auto cmds = create_ticcmds(count, 2);
+
+        // Player 1 moves every tic while player 0 stays idle
+        for (auto& cmd : cmds)
+            set_turn(cmd, 1, 5, 0);
+
+        check_round_trip(cmds);
+    }
+}
+
+TEST(CompactTiccmds, idle_run_cut_short)
+{
+    auto cmds = create_ticcmds(max_idle_run + 20, 2);
+
+    // A move in the middle of a run, then a player leaving during one
+    set_turn(cmds[10], 0, 1, 1);
+    cmds[max_idle_run].playeringame[1] = false;
+
+    check_round_trip(cmds);
+}
+
+TEST(CompactTiccmds, small_signed_boundaries)
+{
+    for (short value : { 0, -1, 1, 63, -64, 64, -65, SHRT_MAX, SHRT_MIN })
+    {
+        auto cmds = create_ticcmds(1, 1);
+        set_turn(cmds[0], 0, value, value);
+        check_round_trip(cmds);
+
+        cmds[0].cmds[0].cmd.pitch = -value;
+        check_round_trip(cmds);
+    }
+
+    // 63 and -64 are the largest values that still fit in the short form
+    auto small = create_ticcmds(1, 1);
+    auto large = create_ticcmds(1, 1);
+
+    set_turn(small[0], 0, 63, -64);
+    set_turn(large[0], 0, 64, -64);
+    ASSERT_LT(compact_size(small), compact_size(large));
+
+    set_turn(large[0], 0, 63, -65);
+    ASSERT_LT(compact_size(small), compact_size(large));
+}
+
+TEST(CompactTiccmds, truncated)
+{
+    auto in = create_ticcmds(40, 3);
+    std::vector<net_full_ticcmd_t> out(in.size());
+
+    for (size_t t = 0; t < in.size(); t += 3)
+        set_turn(in[t], t % 2, static_cast<short>(t * 100), -static_cast<short>(t));
+
+    auto packet = NET_NewPacket(10);
+    NET_WriteCompactTiccmds(packet, in.data(), static_cast<int>(in.size()));
+
+    // Every cut short packet has to be rejected rather than read past
+    for (auto len = packet->len; len-- > 0;)
+    {
+        packet->len = len;
+        packet->pos = 0;
+        ASSERT_FALSE(NET_ReadCompactTiccmds(packet, out.data(), static_cast<int>(out.size())));
+    }
+
+    NET_FreePacket(packet);
+}
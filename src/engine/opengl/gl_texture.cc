@@ -36,9 +36,16 @@
 #include "p_local.h"
 #include "con_console.h"
 #include "g_actions.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <unordered_set>
 #include <easy/profiler.h>
 #include <wad/section.hh>
 #include <wad.hh>
+#include <system/thread_pool.hh>
 
 #define GL_MAX_TEX_UNITS    4
 
@@ -93,6 +100,42 @@ static int curunit = 0;
 extern BoolCvar r_texnonpowresize;
 extern BoolCvar r_fillmode;
 
+BoolCvar r_asynctextures("r_asynctextures", "Decode world textures and sprites in the background", true);
+FloatCvar r_texturebudget("r_texturebudget", "Milliseconds per frame spent uploading textures", 2.0f);
+
+//
+// Background texture decoding
+//
+// World textures and sprites that aren't in video memory are decoded on the
+// thread pool. The decoded images wait in texdecoded until GL_UploadTextures
+// hands them to GL on the main thread, and the dummy texture is bound in the
+// meantime. Dumping the textures bumps texgeneration, so that images which
+// were decoded for the old textures get thrown away.
+//
+
+enum {
+    TEXJOB_WORLD,
+    TEXJOB_SPRITE
+};
+
+typedef struct {
+    int                 kind;
+    int                 id;
+    int                 pal;
+    int                 generation;
+    Image               image;
+    std::exception_ptr  error;
+} texjob_t;
+
+static std::mutex               texdecodelock;
+static std::condition_variable  texdecodecond;
+static std::deque<texjob_t>     texdecoded;     // guarded by texdecodelock
+
+static std::unordered_set<uint64> texpending;   // main thread only
+static int                      texgeneration;
+
+static void SetTextureImage(byte* data, int bits, int *origwidth, int *origheight, int format, int type);
+
 BoolCvar r_texturecombiner("r_texturecombiner", "", true, 0,
                                [](const BoolCvar &, bool, bool&) {
                                    int i;
@@ -157,6 +200,197 @@ static void InitWorldTextures(void) {
     CON_DPrintf("%i world textures initialized\n", numtextures);
 }
 
+//
+// SetWorldTexture
+// Create the GL texture for a decoded world texture, and leave it bound.
+//
+
+static void SetWorldTexture(int texnum, int pal, Image& image) {
+    EASY_BLOCK("Bind texture");
+
+    dglGenTextures(1, &textureptr[texnum][pal]);
+    dglBindTexture(GL_TEXTURE_2D, textureptr[texnum][pal]);
+    dglTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width(), image.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                  image.data_ptr());
+
+    dglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    dglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    GL_CheckFillMode();
+    GL_SetTextureFilter();
+
+    // update global width and heights
+    texturewidth[texnum] = image.width();
+    textureheight[texnum] = image.height();
+}
+
+//
+// SetSpriteTexture
+// Create the GL texture for a decoded sprite, and leave it bound.
+//
+
+static void SetSpriteTexture(int spritenum, int pal, Image& image) {
+    dboolean npot;
+
+    // check for non-power of two textures
+    npot = GLAD_GL_ARB_texture_non_power_of_two;
+
+    if(!npot && r_texnonpowresize <= 0) {
+        r_texnonpowresize = 1;
+    }
+
+    dglGenTextures(1, &spriteptr[spritenum][pal]);
+    dglBindTexture(GL_TEXTURE_2D, spriteptr[spritenum][pal]);
+
+    dglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, DGL_CLAMP);
+    dglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, DGL_CLAMP);
+
+    int w = image.width(), h = image.height();
+    SetTextureImage(reinterpret_cast<byte*>(image.data_ptr()), 4, &w, &h, GL_RGBA8, GL_RGBA);
+
+    spritewidth[spritenum] = w;
+    spriteheight[spritenum] = h;
+    spriteoffset[spritenum] = image.sprite_offset().x;
+    spritetopoffset[spritenum] = image.sprite_offset().y;
+}
+
+//
+// GL_TextureJobKey
+//
+
+static uint64 GL_TextureJobKey(int kind, int id, int pal) {
+    return ((uint64)kind << 48) | ((uint64)(unsigned int)id << 16) | (uint64)(word)pal;
+}
+
+//
+// GL_QueueTexture
+// Decode a lump on the thread pool, unless it is already on its way.
+//
+
+static void GL_QueueTexture(int kind, int id, int pal, int lump) {
+    int generation;
+
+    if(!texpending.insert(GL_TextureJobKey(kind, id, pal)).second) {
+        return;
+    }
+
+    generation = texgeneration;
+
+    sys::ThreadPool::global().push([=] {
+        EASY_BLOCK("Decode texture", profiler::colors::Amber100);
+        texjob_t job;
+
+        job.kind = kind;
+        job.id = id;
+        job.pal = pal;
+        job.generation = generation;
+
+        // errors are raised on the main thread, as they would have been
+        try {
+            job.image = I_ReadImage(lump, false, true, true, pal);
+        }
+        catch(...) {
+            job.error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(texdecodelock);
+            texdecoded.push_back(std::move(job));
+        }
+
+        texdecodecond.notify_all();
+    });
+}
+
+//
+// GL_UploadTexture
+//
+
+static void GL_UploadTexture(texjob_t& job) {
+    // the textures were dumped while this one was being decoded
+    if(job.generation != texgeneration) {
+        return;
+    }
+
+    texpending.erase(GL_TextureJobKey(job.kind, job.id, job.pal));
+
+    if(job.error) {
+        std::rethrow_exception(job.error);
+    }
+
+    if(job.kind == TEXJOB_WORLD) {
+        if(!textureptr[job.id][job.pal]) {
+            SetWorldTexture(job.id, job.pal, job.image);
+        }
+    }
+    else {
+        if(!spriteptr[job.id][job.pal]) {
+            SetSpriteTexture(job.id, job.pal, job.image);
+        }
+    }
+}
+
+//
+// GL_UploadTextures
+// Hand decoded textures to GL until this frame's budget runs out. At least
+// one texture is uploaded per call, so a zero budget still makes progress.
+//
+
+void GL_UploadTextures(void) {
+    EASY_FUNCTION(profiler::colors::Amber);
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<float, std::milli> budget(*r_texturebudget);
+
+    for(;;) {
+        texjob_t job;
+
+        {
+            std::lock_guard<std::mutex> lock(texdecodelock);
+
+            if(texdecoded.empty()) {
+                break;
+            }
+
+            job = std::move(texdecoded.front());
+            texdecoded.pop_front();
+        }
+
+        GL_UploadTexture(job);
+
+        if(std::chrono::steady_clock::now() - start >= budget) {
+            break;
+        }
+    }
+
+    // uploading changed the bound texture
+    GL_ResetTextures();
+}
+
+//
+// GL_FlushTextures
+// Wait for every queued texture and upload them all.
+//
+
+void GL_FlushTextures(void) {
+    EASY_FUNCTION(profiler::colors::Amber);
+
+    while(!texpending.empty()) {
+        texjob_t job;
+
+        {
+            std::unique_lock<std::mutex> lock(texdecodelock);
+            texdecodecond.wait(lock, [] { return !texdecoded.empty(); });
+
+            job = std::move(texdecoded.front());
+            texdecoded.pop_front();
+        }
+
+        GL_UploadTexture(job);
+    }
+
+    GL_ResetTextures();
+}
+
 //
 // GL_BindWorldTexture
 //
@@ -194,26 +428,33 @@ void GL_BindWorldTexture(int texnum, int *width, int *height) {
         return;
     }
 
-    // create a new texture
-    auto image = I_ReadImage(wad::open(wad::Section::textures, texnum).value().lump_index(), false, true, true, palettetranslation[texnum]);
+    auto lump = wad::open(wad::Section::textures, texnum).value();
 
-    {
-        EASY_BLOCK("Bind texture");
-        dglGenTextures(1, &textureptr[texnum][palettetranslation[texnum]]);
-        dglBindTexture(GL_TEXTURE_2D, textureptr[texnum][palettetranslation[texnum]]);
-        dglTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width(), image.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE,
-                      image.data_ptr());
+    if(r_asynctextures) {
+        // the renderer works out texture coordinates from the size,
+        // so take it from the lump header rather than wait for the upload
+        if(!texturewidth[texnum] || !textureheight[texnum]) {
+            lump.read_image_size(texturewidth[texnum], textureheight[texnum]);
 
-        dglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        dglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            if(width) {
+                *width = texturewidth[texnum];
+            }
+            if(height) {
+                *height = textureheight[texnum];
+            }
+        }
+
+        // draw with the dummy until the texture has been uploaded
+        GL_QueueTexture(TEXJOB_WORLD, texnum, palettetranslation[texnum], lump.lump_index());
+        GL_BindDummyTexture();
+        curtexture = -1;
+        return;
     }
 
-    GL_CheckFillMode();
-    GL_SetTextureFilter();
+    // create a new texture
+    auto image = I_ReadImage(lump.lump_index(), false, true, true, palettetranslation[texnum]);
 
-    // update global width and heights
-    texturewidth[texnum] = image.width();
-    textureheight[texnum] = image.height();
+    SetWorldTexture(texnum, palettetranslation[texnum], image);
 
     if(width) {
         *width = texturewidth[texnum];
@@ -445,7 +686,6 @@ static void InitSpriteTextures(void) {
 
 void GL_BindSpriteTexture(int spritenum, int pal) {
     EASY_FUNCTION(profiler::colors::Amber);
-    dboolean npot;
 
     if(!r_fillmode) {
         return;
@@ -474,28 +714,19 @@ void GL_BindSpriteTexture(int spritenum, int pal) {
         return;
     }
 
-    auto image = I_ReadImage(wad::open(wad::Section::sprites, spritenum).value().lump_index(), false, true, true, pal);
+    auto lump = wad::open(wad::Section::sprites, spritenum).value().lump_index();
 
-    // check for non-power of two textures
-    npot = GLAD_GL_ARB_texture_non_power_of_two;
-
-    if(!npot && r_texnonpowresize <= 0) {
-        r_texnonpowresize = 1;
+    if(r_asynctextures) {
+        // draw with the dummy until the sprite has been uploaded
+        GL_QueueTexture(TEXJOB_SPRITE, spritenum, pal, lump);
+        GL_BindDummyTexture();
+        cursprite = -1;
+        return;
     }
 
-    dglGenTextures(1, &spriteptr[spritenum][pal]);
-    dglBindTexture(GL_TEXTURE_2D, spriteptr[spritenum][pal]);
+    auto image = I_ReadImage(lump, false, true, true, pal);
 
-    dglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, DGL_CLAMP);
-    dglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, DGL_CLAMP);
-
-    int w = image.width(), h = image.height();
-    SetTextureImage(reinterpret_cast<byte*>(image.data_ptr()), 4, &w, &h, GL_RGBA8, GL_RGBA);
-
-    spritewidth[spritenum] = w;
-    spriteheight[spritenum] = h;
-    spriteoffset[spritenum] = image.sprite_offset().x;
-    spritetopoffset[spritenum] = image.sprite_offset().y;
+    SetSpriteTexture(spritenum, pal, image);
 
     if(devparm) {
         glBindCalls++;
@@ -900,6 +1131,10 @@ void GL_DumpTextures(void) {
         return;
     }
 
+    // anything still being decoded is for the old textures
+    texgeneration++;
+    texpending.clear();
+
     for(i = 0; i < numtextures; i++) {
         GL_UnloadTexture(&textureptr[i][0]);
 
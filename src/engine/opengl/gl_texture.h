@@ -70,6 +70,8 @@ int         GL_PadTextureDims(int size);
 void        GL_SetNewPalette(int id, byte palID);
 void        GL_DumpTextures(void);
 void        GL_ResetTextures(void);
+void        GL_UploadTextures(void);
+void        GL_FlushTextures(void);
 void        GL_BindDummyTexture(void);
 void        GL_UpdateEnvTexture(rcolor color);
 void        GL_BindEnvTexture(void);
@@ -1,15 +1,8 @@
-#include <sstream>
 #include <map>
 #include <wad.hh>
 #include "Map.hh"
 
 namespace {
-  template <class T>
-  void read_into(std::istream& s, T& x)
-  {
-      s.read(reinterpret_cast<char*>(&x), sizeof(T));
-  }
-
   struct Header {
       char id[4];
       uint32 numlumps;
@@ -23,17 +16,23 @@ namespace {
   };
 
   struct MapLump {
-      String data;
+      StringView data;
   };
 
   std::vector<MapLump> lumps_;
 
+  StringView data_;
+
   std::map<int, int> texturehashlist_;
 }
 
 void* W_GetMapLump(int lump)
 {
-    return &lumps_[lump].data[0];
+    // Optional lumps may be left off the end of the directory
+    if (lump >= static_cast<int>(lumps_.size()))
+        return nullptr;
+
+    return const_cast<char*>(lumps_[lump].data.data());
 }
 
 void W_CacheMapLump(int map)
@@ -45,30 +44,37 @@ void W_CacheMapLump(int map)
     }
 
     lumps_.clear();
+    data_ = {};
 
-    auto& s = file->stream();
+    // The view is backed by the device and stays valid after the level is
+    // loaded, so the sub-lumps can point directly into it.
+    auto view = file->read_view();
 
     Header header;
-    read_into(s, header);
+    if (view.size() < sizeof(header)) {
+        log::fatal("MAP{:02d} is an invalid WAD", map);
+    }
+    memcpy(&header, view.data(), sizeof(header));
 
     if (memcmp(header.id, "IWAD", 4) != 0 && memcmp(header.id, "PWAD", 4)) {
         log::fatal("MAP{:02d} is an invalid WAD", map);
     }
 
     std::size_t numlumps = header.numlumps;
-    s.seekg(header.infotableofs);
-    for (std::size_t i = 0; !s.eof() && i < numlumps; ++i) {
+    std::size_t pos = header.infotableofs;
+    for (std::size_t i = 0; pos + sizeof(Directory) <= view.size() && i < numlumps; ++i) {
         Directory dir;
-        read_into(s, dir);
+        memcpy(&dir, view.data() + pos, sizeof(dir));
+        pos += sizeof(dir);
 
-        auto pos = s.tellg();
-        s.seekg(dir.filepos);
-        String str(dir.size, 0);
-        s.read(&str[0], dir.size);
-        s.seekg(pos);
+        if (dir.filepos > view.size() || dir.size > view.size() - dir.filepos) {
+            log::fatal("MAP{:02d} has a lump outside of the WAD", map);
+        }
 
-        lumps_.push_back({ std::move(str) });
+        lumps_.push_back({ view.substr(dir.filepos, dir.size) });
     }
+
+    data_ = view;
 }
 
 void W_FreeMapLump()
@@ -78,9 +84,17 @@ void W_FreeMapLump()
 
 int W_MapLumpLength(int lump)
 {
+    if (lump >= static_cast<int>(lumps_.size()))
+        return 0;
+
     return lumps_[lump].data.size();
 }
 
+StringView W_MapData()
+{
+    return data_;
+}
+
 //
 // P_InitTextureHashTable
 //
@@ -12,8 +12,20 @@ void W_FreeMapLump();
 
 int W_MapLumpLength(int lump);
 
+/*! The whole map lump, as a nested WAD */
+StringView W_MapData();
+
 void P_InitTextureHashTable(void);
 
 uint32 P_GetTextureHashKey(int hash);
 
+/*!
+ * Load the level geometry from the packed map cache. Returns false if there's
+ * no valid cache for the current map lump.
+ */
+bool P_LoadPackedMap();
+
+/*! Write the level geometry that was just built to the packed map cache */
+void P_SavePackedMap();
+
 #endif //__DOOM64EX_MAP__59976677
@@ -0,0 +1,468 @@
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <easy/profiler.h>
+#include <common/md5.h>
+#include <platform/app.hh>
+#include <system/mapped_file.hh>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "i_system.h"
+#include "p_local.h"
+#include "z_zone.h"
+#include "Map.hh"
+
+extern BoolCvar p_buildreject;
+
+namespace {
+  /*
+    The packed map is the level geometry as P_GroupLines leaves it, written out
+    in the in-memory layout with every pointer replaced by an index. Loading it
+    is a single read into one level block followed by a relocation pass.
+
+    The structs are stored as they are, so a packed map is only good for the
+    build that wrote it; the element sizes in the header catch most layout
+    changes. Bump packed_version_ whenever a loader changes what it produces.
+
+    Settings that change the built geometry are recorded in the header flags,
+    and a packed map built with different ones is treated as missing.
+  */
+  constexpr uint32 packed_version_ = 4;
+
+  enum : uint32 {
+      PF_BUILDREJECT = 0x1 /**< Built with p_buildreject on */
+  };
+
+  enum : size_t {
+      PK_VERTEXES,
+      PK_SECTORS,
+      PK_SIDES,
+      PK_LINES,
+      PK_SUBSECTORS,
+      PK_NODES,
+      PK_SEGS,
+      PK_LEAFS,
+      PK_LINEBUFFER,
+      PK_BLOCKMAP,
+      PK_REJECT,
+      PK_NUMSECTIONS
+  };
+
+  const uint32 elemsizes_[PK_NUMSECTIONS] = {
+      sizeof(vertex_t),
+      sizeof(sector_t),
+      sizeof(side_t),
+      sizeof(line_t),
+      sizeof(subsector_t),
+      sizeof(node_t),
+      sizeof(seg_t),
+      sizeof(leaf_t),
+      sizeof(line_t*),
+      sizeof(int),
+      sizeof(byte)
+  };
+
+  struct PackedHeader {
+      char id[4];
+      uint32 version;
+      uint8 md5[16];
+      uint32 flags;
+      uint32 numsections;
+      uint32 payloadsize;
+  };
+
+  struct PackedSection {
+      uint32 count;
+      uint32 elemsize;
+      uint32 offset; /**< Position relative to the start of the payload */
+  };
+
+  constexpr size_t payload_pos_ = sizeof(PackedHeader) + PK_NUMSECTIONS * sizeof(PackedSection);
+
+  app::BoolParam no_map_cache_param_("nomapcache");
+
+  md5_digest_t md5_ {};
+  StringView md5_data_ {};
+
+  constexpr size_t align_(size_t x)
+  { return (x + 7) & ~size_t(7); }
+
+  uint32 packed_flags_()
+  { return p_buildreject ? PF_BUILDREJECT : 0; }
+
+  /*! The cache file for the current map lump */
+  String packed_path_()
+  {
+      auto data = W_MapData();
+
+      if (data.data() != md5_data_.data() || data.size() != md5_data_.size()) {
+          md5_context_t ctx;
+          MD5_Init(&ctx);
+          MD5_Update(&ctx, reinterpret_cast<const byte*>(data.data()), static_cast<unsigned>(data.size()));
+          MD5_Final(md5_, &ctx);
+          md5_data_ = data;
+      }
+
+      String name = "map-";
+      for (auto c : md5_)
+          name += fmt::format("{:02x}", c);
+      name += ".cache";
+
+      auto path = I_GetUserFile(name.c_str());
+      if (!path)
+          return {};
+
+      String retval = path;
+      free(path);
+      return retval;
+  }
+
+  template <class T>
+  T* section_ptr(char* base, const PackedSection& section)
+  { return reinterpret_cast<T*>(base + section.offset); }
+
+  /* Pointers are stored as index + 1 so that null stays null */
+  template <class T>
+  void pack(T*& ptr, T* base)
+  {
+      auto index = ptr ? static_cast<uintptr_t>(ptr - base) + 1 : 0;
+      ptr = reinterpret_cast<T*>(index);
+  }
+
+  /*! Returns false if the index is past the end of a section of count elements */
+  template <class T>
+  bool unpack(T*& ptr, T* base, size_t count)
+  {
+      auto index = reinterpret_cast<uintptr_t>(ptr);
+      if (index > count)
+          return false;
+
+      ptr = index ? base + (index - 1) : nullptr;
+      return true;
+  }
+
+  /*! Check the indices that are used as they are, without relocation */
+  bool check_indices_(line_t** linebuffer, size_t numlinebuffer, size_t numleafsused)
+  {
+      for (int i {}; i < numsectors; ++i) {
+          auto& s = sectors[i];
+          if (s.linecount < 0 || (s.linecount && !s.lines) ||
+              (s.lines && static_cast<size_t>(s.lines - linebuffer) + s.linecount > numlinebuffer))
+              return false;
+      }
+
+      for (int i {}; i < numlines; ++i) {
+          auto& l = lines[i];
+          if (l.sidenum[0] >= numsides || (l.sidenum[1] != 0xffff && l.sidenum[1] >= numsides))
+              return false;
+      }
+
+      for (int i {}; i < numsubsectors; ++i) {
+          auto& ss = subsectors[i];
+          if (ss.firstline + ss.numlines > numsegs || ss.leaf + ss.numleafs > numleafsused)
+              return false;
+      }
+
+      for (int i {}; i < numnodes; ++i) {
+          for (auto child : nodes[i].children) {
+              if (child & NF_SUBSECTOR ? (child & ~NF_SUBSECTOR) >= numsubsectors : child >= numnodes)
+                  return false;
+          }
+      }
+
+      return true;
+  }
+
+  /*! The blockmap is a header, one offset per block plus an end offset and
+      then the line lists. Every list has to lie inside the lump and only
+      name lines that exist. */
+  bool check_blockmap_()
+  {
+      if (blockmapsize < 4)
+          return false;
+
+      auto width = blockmaplump[2];
+      auto height = blockmaplump[3];
+      if (width <= 0 || height <= 0 || static_cast<int64>(width) * height > blockmapsize - 5)
+          return false;
+
+      auto cells = width * height;
+      auto offsets = blockmaplump + 4;
+      if (offsets[0] != 4 + cells + 1 || offsets[cells] > blockmapsize)
+          return false;
+
+      for (int i {}; i < cells; ++i) {
+          if (offsets[i + 1] < offsets[i])
+              return false;
+      }
+
+      for (int i = offsets[0]; i < offsets[cells]; ++i) {
+          if (blockmaplump[i] < 0 || blockmaplump[i] >= numlines)
+              return false;
+      }
+
+      return true;
+  }
+}
+
+bool P_LoadPackedMap()
+{
+    EASY_FUNCTION(profiler::colors::Green);
+
+    if (no_map_cache_param_)
+        return false;
+
+    auto path = packed_path_();
+    if (path.empty())
+        return false;
+
+    sys::MappedFile file;
+    if (!file.open(path))
+        return false;
+
+    PackedHeader header;
+    auto header_view = file.view(0, sizeof(header));
+    if (header_view.size() != sizeof(header))
+        return false;
+    memcpy(&header, header_view.data(), sizeof(header));
+
+    if (memcmp(header.id, "D64P", 4) != 0 || header.version != packed_version_ || header.flags != packed_flags_() ||
+        header.numsections != PK_NUMSECTIONS || memcmp(header.md5, md5_, sizeof(md5_)) != 0)
+        return false;
+
+    auto payload = file.view(payload_pos_, header.payloadsize);
+    if (payload.size() != header.payloadsize || payload.empty())
+        return false;
+
+    PackedSection sections[PK_NUMSECTIONS];
+    memcpy(sections, file.data() + sizeof(header), sizeof(sections));
+
+    for (size_t i {}; i < PK_NUMSECTIONS; ++i) {
+        const auto& s = sections[i];
+        if (s.elemsize != elemsizes_[i] || s.count > INT_MAX || s.offset > payload.size() ||
+            static_cast<uint64>(s.count) * s.elemsize > payload.size() - s.offset)
+            return false;
+    }
+
+    // The texture loaders still read the map lumps, which have to agree
+    auto numsectors_lump = W_MapLumpLength(ML_SECTORS) / sizeof(mapsector_t);
+    auto numsides_lump = W_MapLumpLength(ML_SIDEDEFS) / sizeof(mapsidedef_t);
+    auto rejectsize = (static_cast<uint64>(sections[PK_SECTORS].count) * sections[PK_SECTORS].count + 7) / 8;
+    if (sections[PK_SECTORS].count != numsectors_lump || sections[PK_SIDES].count != numsides_lump ||
+        sections[PK_REJECT].count < rejectsize)
+        return false;
+
+    // One block holds all of the geometry
+    auto base = static_cast<char*>(Z_Malloc(payload.size(), PU_LEVEL, 0));
+    memcpy(base, payload.data(), payload.size());
+
+    numvertexes = sections[PK_VERTEXES].count;
+    vertexes = section_ptr<vertex_t>(base, sections[PK_VERTEXES]);
+    numsectors = sections[PK_SECTORS].count;
+    sectors = section_ptr<sector_t>(base, sections[PK_SECTORS]);
+    numsides = sections[PK_SIDES].count;
+    sides = section_ptr<side_t>(base, sections[PK_SIDES]);
+    numlines = sections[PK_LINES].count;
+    lines = section_ptr<line_t>(base, sections[PK_LINES]);
+    numsubsectors = sections[PK_SUBSECTORS].count;
+    subsectors = section_ptr<subsector_t>(base, sections[PK_SUBSECTORS]);
+    numnodes = sections[PK_NODES].count;
+    nodes = section_ptr<node_t>(base, sections[PK_NODES]);
+    numsegs = sections[PK_SEGS].count;
+    segs = section_ptr<seg_t>(base, sections[PK_SEGS]);
+    numleafs = numsubsectors;
+    leafs = section_ptr<leaf_t>(base, sections[PK_LEAFS]);
+    blockmapsize = sections[PK_BLOCKMAP].count;
+    blockmaplump = section_ptr<int>(base, sections[PK_BLOCKMAP]);
+    rejectmatrix = section_ptr<byte>(base, sections[PK_REJECT]);
+
+    // A stale or damaged cache file can't be trusted with any index, so
+    // everything is checked and the map is loaded from the lumps on failure.
+    // The normal loaders replace all of the globals set above.
+    auto numlinebuffer = sections[PK_LINEBUFFER].count;
+    auto numleafsused = sections[PK_LEAFS].count;
+    auto linebuffer = section_ptr<line_t*>(base, sections[PK_LINEBUFFER]);
+    bool ok = true;
+
+    for (size_t i {}; i < numlinebuffer; ++i)
+        ok &= unpack(linebuffer[i], lines, numlines);
+
+    for (int i {}; i < numsectors; ++i)
+        ok &= unpack(sectors[i].lines, linebuffer, numlinebuffer);
+
+    for (int i {}; i < numsides; ++i)
+        ok &= unpack(sides[i].sector, sectors, numsectors);
+
+    for (int i {}; i < numlines; ++i) {
+        auto& l = lines[i];
+        ok &= unpack(l.v1, vertexes, numvertexes);
+        ok &= unpack(l.v2, vertexes, numvertexes);
+        ok &= unpack(l.frontsector, sectors, numsectors);
+        ok &= unpack(l.backsector, sectors, numsectors);
+    }
+
+    for (int i {}; i < numsubsectors; ++i)
+        ok &= unpack(subsectors[i].sector, sectors, numsectors);
+
+    for (int i {}; i < numsegs; ++i) {
+        auto& s = segs[i];
+        ok &= unpack(s.v1, vertexes, numvertexes);
+        ok &= unpack(s.v2, vertexes, numvertexes);
+        ok &= unpack(s.sidedef, sides, numsides);
+        ok &= unpack(s.linedef, lines, numlines);
+        ok &= unpack(s.frontsector, sectors, numsectors);
+        ok &= unpack(s.backsector, sectors, numsectors);
+    }
+
+    for (size_t i {}; i < numleafsused; ++i) {
+        ok &= unpack(leafs[i].vertex, vertexes, numvertexes);
+        ok &= unpack(leafs[i].seg, segs, numsegs);
+    }
+
+    if (!ok || !check_indices_(linebuffer, numlinebuffer, numleafsused) || !check_blockmap_()) {
+        log::warn("Packed map '{}' is damaged, loading the map lumps instead", path);
+        Z_Free(base);
+        return false;
+    }
+
+    log::debug("Loaded packed map '{}'", path);
+    return true;
+}
+
+void P_SavePackedMap()
+{
+    EASY_FUNCTION(profiler::colors::Green);
+
+    if (no_map_cache_param_)
+        return;
+
+    auto path = packed_path_();
+    if (path.empty())
+        return;
+
+    // P_GroupLines hands out the line buffer in sector order
+    line_t** linebuffer = numsectors ? sectors[0].lines : nullptr;
+    size_t numlinebuffer {};
+    for (int i {}; i < numsectors; ++i)
+        numlinebuffer += sectors[i].linecount;
+
+    size_t numleafsused {};
+    for (int i {}; i < numsubsectors; ++i)
+        numleafsused += subsectors[i].numleafs;
+
+    const void* sources[PK_NUMSECTIONS] = {
+        vertexes, sectors, sides, lines, subsectors, nodes,
+        segs, leafs, linebuffer, blockmaplump, rejectmatrix
+    };
+
+    const size_t counts[PK_NUMSECTIONS] = {
+        static_cast<size_t>(numvertexes),
+        static_cast<size_t>(numsectors),
+        static_cast<size_t>(numsides),
+        static_cast<size_t>(numlines),
+        static_cast<size_t>(numsubsectors),
+        static_cast<size_t>(numnodes),
+        static_cast<size_t>(numsegs),
+        numleafsused,
+        numlinebuffer,
+        static_cast<size_t>(blockmapsize),
+        static_cast<size_t>((numsectors * numsectors + 7) / 8)
+    };
+
+    PackedSection sections[PK_NUMSECTIONS] {};
+    size_t size {};
+    for (size_t i {}; i < PK_NUMSECTIONS; ++i) {
+        sections[i].count = static_cast<uint32>(counts[i]);
+        sections[i].elemsize = elemsizes_[i];
+        sections[i].offset = static_cast<uint32>(size);
+        size = align_(size + counts[i] * elemsizes_[i]);
+    }
+
+    String payload(size, '\0');
+    auto base = &payload[0];
+    for (size_t i {}; i < PK_NUMSECTIONS; ++i) {
+        if (counts[i])
+            memcpy(base + sections[i].offset, sources[i], counts[i] * elemsizes_[i]);
+    }
+
+    // Replace the pointers in the copy with indices. Things haven't been
+    // spawned yet, but clear the runtime pointers to be safe.
+    for (size_t i {}; i < numlinebuffer; ++i)
+        pack(section_ptr<line_t*>(base, sections[PK_LINEBUFFER])[i], lines);
+
+    for (int i {}; i < numsectors; ++i) {
+        auto& s = section_ptr<sector_t>(base, sections[PK_SECTORS])[i];
+        s.soundtarget = nullptr;
+        s.thinglist = nullptr;
+        s.specialdata = nullptr;
+        pack(s.lines, linebuffer);
+    }
+
+    for (int i {}; i < numsides; ++i)
+        pack(section_ptr<side_t>(base, sections[PK_SIDES])[i].sector, sectors);
+
+    for (int i {}; i < numlines; ++i) {
+        auto& l = section_ptr<line_t>(base, sections[PK_LINES])[i];
+        pack(l.v1, vertexes);
+        pack(l.v2, vertexes);
+        pack(l.frontsector, sectors);
+        pack(l.backsector, sectors);
+        l.specialdata = nullptr;
+    }
+
+    for (int i {}; i < numsubsectors; ++i)
+        pack(section_ptr<subsector_t>(base, sections[PK_SUBSECTORS])[i].sector, sectors);
+
+    for (int i {}; i < numsegs; ++i) {
+        auto& s = section_ptr<seg_t>(base, sections[PK_SEGS])[i];
+        pack(s.v1, vertexes);
+        pack(s.v2, vertexes);
+        pack(s.sidedef, sides);
+        pack(s.linedef, lines);
+        pack(s.frontsector, sectors);
+        pack(s.backsector, sectors);
+    }
+
+    for (size_t i {}; i < numleafsused; ++i) {
+        auto& l = section_ptr<leaf_t>(base, sections[PK_LEAFS])[i];
+        pack(l.vertex, vertexes);
+        pack(l.seg, segs);
+    }
+
+    // Write to a temporary file first, so that a partially written map is
+    // never picked up.
+    auto tmp_path = path + ".tmp";
+    {
+        std::ofstream f(tmp_path, std::ios::binary);
+        if (!f.is_open()) {
+            log::warn("Couldn't write packed map to '{}'", path);
+            return;
+        }
+
+        PackedHeader header {};
+        memcpy(header.id, "D64P", 4);
+        header.version = packed_version_;
+        memcpy(header.md5, md5_, sizeof(md5_));
+        header.flags = packed_flags_();
+        header.numsections = PK_NUMSECTIONS;
+        header.payloadsize = static_cast<uint32>(payload.size());
+
+        f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        f.write(reinterpret_cast<const char*>(sections), sizeof(sections));
+        f.write(payload.data(), payload.size());
+
+        if (!f.good()) {
+            log::warn("Couldn't write packed map to '{}'", path);
+            return;
+        }
+    }
+
+    if (!I_ReplaceFile(tmp_path.c_str(), path.c_str())) {
+        std::remove(tmp_path.c_str());
+        log::warn("Couldn't write packed map to '{}'", path);
+        return;
+    }
+
+    log::debug("Wrote packed map to '{}'", path);
+}
@@ -189,15 +189,16 @@ typedef struct {
 typedef struct {
     fixed_t    frac;        // along trace line
     dboolean    isaline;
+    int         order;       // breaks ties in frac, first found goes first
     union {
         mobj_t*    thing;
         line_t*    line;
     }            d;
 } intercept_t;
 
-#define MAXINTERCEPTS    128
+#define MAXINTERCEPTS    128    // initial size, grows as needed
 
-extern intercept_t    intercepts[MAXINTERCEPTS];
+extern intercept_t*    intercepts;
 extern intercept_t*    intercept_p;
 
 typedef dboolean(*traverser_t)(intercept_t *in);
@@ -225,6 +226,7 @@ dboolean    P_BlockThingsIterator(int x, int y, dboolean(*func)(mobj_t*));
 
 extern divline_t    trace;
 
+dboolean P_TraverseIntercepts(traverser_t func, fixed_t maxfrac);
 dboolean P_PathTraverse(fixed_t x1, fixed_t y1, fixed_t x2, fixed_t y2, int    flags, dboolean(*trav)(intercept_t *));
 void    P_UnsetThingPosition(mobj_t* thing);
 void    P_SetThingPosition(mobj_t* thing);
@@ -271,14 +273,18 @@ void    P_RadiusAttack(mobj_t* spot, mobj_t* source, int damage);
 // P_SETUP
 //
 extern byte*        rejectmatrix;    // for fast sight rejection
-extern short*        blockmaplump;    // offsets in blockmap are from here
-extern short*        blockmap;
+extern int*        blockmaplump;    // offsets in blockmap are from here
+extern int*        blockmap;
+extern int            blockmapsize;
 extern int            bmapwidth;
 extern int            bmapheight;    // in mapblocks
 extern fixed_t        bmaporgx;
 extern fixed_t        bmaporgy;    // origin of block map
 extern mobj_t**        blocklinks;    // for thing chains
 
+void P_BuildReject(void);
+dboolean P_CheckReject(sector_t* s1, sector_t* s2);
+
 
 
 //
@@ -30,6 +30,7 @@
 //-----------------------------------------------------------------------------
 
 #include <stdlib.h>
+#include <algorithm>
 
 #include "m_misc.h"
 #include "m_fixed.h"
@@ -453,7 +454,8 @@ P_BlockLinesIterator
  int            y,
  dboolean(*func)(line_t*)) {
     int            offset;
-    short*        list;
+    int*        list;
+    int*        end;
     line_t*        ld;
 
     if(x<0
@@ -465,15 +467,13 @@ P_BlockLinesIterator
 
     offset = y*bmapwidth+x;
 
-    offset = *(blockmap+offset);
+    // line indices were checked when the blockmap was set up
+    list = blockmaplump + blockmap[offset];
+    end = blockmaplump + blockmap[offset + 1];
 
-    for(list = blockmaplump+offset ; *list != -1 ; list++) {
+    for(; list < end; list++) {
         ld = &lines[*list];
 
-        if((ld - lines) >= numlines) {
-            I_Error("P_BlockLinesIterator: Linedef out of range");
-        }
-
         if(ld->validcount == validcount) {
             continue;    // line has already been checked
         }
@@ -521,13 +521,46 @@ P_BlockThingsIterator
 //
 // INTERCEPT ROUTINES
 //
-intercept_t    intercepts[MAXINTERCEPTS];
+intercept_t*    intercepts;
 intercept_t*    intercept_p;
 
+static int      maxintercepts;
+
 divline_t     trace;
 dboolean     earlyout;
 int        ptflags;
 
+//
+// P_AddIntercept
+// Appends to the intercept list, growing it when full
+//
+
+static void P_AddIntercept(fixed_t frac, dboolean isaline, void* data) {
+    int count;
+
+    count = intercept_p - intercepts;
+
+    if(count >= maxintercepts) {
+        maxintercepts = maxintercepts ? maxintercepts * 2 : MAXINTERCEPTS;
+        intercepts = (intercept_t*)Z_Realloc(intercepts,
+                                             sizeof(intercept_t) * maxintercepts, PU_STATIC, 0);
+        intercept_p = intercepts + count;
+    }
+
+    intercept_p->frac = frac;
+    intercept_p->isaline = isaline;
+    intercept_p->order = count;
+
+    if(isaline) {
+        intercept_p->d.line = (line_t*)data;
+    }
+    else {
+        intercept_p->d.thing = (mobj_t*)data;
+    }
+
+    intercept_p++;
+}
+
 //
 // PIT_AddLineIntercepts.
 // Looks for lines in the given block
@@ -577,16 +610,7 @@ PIT_AddLineIntercepts(line_t* ld) {
         return false;    // stop checking
     }
 
-    // [d64] exit out if max intercepts has been hit
-    if((intercept_p - intercepts) >= MAXINTERCEPTS) {
-        return true;
-    }
-
-
-    intercept_p->frac = frac;
-    intercept_p->isaline = true;
-    intercept_p->d.line = ld;
-    intercept_p++;
+    P_AddIntercept(frac, true, ld);
 
     return true;    // continue
 }
@@ -647,69 +671,56 @@ dboolean PIT_AddThingIntercepts(mobj_t* thing) {
         return true;    // behind source
     }
 
-    // [d64] exit out if max intercepts has been hit
-    if((intercept_p - intercepts) >= MAXINTERCEPTS) {
-        return true;
-    }
-
-    intercept_p->frac = frac;
-    intercept_p->isaline = false;
-    intercept_p->d.thing = thing;
-    intercept_p++;
+    P_AddIntercept(frac, false, thing);
 
     return true;        // keep going
 }
 
 
+//
+// P_InterceptAfter
+// Heap ordering for intercepts: nearest first, ties to the one found first
+//
+
+static bool P_InterceptAfter(const intercept_t& a, const intercept_t& b) {
+    if(a.frac != b.frac) {
+        return a.frac > b.frac;
+    }
+
+    return a.order > b.order;
+}
+
 //
 // P_TraverseIntercepts
 // Returns true if the traverser function returns true
 // for all lines.
 //
+// Intercepts are popped off a heap in the same order the old repeated
+// linear scan picked them, so traces that stop early don't pay for
+// sorting the rest.
+//
 dboolean
 P_TraverseIntercepts
 (traverser_t    func,
  fixed_t    maxfrac) {
     int            count;
-    fixed_t        dist;
-    intercept_t*    scan;
     intercept_t*    in;
 
     count = intercept_p - intercepts;
 
-    in = 0;            // shut up compiler warning
+    std::make_heap(intercepts, intercepts + count, P_InterceptAfter);
 
-    while(count--) {
-        dist = D_MAXINT;
-        for(scan = intercepts ; scan<intercept_p ; scan++) {
-            if(scan->frac < dist) {
-                dist = scan->frac;
-                in = scan;
-            }
-        }
+    while(count > 0) {
+        std::pop_heap(intercepts, intercepts + count, P_InterceptAfter);
+        in = &intercepts[--count];
 
-        if(dist > maxfrac) {
+        if(in->frac > maxfrac) {
             return true;    // checked everything in range
         }
 
-#if 0  // UNUSED
-        {
-            // don't check these yet, there may be others inserted
-            in = scan = intercepts;
-            for(scan = intercepts ; scan<intercept_p ; scan++)
-                if(scan->frac > maxfrac) {
-                    *in++ = *scan;
-                }
-            intercept_p = in;
-            return false;
-        }
-#endif
-
         if(!func(in)) {
             return false;    // don't bother going farther
         }
-
-        in->frac = D_MAXINT;
     }
 
     return true;        // everything was traversed
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "p_local.h"
+
+static std::vector<int> visited;
+static size_t stop_after;
+
+static dboolean record_visit(intercept_t* in)
+{
+    visited.push_back(in->order);
+    return visited.size() < stop_after;
+}
+
+std::vector<intercept_t> create_intercepts(const std::vector<fixed_t>& fracs)
+{
+    std::vector<intercept_t> list(fracs.size());
+
+    for (size_t i = 0; i < fracs.size(); i++)
+    {
+        list[i].frac = fracs[i];
+        list[i].order = static_cast<int>(i);
+    }
+
+    return list;
+}
+
+std::vector<int> traverse(std::vector<intercept_t> list, fixed_t maxfrac, size_t stop = SIZE_MAX)
+{
+    intercepts = list.data();
+    intercept_p = list.data() + list.size();
+    visited.clear();
+    stop_after = stop;
+
+    P_TraverseIntercepts(record_visit, maxfrac);
+
+    intercepts = nullptr;
+    intercept_p = nullptr;
+    return visited;
+}
+
+/* The repeated linear scan P_TraverseIntercepts did before it used a heap */
+std::vector<int> linear_scan(std::vector<intercept_t> list, fixed_t maxfrac, size_t stop = SIZE_MAX)
+{
+    std::vector<int> order;
+
+    for (size_t count = list.size(); count--;)
+    {
+        fixed_t dist = D_MAXINT;
+        intercept_t* in = nullptr;
+
+        for (auto& scan : list)
+        {
+            if (scan.frac < dist)
+            {
+                dist = scan.frac;
+                in = &scan;
+            }
+        }
+
+        if (dist > maxfrac)
+            break;
+
+        order.push_back(in->order);
+        if (order.size() >= stop)
+            break;
+
+        in->frac = D_MAXINT;
+    }
+
+    return order;
+}
+
+TEST(TraverseIntercepts, empty)
+{
+    ASSERT_TRUE(traverse({}, FRACUNIT).empty());
+}
+
+TEST(TraverseIntercepts, nearest_first)
+{
+    auto list = create_intercepts({ FRACUNIT * 3 / 4, FRACUNIT / 4, FRACUNIT / 2, 0 });
+
+    std::vector<int> expect { 3, 1, 2, 0 };
+    ASSERT_EQ(expect, traverse(list, FRACUNIT));
+}
+
+TEST(TraverseIntercepts, ties_keep_insertion_order)
+{
+    auto list = create_intercepts({ FRACUNIT / 2, FRACUNIT / 4, FRACUNIT / 2, FRACUNIT / 4, FRACUNIT / 2 });
+
+    std::vector<int> expect { 1, 3, 0, 2, 4 };
+    ASSERT_EQ(expect, traverse(list, FRACUNIT));
+}
+
+TEST(TraverseIntercepts, stops_past_maxfrac)
+{
+    auto list = create_intercepts({ FRACUNIT, D_MAXINT, FRACUNIT / 2, FRACUNIT + 1 });
+
+    std::vector<int> expect { 2, 0 };
+    ASSERT_EQ(expect, traverse(list, FRACUNIT));
+
+    std::vector<int> expect_half { 2 };
+    ASSERT_EQ(expect_half, traverse(list, FRACUNIT / 2));
+}
+
+TEST(TraverseIntercepts, stops_when_traverser_fails)
+{
+    auto list = create_intercepts({ FRACUNIT / 2, FRACUNIT / 8, FRACUNIT / 4, FRACUNIT / 8 });
+
+    std::vector<int> expect { 1, 3 };
+    ASSERT_EQ(expect, traverse(list, FRACUNIT, 2));
+}
+
+TEST(TraverseIntercepts, same_order_as_linear_scan)
+{
+    std::mt19937 rng(1234);
+
+    for (int i = 0; i < 200; i++)
+    {
+        // Few distinct values, so that there are plenty of ties
+        std::vector<fixed_t> fracs(rng() % 64);
+        for (auto& frac : fracs)
+            frac = static_cast<fixed_t>(rng() % 8) * (FRACUNIT / 4);
+
+        auto list = create_intercepts(fracs);
+        size_t stop = i % 2 ? SIZE_MAX : rng() % 8 + 1;
+
+        ASSERT_EQ(linear_scan(list, FRACUNIT, stop), traverse(list, FRACUNIT, stop));
+    }
+}
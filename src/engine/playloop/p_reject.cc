@@ -0,0 +1,443 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// Copyright(C) 1993-1997 Id Software, Inc.
+// Copyright(C) 2007-2012 Samuel Villarreal
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+// 02111-1307, USA.
+//
+//-----------------------------------------------------------------------------
+//
+// DESCRIPTION:
+//    Builds the REJECT table for maps that ship without one.
+//
+//    Sectors are joined by portals, the linedefs that have a different
+//    sector on each side. Any sight line between two sectors crosses a
+//    chain of portals in order, so for every source sector the portal
+//    graph is walked depth first, and each portal is clipped against the
+//    separating lines of the source and the last portal passed. A chain
+//    ends once nothing of the next portal is left.
+//
+//    Heights are ignored and every clip keeps a little slack, so the
+//    table only rejects pairs that P_CheckSight could never connect.
+//
+//-----------------------------------------------------------------------------
+
+#include <chrono>
+#include <math.h>
+#include <vector>
+
+#include "doomdef.h"
+#include "p_local.h"
+#include "doomstat.h"
+#include "con_console.h"
+#include "z_zone.h"
+
+#include <system/thread_pool.hh>
+
+#define REJECT_EPSILON      0.125   // map units
+#define REJECT_MAXSTEPS     (1 << 18)   // portals clipped per source sector
+#define REJECT_MAXDEPTH     256
+
+#define FIXED2DOUBLE(x)     ((double)(x) / FRACUNIT)
+
+typedef struct {
+    double  x1;
+    double  y1;
+    double  x2;
+    double  y2;
+} rseg_t;
+
+typedef struct {
+    rseg_t  seg;
+    int     sector[2];
+} rportal_t;
+
+static rportal_t*   rportals;
+static int*         rsectorportals;     // portal indices grouped by sector
+static int*         rfirstportal;       // [numsectors + 1] start of each group
+
+//
+// State for walking the portals of one source sector
+//
+typedef struct {
+    std::vector<byte>   visible;        // [numsectors]
+    std::vector<byte>   onpath;         // [numportals]
+    int                 steps;
+    dboolean            overflow;
+} rejectwalk_t;
+
+//
+// P_SegSide
+// Signed distance of (x, y) from the line through (x1, y1) and (x2, y2),
+// positive on the left.
+//
+
+static double P_SegSide(double x1, double y1, double x2, double y2, double x, double y) {
+    double dx = x2 - x1;
+    double dy = y2 - y1;
+    double len = sqrt(dx * dx + dy * dy);
+
+    return (dx * (y - y1) - dy * (x - x1)) / len;
+}
+
+//
+// P_ClipSegToLine
+// Cuts off the part of seg that is more than REJECT_EPSILON behind
+// the line, flipping the line if keepleft is false. Returns false
+// if nothing is left.
+//
+
+static dboolean P_ClipSegToLine(rseg_t* seg, double x1, double y1, double x2, double y2,
+                                dboolean keepleft) {
+    double d1 = P_SegSide(x1, y1, x2, y2, seg->x1, seg->y1);
+    double d2 = P_SegSide(x1, y1, x2, y2, seg->x2, seg->y2);
+    double frac;
+
+    if(!keepleft) {
+        d1 = -d1;
+        d2 = -d2;
+    }
+
+    if(d1 < -REJECT_EPSILON && d2 < -REJECT_EPSILON) {
+        return false;
+    }
+
+    if(d1 >= -REJECT_EPSILON && d2 >= -REJECT_EPSILON) {
+        return true;
+    }
+
+    frac = d1 / (d1 - d2);
+
+    if(d1 < 0) {
+        seg->x1 = seg->x1 + (seg->x2 - seg->x1) * frac;
+        seg->y1 = seg->y1 + (seg->y2 - seg->y1) * frac;
+    }
+    else {
+        seg->x2 = seg->x1 + (seg->x2 - seg->x1) * frac;
+        seg->y2 = seg->y1 + (seg->y2 - seg->y1) * frac;
+    }
+
+    return true;
+}
+
+//
+// P_ClipToSeparators
+// Clips target to the area a straight line can reach after
+// crossing source and then pass. Only lines that have all of
+// source on one side and all of pass on the other are used,
+// so this never cuts off a reachable part of target.
+//
+
+static dboolean P_ClipToSeparators(const rseg_t* source, const rseg_t* pass, rseg_t* target) {
+    double sx[2] = { source->x1, source->x2 };
+    double sy[2] = { source->y1, source->y2 };
+    double px[2] = { pass->x1, pass->x2 };
+    double py[2] = { pass->y1, pass->y2 };
+    double d1, d2;
+    int i, j;
+
+    // target has to be past the pass portal
+    if(fabs(px[1] - px[0]) + fabs(py[1] - py[0]) > REJECT_EPSILON) {
+        d1 = P_SegSide(px[0], py[0], px[1], py[1], sx[0], sy[0]);
+        d2 = P_SegSide(px[0], py[0], px[1], py[1], sx[1], sy[1]);
+
+        if(d1 <= REJECT_EPSILON && d2 <= REJECT_EPSILON &&
+                (d1 < -REJECT_EPSILON || d2 < -REJECT_EPSILON)) {
+            if(!P_ClipSegToLine(target, px[0], py[0], px[1], py[1], true)) {
+                return false;
+            }
+        }
+        else if(d1 >= -REJECT_EPSILON && d2 >= -REJECT_EPSILON &&
+                (d1 > REJECT_EPSILON || d2 > REJECT_EPSILON)) {
+            if(!P_ClipSegToLine(target, px[0], py[0], px[1], py[1], false)) {
+                return false;
+            }
+        }
+    }
+
+    for(i = 0; i < 2; i++) {
+        for(j = 0; j < 2; j++) {
+            double ds, dp;
+
+            if(fabs(px[j] - sx[i]) + fabs(py[j] - sy[i]) <= REJECT_EPSILON) {
+                continue;
+            }
+
+            ds = P_SegSide(sx[i], sy[i], px[j], py[j], sx[i^1], sy[i^1]);
+            dp = P_SegSide(sx[i], sy[i], px[j], py[j], px[j^1], py[j^1]);
+
+            // source behind and pass in front, or the other way around
+            if(ds <= REJECT_EPSILON && dp >= -REJECT_EPSILON &&
+                    (ds < -REJECT_EPSILON || dp > REJECT_EPSILON)) {
+                if(!P_ClipSegToLine(target, sx[i], sy[i], px[j], py[j], true)) {
+                    return false;
+                }
+            }
+            else if(ds >= -REJECT_EPSILON && dp <= REJECT_EPSILON &&
+                    (ds > REJECT_EPSILON || dp < -REJECT_EPSILON)) {
+                if(!P_ClipSegToLine(target, sx[i], sy[i], px[j], py[j], false)) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+//
+// P_RejectFlow
+// Follows the portals out of sector, having come in through
+// pass with source being the part of the first portal that
+// can still see through.
+//
+
+static void P_RejectFlow(rejectwalk_t* walk, int sector, const rseg_t* source,
+                         const rseg_t* pass, int depth) {
+    int i;
+
+    if(depth >= REJECT_MAXDEPTH) {
+        walk->overflow = true;
+        return;
+    }
+
+    for(i = rfirstportal[sector]; i < rfirstportal[sector + 1]; i++) {
+        int num = rsectorportals[i];
+        rportal_t* portal = &rportals[num];
+        rseg_t target;
+        rseg_t newsource;
+        int next;
+
+        if(walk->overflow) {
+            return;
+        }
+
+        if(walk->onpath[num]) {
+            continue;
+        }
+
+        if(++walk->steps > REJECT_MAXSTEPS) {
+            walk->overflow = true;
+            return;
+        }
+
+        target = portal->seg;
+        if(!P_ClipToSeparators(source, pass, &target)) {
+            continue;
+        }
+
+        next = portal->sector[0] == sector ? portal->sector[1] : portal->sector[0];
+        walk->visible[next] = 1;
+
+        // narrow the source down to what can see the clipped target
+        newsource = *source;
+        if(!P_ClipToSeparators(&target, pass, &newsource)) {
+            continue;
+        }
+
+        walk->onpath[num] = 1;
+        P_RejectFlow(walk, next, &newsource, &target, depth + 1);
+        walk->onpath[num] = 0;
+    }
+}
+
+//
+// P_RejectFlood
+// Marks every sector joined to sector through portals. Used when
+// the walk gives up, which keeps the table safe on huge maps.
+//
+
+static void P_RejectFlood(rejectwalk_t* walk, int sector) {
+    std::vector<int> stack;
+
+    walk->visible[sector] = 1;
+    stack.push_back(sector);
+
+    while(!stack.empty()) {
+        int s = stack.back();
+        int i;
+
+        stack.pop_back();
+
+        for(i = rfirstportal[s]; i < rfirstportal[s + 1]; i++) {
+            rportal_t* portal = &rportals[rsectorportals[i]];
+            int next = portal->sector[0] == s ? portal->sector[1] : portal->sector[0];
+
+            if(!walk->visible[next]) {
+                walk->visible[next] = 1;
+                stack.push_back(next);
+            }
+        }
+    }
+}
+
+//
+// P_RejectSector
+// Finds every sector that may be visible from sector.
+//
+
+static void P_RejectSector(rejectwalk_t* walk, int sector) {
+    int i, j;
+
+    walk->visible[sector] = 1;
+
+    for(i = rfirstportal[sector]; i < rfirstportal[sector + 1] && !walk->overflow; i++) {
+        int first = rsectorportals[i];
+        rportal_t* p0 = &rportals[first];
+        int inner = p0->sector[0] == sector ? p0->sector[1] : p0->sector[0];
+
+        walk->visible[inner] = 1;
+        walk->onpath[first] = 1;
+
+        // anything in the neighbouring sector can be seen from somewhere
+        for(j = rfirstportal[inner]; j < rfirstportal[inner + 1]; j++) {
+            int num = rsectorportals[j];
+            rportal_t* p1 = &rportals[num];
+            int next;
+
+            if(walk->onpath[num]) {
+                continue;
+            }
+
+            next = p1->sector[0] == inner ? p1->sector[1] : p1->sector[0];
+            walk->visible[next] = 1;
+
+            walk->onpath[num] = 1;
+            P_RejectFlow(walk, next, &p0->seg, &p1->seg, 0);
+            walk->onpath[num] = 0;
+
+            if(walk->overflow) {
+                break;
+            }
+        }
+
+        walk->onpath[first] = 0;
+    }
+
+    if(walk->overflow) {
+        P_RejectFlood(walk, sector);
+    }
+}
+
+//
+// P_BuildReject
+// Fills rejectmatrix from the level geometry. Lines with a back side
+// count as portals even without ML_TWOSIDED, since macros can set
+// the flag later on.
+//
+
+void P_BuildReject(void) {
+    auto start = std::chrono::steady_clock::now();
+    int numportals = 0;
+    int rowbytes = (numsectors + 7) / 8;
+    int rejected = 0;
+    int i, j;
+
+    if(numsectors <= 0) {
+        return;
+    }
+
+    rportals = (rportal_t*)Z_Malloc(MAX(numlines, 1) * sizeof(rportal_t), PU_STATIC, 0);
+    rfirstportal = (int*)Z_Calloc((numsectors + 1) * sizeof(int), PU_STATIC, 0);
+
+    for(i = 0; i < numlines; i++) {
+        line_t* line = &lines[i];
+        rportal_t* portal;
+
+        if(!line->frontsector || !line->backsector || line->frontsector == line->backsector) {
+            continue;
+        }
+
+        portal = &rportals[numportals++];
+        portal->seg.x1 = FIXED2DOUBLE(line->v1->x);
+        portal->seg.y1 = FIXED2DOUBLE(line->v1->y);
+        portal->seg.x2 = FIXED2DOUBLE(line->v2->x);
+        portal->seg.y2 = FIXED2DOUBLE(line->v2->y);
+        portal->sector[0] = line->frontsector - sectors;
+        portal->sector[1] = line->backsector - sectors;
+
+        rfirstportal[portal->sector[0] + 1]++;
+        rfirstportal[portal->sector[1] + 1]++;
+    }
+
+    for(i = 0; i < numsectors; i++) {
+        rfirstportal[i + 1] += rfirstportal[i];
+    }
+
+    // group the portals by sector, each portal once for each side
+    rsectorportals = (int*)Z_Malloc(MAX(numportals * 2, 1) * sizeof(int), PU_STATIC, 0);
+    {
+        std::vector<int> fill(rfirstportal, rfirstportal + numsectors);
+
+        for(i = 0; i < numportals; i++) {
+            rsectorportals[fill[rportals[i].sector[0]]++] = i;
+            rsectorportals[fill[rportals[i].sector[1]]++] = i;
+        }
+    }
+
+    // one row of visible sectors per source sector, byte aligned so
+    // that the rows can be written from different threads
+    std::vector<byte> rows((size_t)numsectors * rowbytes, 0);
+
+    auto buildrow = [&rows, rowbytes, numportals](size_t sector) {
+        rejectwalk_t walk;
+        byte* row = &rows[sector * rowbytes];
+        int s;
+
+        walk.visible.assign(numsectors, 0);
+        walk.onpath.assign(numportals, 0);
+        walk.steps = 0;
+        walk.overflow = false;
+
+        P_RejectSector(&walk, (int)sector);
+
+        for(s = 0; s < numsectors; s++) {
+            if(walk.visible[s]) {
+                row[s >> 3] |= 1 << (s & 7);
+            }
+        }
+    };
+
+    sys::ThreadPool::global().for_each(numsectors, buildrow);
+
+    // sight works both ways, so only reject a pair if neither
+    // sector could see the other
+    for(i = 0; i < numsectors; i++) {
+        for(j = 0; j < numsectors; j++) {
+            int pnum;
+
+            if((rows[(size_t)i * rowbytes + (j >> 3)] & (1 << (j & 7))) ||
+                    (rows[(size_t)j * rowbytes + (i >> 3)] & (1 << (i & 7)))) {
+                continue;
+            }
+
+            pnum = i * numsectors + j;
+            rejectmatrix[pnum >> 3] |= 1 << (pnum & 7);
+            rejected++;
+        }
+    }
+
+    Z_Free(rsectorportals);
+    Z_Free(rfirstportal);
+    Z_Free(rportals);
+    rsectorportals = rfirstportal = NULL;
+    rportals = NULL;
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    CON_DPrintf("built reject: %i of %i sector pairs rejected in %.1f ms\n",
+                rejected, numsectors * numsectors, elapsed.count());
+}
@@ -29,6 +29,8 @@
 
 
 #include <time.h> // [kex] - for saving the date and time
+#include <limits.h>
+#include <zlib.h>
 #include "i_system.h"
 #include "g_game.h"
 #include "z_zone.h"
@@ -37,10 +39,12 @@
 #include "doomstat.h"
 #include "info.h"
 #include "m_password.h"
+#include "m_random.h"
 #include "p_saveg.h"
 #include "d_englsh.h"
 #include "m_misc.h"
 #include "doomdef.h" // added just so MSVC would shut up about warning C4761
+#include "con_console.h"
 
 void G_DoLoadLevel(void);
 
@@ -51,8 +55,21 @@ void G_DoLoadLevel(void);
 #define SAVEGAME_EOF    0x464F45
 #define SAVEGAME_MOBJ   0x4A424F4D
 
-static FILE*    save_stream;
+//
+// savegame container. The archive is built in memory and written out in
+// one go behind this header. Files without it are read as raw archives.
+//
+
+#define SAVEGAME_ID         "DSG1"
+#define SAVEGAME_VERSION    1
+#define SAVEGAME_HEADERSIZE 20
+
+#define SAVEF_ZLIB          0x1
+
+BoolCvar p_savecompress("p_savecompress", "Compress savegames with zlib", true);
+
 static byte*    savebuffer;
+static int      save_size = 0;
 
 static unsigned long save_offset = 0;
 
@@ -73,49 +90,281 @@ char *P_GetSaveGameName(int num) {
 //
 //------------------------------------------------------------------------
 
+//
+// saveg_reserve
+// Make room for count more bytes in the write buffer
+//
+
+static void saveg_reserve(int count) {
+    int size;
+
+    if(save_offset + count <= (unsigned long)save_size) {
+        return;
+    }
+
+    size = save_size ? save_size : SAVEGAMESIZE;
+    while(save_offset + count > (unsigned long)size) {
+        size <<= 1;
+    }
+
+    savebuffer = (byte*)Z_Realloc(savebuffer, size, PU_STATIC, 0);
+    save_size = size;
+}
+
+//
+// saveg_check
+// Make sure count more bytes can be read
+//
+
+static void saveg_check(int count) {
+    if(save_offset + count > (unsigned long)save_size) {
+        I_Error("Bad savegame: read past end of file (offset %lu, size %i)",
+                save_offset, save_size);
+    }
+}
+
 static byte saveg_read8(void) {
     byte result;
 
+    saveg_check(1);
     result = savebuffer[save_offset++];
 
     return result;
 }
 
 static void saveg_write8(byte value) {
-    fwrite(&value, 1, 1, save_stream);
-    save_offset++;
+    saveg_reserve(1);
+    savebuffer[save_offset++] = value;
 }
 
 static short saveg_read16(void) {
-    int result;
+    byte* p;
 
-    result = saveg_read8();
-    result |= saveg_read8() << 8;
+    saveg_check(2);
+    p = savebuffer + save_offset;
+    save_offset += 2;
 
-    return result;
+    return (short)(p[0] | (p[1] << 8));
 }
 
 static void saveg_write16(short value) {
-    saveg_write8(value & 0xff);
-    saveg_write8((value >> 8) & 0xff);
+    byte* p;
+
+    saveg_reserve(2);
+    p = savebuffer + save_offset;
+    save_offset += 2;
+
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
 }
 
 static int saveg_read32(void) {
-    int result;
+    byte* p;
 
-    result = saveg_read8();
-    result |= saveg_read8() << 8;
-    result |= saveg_read8() << 16;
-    result |= saveg_read8() << 24;
+    saveg_check(4);
+    p = savebuffer + save_offset;
+    save_offset += 4;
 
-    return result;
+    return (int)(p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24));
 }
 
 static void saveg_write32(int value) {
-    saveg_write8(value & 0xff);
-    saveg_write8((value >> 8) & 0xff);
-    saveg_write8((value >> 16) & 0xff);
-    saveg_write8((value >> 24) & 0xff);
+    byte* p;
+
+    saveg_reserve(4);
+    p = savebuffer + save_offset;
+    save_offset += 4;
+
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = (value >> 24) & 0xff;
+}
+
+static void saveg_put32(byte* p, unsigned int value) {
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = (value >> 24) & 0xff;
+}
+
+static unsigned int saveg_get32(const byte* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+//------------------------------------------------------------------------
+//
+// Savegame file I/O
+//
+//------------------------------------------------------------------------
+
+//
+// saveg_close
+//
+
+static void saveg_close(void) {
+    if(savebuffer) {
+        Z_Free(savebuffer);
+    }
+
+    savebuffer = NULL;
+    save_size = 0;
+    save_offset = 0;
+}
+
+//
+// saveg_unpack
+// Verifies and decompresses a packed archive into savebuffer
+//
+
+static dboolean saveg_unpack(const byte* data, int length, const char* name) {
+    int flags;
+    unsigned int crc;
+    unsigned int size;
+    unsigned int stored;
+
+    save_offset = 0;
+
+    if(length < SAVEGAME_HEADERSIZE || memcmp(data, SAVEGAME_ID, 4)) {
+        CON_Warnf("%s: not a savegame\n", name);
+        return false;
+    }
+
+    flags  = saveg_get32(data + 4) & 0xffff;
+    crc    = saveg_get32(data + 8);
+    size   = saveg_get32(data + 12);
+    stored = saveg_get32(data + 16);
+
+    if(saveg_get32(data + 4) >> 16 != SAVEGAME_VERSION ||
+            stored != (unsigned int)(length - SAVEGAME_HEADERSIZE) || size > INT_MAX) {
+        CON_Warnf("%s: unsupported or truncated savegame\n", name);
+        return false;
+    }
+
+    savebuffer = (byte*)Z_Malloc(size ? size : 1, PU_STATIC, 0);
+    save_size = size;
+
+    if(flags & SAVEF_ZLIB) {
+        uLongf outlen = size;
+
+        if(uncompress(savebuffer, &outlen, data + SAVEGAME_HEADERSIZE, stored) != Z_OK ||
+                outlen != size) {
+            CON_Warnf("%s: savegame is corrupt\n", name);
+            saveg_close();
+            return false;
+        }
+    }
+    else if(stored == size) {
+        memcpy(savebuffer, data + SAVEGAME_HEADERSIZE, size);
+    }
+    else {
+        CON_Warnf("%s: savegame is corrupt\n", name);
+        saveg_close();
+        return false;
+    }
+
+    if(crc32(0, savebuffer, size) != crc) {
+        CON_Warnf("%s: savegame checksum mismatch\n", name);
+        saveg_close();
+        return false;
+    }
+
+    return true;
+}
+
+//
+// saveg_pack
+// Wraps the archive built in savebuffer in a header, compressing it
+// if p_savecompress is set. Returns a new block of *length bytes.
+//
+
+static byte* saveg_pack(int* length) {
+    byte* out;
+    uLongf stored;
+    int flags;
+
+    stored = compressBound(save_offset);
+    out = (byte*)Z_Malloc(SAVEGAME_HEADERSIZE + stored, PU_STATIC, 0);
+    flags = 0;
+
+    if(p_savecompress &&
+            compress2(out + SAVEGAME_HEADERSIZE, &stored, savebuffer, save_offset, Z_BEST_SPEED) == Z_OK &&
+            stored < save_offset) {
+        flags |= SAVEF_ZLIB;
+    }
+    else {
+        memcpy(out + SAVEGAME_HEADERSIZE, savebuffer, save_offset);
+        stored = save_offset;
+    }
+
+    memcpy(out, SAVEGAME_ID, 4);
+    saveg_put32(out + 4, (SAVEGAME_VERSION << 16) | flags);
+    saveg_put32(out + 8, crc32(0, savebuffer, save_offset));
+    saveg_put32(out + 12, save_offset);
+    saveg_put32(out + 16, stored);
+
+    *length = SAVEGAME_HEADERSIZE + stored;
+    return out;
+}
+
+//
+// saveg_open
+// Reads a savegame into savebuffer
+//
+
+static dboolean saveg_open(const char* name) {
+    byte* data;
+    int length;
+    dboolean result;
+
+    if((length = M_ReadFile(name, &data)) == -1) {
+        return false;
+    }
+
+    // old saves are the bare archive
+    if(length < SAVEGAME_HEADERSIZE || memcmp(data, SAVEGAME_ID, 4)) {
+        savebuffer = data;
+        save_size = length;
+        save_offset = 0;
+        return true;
+    }
+
+    result = saveg_unpack(data, length, name);
+    Z_Free(data);
+
+    return result;
+}
+
+//
+// saveg_flush
+// Writes the archive built in savebuffer to disk. The data goes to a
+// temporary file which then replaces the old save, so a failed write
+// never leaves a half written savegame behind.
+//
+
+static dboolean saveg_flush(const char* name) {
+    byte* out;
+    int length;
+    char temp[512];
+    dboolean result;
+
+    out = saveg_pack(&length);
+
+    snprintf(temp, sizeof(temp), "%s.tmp", name);
+    result = M_WriteFile(temp, out, length);
+
+    Z_Free(out);
+
+    if(!result) {
+        return false;
+    }
+
+    if(!I_ReplaceFile(temp, name)) {
+        remove(temp);
+        return false;
+    }
+
+    return true;
 }
 
 //------------------------------------------------------------------------
@@ -162,17 +411,30 @@ static void saveg_write_pad(void) {
 //
 //------------------------------------------------------------------------
 
+// Mobj references are saved as 1-based indices into the mobj list (0 is
+// NULL). Writing looks the index up in a pointer-keyed hash table, reading
+// indexes straight into the table of mobjs allocated for the load.
+
 typedef struct {
-    int index;
     mobj_t* mobj;
+    int index;
 } savegmobj_t;
 
-static savegmobj_t* savegmobj;
+static savegmobj_t* savegmobjhash;  // open addressing, write only
+static int          savegmobjmask;
+static mobj_t**     savegmobj;      // savegmobj[index - 1], read only
 static int          savegmobjnum;
 
+static int saveg_hash_mobj(mobj_t* mobj) {
+    uintptr_t p = (uintptr_t)mobj / sizeof(void*);
+
+    return (int)((p ^ (p >> 16)) * 2654435761u) & savegmobjmask;
+}
+
 static void saveg_setup_mobjwrite(void) {
     mobj_t* mobj;
-    int i;
+    int size;
+    int h;
 
     savegmobjnum = 0;
 
@@ -186,9 +448,12 @@ static void saveg_setup_mobjwrite(void) {
         savegmobjnum++;
     }
 
-    // allocate ref table
-    savegmobj = (savegmobj_t*)Z_Alloca(sizeof(savegmobj_t) * savegmobjnum);
-    i = 0;
+    // allocate ref table, at most half full
+    for(size = 16; size < savegmobjnum * 2; size <<= 1);
+
+    savegmobjhash = (savegmobj_t*)Z_Alloca(sizeof(savegmobj_t) * size);
+    savegmobjmask = size - 1;
+    savegmobjnum = 0;
 
     // store index and mobj
     for(mobj = mobjhead.next; mobj != &mobjhead; mobj = mobj->next) {
@@ -197,9 +462,10 @@ static void saveg_setup_mobjwrite(void) {
             continue;
         }
 
-        savegmobj[i].index = i + 1;
-        savegmobj[i].mobj = mobj;
-        i++;
+        for(h = saveg_hash_mobj(mobj); savegmobjhash[h].mobj; h = (h + 1) & savegmobjmask);
+
+        savegmobjhash[h].mobj = mobj;
+        savegmobjhash[h].index = ++savegmobjnum;
     }
 }
 
@@ -208,25 +474,24 @@ static void saveg_setup_mobjread(void) {
 
     // get count and allocate table
     savegmobjnum = saveg_read32();
-    savegmobj = (savegmobj_t*)Z_Alloca(sizeof(savegmobj_t) * savegmobjnum);
+    savegmobj = (mobj_t**)Z_Alloca(sizeof(mobj_t*) * savegmobjnum);
 
     // read and add mobjs
     for(i = 0; i < savegmobjnum; i++) {
-        savegmobj[i].index = i + 1;
-        savegmobj[i].mobj = (mobj_t*) Z_Calloc(sizeof(mobj_t), PU_LEVEL, NULL);
+        savegmobj[i] = (mobj_t*) Z_Calloc(sizeof(mobj_t), PU_LEVEL, NULL);
     }
 }
 
 static void saveg_write_mobjindex(mobj_t* mobj) {
-    int i;
+    int h;
 
-    for(i = 0; i < savegmobjnum; i++) {
-        if(savegmobj[i].mobj != mobj) {
-            continue;
+    if(mobj) {
+        for(h = saveg_hash_mobj(mobj); savegmobjhash[h].mobj; h = (h + 1) & savegmobjmask) {
+            if(savegmobjhash[h].mobj == mobj) {
+                saveg_write32(savegmobjhash[h].index);
+                return;
+            }
         }
-
-        saveg_write32(savegmobj[i].index);
-        return;
     }
 
     saveg_write32(0);
@@ -235,14 +500,8 @@ static void saveg_write_mobjindex(mobj_t* mobj) {
 static mobj_t* saveg_read_mobjindex(void) {
     int index = saveg_read32();
 
-    if(index) {
-        int i;
-
-        for(i = 0; i < savegmobjnum; i++) {
-            if(savegmobj[i].index == index) {
-                return savegmobj[i].mobj;
-            }
-        }
+    if(index > 0 && index <= savegmobjnum) {
+        return savegmobj[index - 1];
     }
 
     return NULL;
@@ -1105,40 +1364,8 @@ static char* saveg_gettime(void) {
     return asctime(lt);
 }
 
-static void saveg_write_header(char *description) {
+static void saveg_write_gameinfo(void) {
     int i;
-    int size;
-    char date[32];
-    byte* tbn;
-
-    for(i = 0; description[i] != '\0'; i++) {
-        saveg_write8(description[i]);
-    }
-
-    for(; i < SAVESTRINGSIZE; i++) {
-        saveg_write8(0);
-    }
-
-    sprintf(date, "%s", saveg_gettime());
-    size = dstrlen(date);
-
-    for(i = 0; i < size; i++) {
-        saveg_write8(date[i]);
-    }
-
-    for(; i < 32; i++) {
-        saveg_write8(0);
-    }
-
-    size = M_CacheThumbNail(&tbn);
-
-    saveg_write32(size);
-
-    for(i = 0; i < size; i++) {
-        saveg_write8(tbn[i]);
-    }
-
-    Z_Free(tbn);
 
     for(i = 0; i < 16; i++) {
         saveg_write8(passwordData[i]);
@@ -1168,28 +1395,10 @@ static void saveg_write_header(char *description) {
     saveg_write_pad();
 }
 
-static void saveg_read_header(void) {
+static void saveg_read_gameinfo(void) {
     int i;
-    int size;
     byte a, b, c;
 
-    // skip the description field
-    for(i = 0; i < SAVESTRINGSIZE; i++) {
-        saveg_read8();
-    }
-
-    // skip the date
-    for(i = 0; i < 32; i++) {
-        saveg_read8();
-    }
-
-    size = saveg_read32() / sizeof(int);
-
-    // skip the thumbnail
-    for(i = 0; i < size; i++) {
-        saveg_read32();
-    }
-
     for(i = 0; i < 16; i++) {
         passwordData[i] = saveg_read8();
     }
@@ -1225,6 +1434,68 @@ static void saveg_read_header(void) {
     saveg_read_pad();
 }
 
+static void saveg_write_header(char *description) {
+    int i;
+    int size;
+    char date[32];
+    byte* tbn;
+
+    for(i = 0; description[i] != '\0'; i++) {
+        saveg_write8(description[i]);
+    }
+
+    for(; i < SAVESTRINGSIZE; i++) {
+        saveg_write8(0);
+    }
+
+    sprintf(date, "%s", saveg_gettime());
+    size = dstrlen(date);
+
+    for(i = 0; i < size; i++) {
+        saveg_write8(date[i]);
+    }
+
+    for(; i < 32; i++) {
+        saveg_write8(0);
+    }
+
+    size = M_CacheThumbNail(&tbn);
+
+    saveg_write32(size);
+
+    for(i = 0; i < size; i++) {
+        saveg_write8(tbn[i]);
+    }
+
+    Z_Free(tbn);
+
+    saveg_write_gameinfo();
+}
+
+static void saveg_read_header(void) {
+    int i;
+    int size;
+
+    // skip the description field
+    for(i = 0; i < SAVESTRINGSIZE; i++) {
+        saveg_read8();
+    }
+
+    // skip the date
+    for(i = 0; i < 32; i++) {
+        saveg_read8();
+    }
+
+    size = saveg_read32() / sizeof(int);
+
+    // skip the thumbnail
+    for(i = 0; i < size; i++) {
+        saveg_read32();
+    }
+
+    saveg_read_gameinfo();
+}
+
 //------------------------------------------------------------------------
 //
 // Read/write consistency marker
@@ -1250,18 +1521,14 @@ static void saveg_write_marker(int marker) {
 //
 
 dboolean P_WriteSaveGame(char* description, int slot) {
-    //char name[256];
-
-    // setup game save file
-    // sprintf(name, SAVEGAMENAME"%d.dsg", slot);
-    save_stream = fopen(P_GetSaveGameName(slot), "wb");
+    char* name;
+    dboolean result;
 
-    // success?
-    if(save_stream == NULL) {
+    if(!(name = P_GetSaveGameName(slot))) {
         return false;
     }
 
-    save_offset = 0;
+    saveg_close();
 
     saveg_write_header(description);
 
@@ -1273,10 +1540,13 @@ dboolean P_WriteSaveGame(char* description, int slot) {
 
     saveg_write_marker(SAVEGAME_EOF);
 
-    // close out file
-    fclose(save_stream);
+    // write out file
+    result = saveg_flush(name);
 
-    return true;
+    saveg_close();
+    free(name);
+
+    return result;
 }
 
 //
@@ -1284,8 +1554,9 @@ dboolean P_WriteSaveGame(char* description, int slot) {
 //
 
 dboolean P_ReadSaveGame(char* name) {
-    M_ReadFile(name, &savebuffer);
-    save_offset = 0;
+    if(!saveg_open(name)) {
+        return false;
+    }
 
     saveg_read_header();
 
@@ -1303,7 +1574,31 @@ dboolean P_ReadSaveGame(char* name) {
         I_Error("Bad savegame");
     }
 
-    Z_Free(savebuffer);
+    saveg_close();
+
+    return true;
+}
+
+//
+// P_ReadSaveDescription
+// Reads the description that leads the archive. The description
+// buffer must hold at least SAVESTRINGSIZE characters.
+//
+
+dboolean P_ReadSaveDescription(char* name, char* description) {
+    if(!saveg_open(name)) {
+        return false;
+    }
+
+    if(save_size < SAVESTRINGSIZE) {
+        saveg_close();
+        return false;
+    }
+
+    memcpy(description, savebuffer, SAVESTRINGSIZE);
+    description[SAVESTRINGSIZE - 1] = '\0';
+
+    saveg_close();
 
     return true;
 }
@@ -1317,12 +1612,10 @@ dboolean P_QuickReadSaveHeader(char* name, char* date,
     int i;
     int size;
 
-    if(M_ReadFile(name, &savebuffer) == -1) {
+    if(!saveg_open(name)) {
         return 0;
     }
 
-    save_offset = 0;
-
     // skip the description field
     for(i = 0; i < SAVESTRINGSIZE; i++) {
         saveg_read8();
@@ -1346,11 +1639,95 @@ dboolean P_QuickReadSaveHeader(char* name, char* date,
     *skill  = saveg_read8();
     *map    = saveg_read8();
 
-    Z_Free(savebuffer);
+    saveg_close();
 
     return 1;
 }
 
+//
+// P_WriteSnapshot
+// Archives the running game into a memory block for demo seeking.
+// Unlike a savegame it keeps the random number state, so the game
+// plays on exactly as it did from the point it was taken.
+//
+
+byte* P_WriteSnapshot(int* length) {
+    byte* data;
+    int i;
+
+    saveg_close();
+
+    saveg_write_gameinfo();
+
+    P_ArchiveMobjs();
+    P_ArchivePlayers();
+    P_ArchiveWorld();
+    P_ArchiveSpecials();
+    P_ArchiveMacros();
+
+    for(i = 0; i < NUMPRCLASS; i++) {
+        saveg_write32(rng.seed[i]);
+    }
+
+    saveg_write32(rng.rndindex);
+    saveg_write32(rng.prndindex);
+    saveg_write32(gametic - basetic);
+
+    saveg_write_marker(SAVEGAME_EOF);
+
+    data = saveg_pack(length);
+    saveg_close();
+
+    return data;
+}
+
+//
+// P_ReadSnapshot
+// Reloads the level and restores a snapshot from P_WriteSnapshot
+//
+
+dboolean P_ReadSnapshot(byte* data, int length) {
+    dboolean playback;
+    int i;
+
+    if(!saveg_unpack(data, length, "snapshot")) {
+        return false;
+    }
+
+    saveg_read_gameinfo();
+
+    // G_InitNew assumes a new game is being started
+    playback = demoplayback;
+    G_InitNew(gameskill, gamemap);
+    demoplayback = playback;
+    usergame = !playback;
+
+    // keep P_SetupLevel from resetting the level stats and time
+    gameaction = ga_loadgame;
+    G_DoLoadLevel();
+
+    P_UnArchiveMobjs();
+    P_UnArchivePlayers();
+    P_UnArchiveWorld();
+    P_UnArchiveSpecials();
+    P_UnArchiveMacros();
+
+    for(i = 0; i < NUMPRCLASS; i++) {
+        rng.seed[i] = saveg_read32();
+    }
+
+    rng.rndindex = saveg_read32();
+    rng.prndindex = saveg_read32();
+    basetic = gametic - saveg_read32();
+
+    if(!saveg_read_marker(SAVEGAME_EOF)) {
+        I_Error("Bad snapshot");
+    }
+
+    saveg_close();
+
+    return true;
+}
 
 //
 // P_ArchivePlayers
@@ -1485,6 +1862,8 @@ void P_UnArchiveWorld(void) {
         }
 
         sec->specialdata    = 0;
+
+        P_UpdateSectorScroller(sec);
     }
 
     // do lines
@@ -1494,6 +1873,8 @@ void P_UnArchiveWorld(void) {
         li->special         = saveg_read16();
         li->tag             = saveg_read16();
 
+        P_UpdateLineScroller(li);
+
         for(j = 0; j < 2; j++) {
             if(li->sidenum[j] == NO_SIDE_INDEX) {
                 continue;
@@ -1522,6 +1903,9 @@ void P_UnArchiveWorld(void) {
         saveg_read_pad();
         light->tag          = saveg_read16();
     }
+
+    // rebuild the tag chains from the restored tags
+    P_InitTagLists();
 }
 
 
@@ -1573,7 +1957,7 @@ void P_UnArchiveMobjs(void) {
     mobjhead.next = mobjhead.prev = &mobjhead;
 
     for(i = 0; i < savegmobjnum; i++) {
-        mobj = savegmobj[i].mobj;
+        mobj = savegmobj[i];
 
         saveg_read_pad();
         saveg_read_mobj_t(mobj);
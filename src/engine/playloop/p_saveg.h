@@ -38,7 +38,10 @@
 char *P_GetSaveGameName(int num);
 dboolean P_WriteSaveGame(char* description, int slot);
 dboolean P_ReadSaveGame(char* name);
+dboolean P_ReadSaveDescription(char* name, char* description);
 dboolean P_QuickReadSaveHeader(char* name, char* date, int* thumbnail, int* skill, int* map);
+byte* P_WriteSnapshot(int* length);
+dboolean P_ReadSnapshot(byte* data, int length);
 
 // Persistent storage/archiving.
 // These are the load / save game routines.
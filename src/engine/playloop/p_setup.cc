@@ -46,6 +46,9 @@
 #include "Map.hh"
 
 void P_SpawnMapThing(mapthing_t *mthing);
+void P_LoadSectorTextures(int lump);
+void P_LoadSideTextures(int lump);
+void P_InitBlockMap(void);
 
 //
 // MAP related Lookup tables.
@@ -91,6 +94,7 @@ BoolCvar p_sdoubleclick("p_sdoubleclick", "");
 BoolCvar p_usecontext("p_usecontext", "");
 BoolCvar p_damageindicator("p_damageindicator", "");
 IntCvar p_regionmode("p_regionmode", "");
+BoolCvar p_buildreject("p_buildreject", "Build the REJECT table for maps with an empty one", true);
 
 //
 // [kex] sky definition stuff
@@ -109,9 +113,10 @@ static skydef_t*    skydefs;
 // Blockmap size.
 int                 bmapwidth;
 int                 bmapheight;     // size in mapblocks
-short*              blockmap;       // int for larger maps
+int*                blockmap;
 // offsets in blockmap are from here
-short*              blockmaplump;
+int*                blockmaplump;
+int                 blockmapsize;   // in ints
 // origin of block map
 fixed_t             bmaporgx;
 fixed_t             bmaporgy;
@@ -262,8 +267,6 @@ void P_LoadSectors(int lump) {
     for(i = 0; i < numsectors; i++, ss++, ms++) {
         ss->floorheight = INT2F(SHORT(ms->floorheight));
         ss->ceilingheight = INT2F(SHORT(ms->ceilingheight));
-        ss->floorpic = P_GetTextureHashKey(ms->floorpic);
-        ss->ceilingpic = P_GetTextureHashKey(ms->ceilingpic);
         ss->special = SHORT(ms->special);
         ss->flags = SHORT(ms->flags);
 
@@ -277,6 +280,27 @@ void P_LoadSectors(int lump) {
         ss->frame_z1[1] = ss->floorheight;
         ss->frame_z2[0] = ss->ceilingheight;
         ss->frame_z2[1] = ss->ceilingheight;
+    }
+
+    P_LoadSectorTextures(lump);
+}
+
+//
+// P_LoadSectorTextures
+// Texture keys depend on the loaded wads, so they are looked up separately
+// from the rest of the sector.
+//
+
+void P_LoadSectorTextures(int lump) {
+    int                 i, j;
+    mapsector_t*        ms;
+    sector_t*           ss;
+
+    ms = (mapsector_t *)W_GetMapLump(lump);
+    ss = sectors;
+    for(i = 0; i < numsectors; i++, ss++, ms++) {
+        ss->floorpic = P_GetTextureHashKey(ms->floorpic);
+        ss->ceilingpic = P_GetTextureHashKey(ms->ceilingpic);
 
         for(j = 0; j < numskydef; j++) {
             if(ss->ceilingpic == wad::open(wad::Section::textures, skydefs[j].flat).value().section_index()) {
@@ -501,6 +525,7 @@ void P_LoadThings(int lump) {
     int             i;
     int             j;
     mapthing_t*     mt;
+    mapthing_t      mthing;
     int             numthings;
     dboolean        p2start = false;
     dboolean        p3start = false;
@@ -536,45 +561,49 @@ void P_LoadThings(int lump) {
 
     spawnlist = (mapthing_t*) Z_Malloc(sizeof(mapthing_t) * j, PU_LEVEL, 0);
 
-    for(i = 0; i < numthings; i++, mt++) {
-        mt->x = SHORT(mt->x);
-        mt->y = SHORT(mt->y);
-        mt->z = SHORT(mt->z);
-        mt->angle = SHORT(mt->angle);
-        mt->type = SHORT(mt->type);
-        mt->options = SHORT(mt->options);
-        mt->tid = SHORT(mt->tid);
+    for(i = 0; i < numthings; i++) {
+        //
+        // The map lump may be mapped read-only, and P_SpawnMapThing
+        // modifies the thing, so work on a copy.
+        //
+        mthing.x = SHORT(mt[i].x);
+        mthing.y = SHORT(mt[i].y);
+        mthing.z = SHORT(mt[i].z);
+        mthing.angle = SHORT(mt[i].angle);
+        mthing.type = SHORT(mt[i].type);
+        mthing.options = SHORT(mt[i].options);
+        mthing.tid = SHORT(mt[i].tid);
 
-        P_SpawnMapThing(mt);
+        P_SpawnMapThing(&mthing);
 
         // [kex] Hack to force-spawn co-op player starts on top of player 1
         // 20120122 villsa - updated to spawn co-op players away from
         // player 1 by radius
-        if(netgame && mt->type == 1) {
-            short x = mt->x;
-            short y = mt->y;
+        if(netgame && mthing.type == 1) {
+            short x = mthing.x;
+            short y = mthing.y;
 
             if(!p2start) {
-                mt->type = 2;
-                mt->x = x;
-                mt->y = y;
-                P_SpawnMapThing(mt);
+                mthing.type = 2;
+                mthing.x = x;
+                mthing.y = y;
+                P_SpawnMapThing(&mthing);
                 CON_Warnf("No free spot for player 2\n");
             }
 
             if(!p3start) {
-                mt->type = 3;
-                mt->x = x;
-                mt->y = y;
-                P_SpawnMapThing(mt);
+                mthing.type = 3;
+                mthing.x = x;
+                mthing.y = y;
+                P_SpawnMapThing(&mthing);
                 CON_Warnf("No free spot for player 3\n");
             }
 
             if(!p4start) {
-                mt->type = 4;
-                mt->x = x;
-                mt->y = y;
-                P_SpawnMapThing(mt);
+                mthing.type = 4;
+                mthing.x = x;
+                mthing.y = y;
+                P_SpawnMapThing(&mthing);
                 CON_Warnf("No free spot for player 4\n");
             }
         }
@@ -690,10 +719,27 @@ void P_LoadSideDefs(int lump) {
     for(i=0 ; i<numsides ; i++, msd++, sd++) {
         sd->textureoffset = INT2F(SHORT(msd->textureoffset));
         sd->rowoffset = INT2F(SHORT(msd->rowoffset));
+        sd->sector = &sectors[SHORT(msd->sector)];
+    }
+
+    P_LoadSideTextures(lump);
+}
+
+//
+// P_LoadSideTextures
+//
+
+void P_LoadSideTextures(int lump) {
+    int                 i;
+    mapsidedef_t*       msd;
+    side_t*             sd;
+
+    msd = (mapsidedef_t *)W_GetMapLump(lump);
+    sd = sides;
+    for(i=0 ; i<numsides ; i++, msd++, sd++) {
         sd->toptexture = P_GetTextureHashKey(msd->toptexture);
         sd->bottomtexture = P_GetTextureHashKey(msd->bottomtexture);
         sd->midtexture = P_GetTextureHashKey(msd->midtexture);
-        sd->sector = &sectors[SHORT(msd->sector)];
     }
 }
 
@@ -702,12 +748,30 @@ void P_LoadSideDefs(int lump) {
 //
 
 void P_LoadReject(int lump) {
-    int size = 0;
+    int size;
+    int len;
+    int i;
 
-    size = W_MapLumpLength(lump);
-    rejectmatrix = (byte*)Z_Malloc(size, PU_LEVEL, 0);
-    dmemset(rejectmatrix, 0, size);
-    dmemcpy(rejectmatrix, (byte*)W_GetMapLump(lump), size);
+    size = (numsectors * numsectors + 7) / 8;
+    len = W_MapLumpLength(lump);
+
+    rejectmatrix = (byte*)Z_Malloc(MAX(size, 1), PU_LEVEL, 0);
+    dmemset(rejectmatrix, 0, MAX(size, 1));
+
+    if(len >= size) {
+        dmemcpy(rejectmatrix, (byte*)W_GetMapLump(lump), size);
+
+        // a lump with anything in it is trusted as it is
+        for(i = 0; i < size; i++) {
+            if(rejectmatrix[i]) {
+                return;
+            }
+        }
+    }
+
+    if(p_buildreject) {
+        P_BuildReject();
+    }
 }
 
 static const char *bmaperrormsg;
@@ -716,33 +780,44 @@ static const char *bmaperrormsg;
 // P_VerifyBlockMap
 //
 // haleyjd 03/04/10: do verification on validity of blockmap.
+// Offsets are read unsigned so that lumps up to 64k entries are usable.
 //
-static dboolean P_VerifyBlockMap(int count) {
+static dboolean P_VerifyBlockMap(short *lump, int count) {
     dboolean isvalid = true;
+    int width, height;
     int x, y;
-    short *maxoffs = blockmaplump + count;
+    short *maxoffs = lump + count;
 
     bmaperrormsg = NULL;
 
-    for(y = 0; y < bmapheight; ++y) {
-        for(x = 0; x < bmapwidth; ++x) {
-            int offset;
+    if(count < 4) {
+        bmaperrormsg = "missing header";
+        return false;
+    }
+
+    width = lump[2];
+    height = lump[3];
+
+    if(width <= 0 || height <= 0 || width * height > count - 4) {
+        bmaperrormsg = "bad dimensions";
+        return false;
+    }
+
+    for(y = 0; y < height; ++y) {
+        for(x = 0; x < width; ++x) {
             short *list, *tmplist;
-            short *blockoffset;
+            int offset;
 
-            offset = y * bmapwidth + x;
-            blockoffset = blockmaplump + offset + 4;
+            offset = (word)lump[y * width + x + 4];
+            list   = lump + offset;
 
             // check that block offset is in bounds
-            if(blockoffset >= maxoffs) {
+            if(list >= maxoffs) {
                 isvalid = false;
                 bmaperrormsg = "offset overflow";
                 break;
             }
 
-            offset = *blockoffset;
-            list   = blockmaplump + offset;
-
             // scan forward for a -1 terminator before maxoffs
             for(tmplist = list; ; ++tmplist) {
                 // we have overflowed the lump?
@@ -781,43 +856,249 @@ static dboolean P_VerifyBlockMap(int count) {
     return isvalid;
 }
 
+//
+// P_AllocBlockMap
+// Allocates blockmaplump with room for the header,
+// the cell offsets and numentries line indices.
+//
+
+static void P_AllocBlockMap(int width, int height, int numentries) {
+    blockmapsize = 4 + (width * height + 1) + numentries;
+    blockmaplump = (int*)Z_Malloc(blockmapsize * sizeof(int), PU_LEVEL, 0);
+    blockmaplump[2] = width;
+    blockmaplump[3] = height;
+}
+
+//
+// P_ConvertBlockMap
+// Repacks a verified 16-bit blockmap lump into the
+// engine's 32-bit layout. Lists are kept as they are,
+// including the leading zero some node builders emit.
+//
+
+static void P_ConvertBlockMap(short *lump) {
+    int width = lump[2];
+    int height = lump[3];
+    int cells = width * height;
+    int total = 0;
+    int *offsets;
+    int *out;
+    short *list;
+    int i;
+
+    for(i = 0; i < cells; i++) {
+        for(list = lump + (word)lump[i + 4]; *list != -1; list++) {
+            total++;
+        }
+    }
+
+    P_AllocBlockMap(width, height, total);
+
+    blockmaplump[0] = lump[0];
+    blockmaplump[1] = lump[1];
+
+    offsets = blockmaplump + 4;
+    out = offsets + cells + 1;
+
+    for(i = 0; i < cells; i++) {
+        offsets[i] = out - blockmaplump;
+        for(list = lump + (word)lump[i + 4]; *list != -1; list++) {
+            *out++ = *list;
+        }
+    }
+
+    offsets[cells] = out - blockmaplump;
+}
+
+//
+// P_BlockMapLine
+// Walks the blocks whose bounding box the line overlaps and
+// keeps those the line actually passes through. When list is
+// NULL the per-block counts are bumped, otherwise the line is
+// stored at the block's fill position.
+//
+
+static void P_BlockMapLine(int linenum, int *counts, int *list) {
+    line_t *ld = &lines[linenum];
+    double x1 = (double)ld->v1->x;
+    double y1 = (double)ld->v1->y;
+    double dx = (double)ld->dx;
+    double dy = (double)ld->dy;
+    int bxl, bxh, byl, byh;
+    int bx, by;
+
+    bxl = (ld->bbox[BOXLEFT] - bmaporgx) >> MAPBLOCKSHIFT;
+    bxh = (ld->bbox[BOXRIGHT] - bmaporgx) >> MAPBLOCKSHIFT;
+    byl = (ld->bbox[BOXBOTTOM] - bmaporgy) >> MAPBLOCKSHIFT;
+    byh = (ld->bbox[BOXTOP] - bmaporgy) >> MAPBLOCKSHIFT;
+
+    for(by = byl; by <= byh; by++) {
+        for(bx = bxl; bx <= bxh; bx++) {
+            int block = by * bmapwidth + bx;
+
+            // only diagonal lines can miss blocks inside their box
+            if(ld->slopetype == ST_POSITIVE || ld->slopetype == ST_NEGATIVE) {
+                double left = (double)bmaporgx + (double)bx * MAPBLOCKSIZE;
+                double bottom = (double)bmaporgy + (double)by * MAPBLOCKSIZE;
+                double right = left + MAPBLOCKSIZE;
+                double top = bottom + MAPBLOCKSIZE;
+                double c1 = dx * (bottom - y1) - dy * (left - x1);
+                double c2 = dx * (bottom - y1) - dy * (right - x1);
+                double c3 = dx * (top - y1) - dy * (left - x1);
+                double c4 = dx * (top - y1) - dy * (right - x1);
+
+                // all four corners on one side, so the line misses this block
+                if((c1 > 0 && c2 > 0 && c3 > 0 && c4 > 0) ||
+                        (c1 < 0 && c2 < 0 && c3 < 0 && c4 < 0)) {
+                    continue;
+                }
+            }
+
+            if(list) {
+                list[counts[block]++] = linenum;
+            }
+            else {
+                counts[block]++;
+            }
+        }
+    }
+}
+
+//
+// P_BuildBlockMap
+// Generates the blockmap from the loaded linedefs, sized from
+// the map bounds. The result is laid out like a compressed
+// sparse row matrix: blockmap[n] to blockmap[n + 1] is the
+// range of line indices in block n.
+//
+
+static void P_BuildBlockMap(void) {
+    fixed_t bbox[4];
+    int minx, miny, maxx, maxy;
+    int width, height, cells;
+    int *offsets;
+    int *fill;
+    int i;
+
+    M_ClearBox(bbox);
+    for(i = 0; i < numvertexes; i++) {
+        M_AddToBox(bbox, vertexes[i].x, vertexes[i].y);
+    }
+
+    if(!numvertexes) {
+        bbox[BOXLEFT] = bbox[BOXRIGHT] = 0;
+        bbox[BOXBOTTOM] = bbox[BOXTOP] = 0;
+    }
+
+    // same margin the node builders leave around the map
+    minx = (bbox[BOXLEFT] >> FRACBITS) - 8;
+    miny = (bbox[BOXBOTTOM] >> FRACBITS) - 8;
+    maxx = (bbox[BOXRIGHT] >> FRACBITS) + 1;
+    maxy = (bbox[BOXTOP] >> FRACBITS) + 1;
+
+    width = ((maxx - minx) >> MAPBTOFRAC) + 1;
+    height = ((maxy - miny) >> MAPBTOFRAC) + 1;
+    cells = width * height;
+
+    bmaporgx = INT2F(minx);
+    bmaporgy = INT2F(miny);
+    bmapwidth = width;
+    bmapheight = height;
+
+    // first pass counts the lines in each block, shifted up
+    // by one so the running sum leaves each block's start
+    offsets = (int*)Z_Calloc((cells + 1) * sizeof(int), PU_STATIC, 0);
+    for(i = 0; i < numlines; i++) {
+        P_BlockMapLine(i, offsets + 1, NULL);
+    }
+
+    for(i = 0; i < cells; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+
+    P_AllocBlockMap(width, height, offsets[cells]);
+
+    blockmaplump[0] = minx;
+    blockmaplump[1] = miny;
+
+    for(i = 0; i <= cells; i++) {
+        blockmaplump[i + 4] = offsets[i] + 4 + cells + 1;
+    }
+
+    // second pass fills the lists in linedef order,
+    // using the start positions as fill cursors
+    fill = blockmaplump + 4 + cells + 1;
+    for(i = 0; i < numlines; i++) {
+        P_BlockMapLine(i, offsets, fill);
+    }
+
+    Z_Free(offsets);
+
+    CON_DPrintf("built %ix%i blockmap\n", width, height);
+}
 
 //
 // P_LoadBlockMap
+// Uses the map's blockmap lump when it is usable, otherwise
+// builds one. The lump only has 16-bit offsets, so it can't
+// describe large maps.
 //
 
 void P_LoadBlockMap(int lump) {
     int         i;
     int         count;
-    void*       mapdata;
+    short*      data;
     size_t      len;
 
-    mapdata = W_GetMapLump(lump);
     len = W_MapLumpLength(lump);
+    count = len / 2;
+
+    if(count < 4 || count > 0x10000) {
+        P_BuildBlockMap();
+        P_InitBlockMap();
+        return;
+    }
 
     //
     // GhostlyDeath <10/3/11> -- Reallocate and copy since
     // W_GetMapLump() doesn't quite work like we want it to on 64-bit
     // it works, just the way it is laid out
     //
-    blockmaplump = (short*) Z_Malloc(len, PU_LEVEL, NULL);
-    memmove(blockmaplump, mapdata, len);
-    blockmap = blockmaplump + 4;
-    count = len / 2;
+    data = (short*) Z_Malloc(len, PU_STATIC, NULL);
+    memmove(data, W_GetMapLump(lump), len);
 
     for(i = 0; i < count; i++) {
-        blockmaplump[i] = SHORT(blockmaplump[i]);
+        data[i] = SHORT(data[i]);
+    }
+
+    if(P_VerifyBlockMap(data, count)) {
+        P_ConvertBlockMap(data);
+    }
+    else {
+        CON_Warnf("P_LoadBlockMap: Bad blockmap - %s, rebuilding\n", bmaperrormsg);
+        P_BuildBlockMap();
     }
 
+    Z_Free(data);
+
+    P_InitBlockMap();
+}
+
+//
+// P_InitBlockMap
+// Set up the blockmap globals from blockmaplump.
+//
+
+void P_InitBlockMap(void) {
+    int count;
+
+    blockmap = blockmaplump + 4;
+
     bmaporgx = INT2F(blockmaplump[0]);
     bmaporgy = INT2F(blockmaplump[1]);
     bmapwidth = blockmaplump[2];
     bmapheight = blockmaplump[3];
 
-    if(!P_VerifyBlockMap(count)) {
-        I_Error("P_LoadBlockMap: Bad blockmap - %s", bmaperrormsg);
-    }
-
     // clear out mobj chains
     count = sizeof(*blocklinks)* bmapwidth*bmapheight;
     blocklinks = (mobj_t**) Z_Malloc(count,PU_LEVEL, 0);
@@ -1017,18 +1298,33 @@ void P_SetupLevel(int map, int playermask, skill_t skill) {
 
     W_CacheMapLump(map);
     P_LoadMacros(ML_MACROS);
-    P_LoadVertexes(ML_VERTEXES);
-    P_LoadSectors(ML_SECTORS);
-    P_LoadSideDefs(ML_SIDEDEFS);
-    P_LoadLineDefs(ML_LINEDEFS);
-    P_LoadSubsectors(ML_SSECTORS);
-    P_LoadBlockMap(ML_BLOCKMAP);
-    P_LoadNodes(ML_NODES);
-    P_LoadSegs(ML_SEGS);
-    P_LoadLeafs(ML_LEAFS);
-    P_LoadReject(ML_REJECT);
+
+    //
+    // The level geometry comes from the packed map cache if there is one
+    // for this map, otherwise it is built from the map lumps and packed
+    // for next time.
+    //
+    if(P_LoadPackedMap()) {
+        P_LoadSectorTextures(ML_SECTORS);
+        P_LoadSideTextures(ML_SIDEDEFS);
+        P_InitBlockMap();
+    }
+    else {
+        P_LoadVertexes(ML_VERTEXES);
+        P_LoadSectors(ML_SECTORS);
+        P_LoadSideDefs(ML_SIDEDEFS);
+        P_LoadLineDefs(ML_LINEDEFS);
+        P_LoadSubsectors(ML_SSECTORS);
+        P_LoadBlockMap(ML_BLOCKMAP);
+        P_LoadNodes(ML_NODES);
+        P_LoadSegs(ML_SEGS);
+        P_LoadLeafs(ML_LEAFS);
+        P_LoadReject(ML_REJECT);
+        P_GroupLines();
+        P_SavePackedMap();
+    }
+
     P_LoadLights(ML_LIGHTS);
-    P_GroupLines();
     P_LoadThings(ML_THINGS);
     W_FreeMapLump();
 
@@ -32,20 +32,54 @@
 #include "i_system.h"
 #include "p_local.h"
 #include "doomstat.h"
+#include "z_zone.h"
+
+#include <easy/profiler.h>
+#include <system/thread_pool.hh>
 
 //
-// P_CheckSight
+// Shared with the aiming code in p_map.cc
 //
-fixed_t     sightzstart;        // eye z of looker
 fixed_t     topslope;
 fixed_t     bottomslope;        // slopes to top and bottom of target
 
-divline_t   strace;             // from t1 to t2
-fixed_t     t2x;
-fixed_t     t2y;
+//
+// State for a single sight trace. Each trace keeps its own line marks
+// instead of using validcount, so that traces can run side by side.
+//
+typedef struct {
+    fixed_t     sightzstart;        // eye z of looker
+    fixed_t     topslope;
+    fixed_t     bottomslope;        // slopes to top and bottom of target
+
+    divline_t   strace;             // from t1 to t2
+    fixed_t     t2x;
+    fixed_t     t2y;
+
+    int         validcount;
+    int*        linevalid;          // [numlines] validcount of each line
+    int         numlines;
+
+    int         sightcounts[2];
+} sighttrace_t;
 
 int         sightcounts[2];
 
+static sighttrace_t     mainsight;
+
+// Batched sight checks for P_ScanSights
+
+#define SIGHT_MINBATCH      32      // fewer checks than this are run serially
+#define SIGHT_MAXCONTEXTS   64
+
+typedef struct {
+    mobj_t*     mobj;
+    dboolean    result;
+} sightcheck_t;
+
+static sightcheck_t*    sightchecks;
+static int              maxsightchecks;
+static sighttrace_t     sightcontexts[SIGHT_MAXCONTEXTS];
 
 //
 // P_DivlineSide
@@ -126,12 +160,27 @@ fixed_t P_InterceptVector2(divline_t* v2, divline_t* v1) {
     return frac;
 }
 
+//
+// P_InitSightTrace
+// Make sure a trace has line marks for the current level. Allocates, so
+// this must be done on the main thread.
+//
+
+static void P_InitSightTrace(sighttrace_t* trace) {
+    if(trace->numlines != numlines) {
+        trace->linevalid = (int*)Z_Realloc(trace->linevalid, numlines * sizeof(int), PU_STATIC, NULL);
+        dmemset(trace->linevalid, 0, numlines * sizeof(int));
+        trace->numlines = numlines;
+        trace->validcount = 0;
+    }
+}
+
 //
 // P_CrossSubsector
 // Returns true if strace crosses the given subsector successfully.
 //
 
-dboolean P_CrossSubsector(int num) {
+static dboolean P_CrossSubsector(sighttrace_t* trace, int num) {
     seg_t*          seg;
     line_t*         line;
     int             s1;
@@ -168,16 +217,16 @@ dboolean P_CrossSubsector(int num) {
         }
 
         // allready checked other side?
-        if(line->validcount == validcount) {
+        if(trace->linevalid[line - lines] == trace->validcount) {
             continue;
         }
 
-        line->validcount = validcount;
+        trace->linevalid[line - lines] = trace->validcount;
 
         v1 = line->v1;
         v2 = line->v2;
-        s1 = P_DivlineSide(v1->x,v1->y, &strace);
-        s2 = P_DivlineSide(v2->x, v2->y, &strace);
+        s1 = P_DivlineSide(v1->x,v1->y, &trace->strace);
+        s2 = P_DivlineSide(v2->x, v2->y, &trace->strace);
 
         // line isn't crossed?
         if(s1 == s2) {
@@ -188,8 +237,8 @@ dboolean P_CrossSubsector(int num) {
         divl.y = v1->y;
         divl.dx = v2->x - v1->x;
         divl.dy = v2->y - v1->y;
-        s1 = P_DivlineSide(strace.x, strace.y, &divl);
-        s2 = P_DivlineSide(t2x, t2y, &divl);
+        s1 = P_DivlineSide(trace->strace.x, trace->strace.y, &divl);
+        s2 = P_DivlineSide(trace->t2x, trace->t2y, &divl);
 
         // line isn't crossed?
         if(s1 == s2) {
@@ -234,23 +283,23 @@ dboolean P_CrossSubsector(int num) {
             return false;    // stop
         }
 
-        frac = P_InterceptVector2(&strace, &divl);
+        frac = P_InterceptVector2(&trace->strace, &divl);
 
         if(front->floorheight != back->floorheight) {
-            slope = FixedDiv(openbottom - sightzstart , frac);
-            if(slope > bottomslope) {
-                bottomslope = slope;
+            slope = FixedDiv(openbottom - trace->sightzstart , frac);
+            if(slope > trace->bottomslope) {
+                trace->bottomslope = slope;
             }
         }
 
         if(front->ceilingheight != back->ceilingheight) {
-            slope = FixedDiv(opentop - sightzstart , frac);
-            if(slope < topslope) {
-                topslope = slope;
+            slope = FixedDiv(opentop - trace->sightzstart , frac);
+            if(slope < trace->topslope) {
+                trace->topslope = slope;
             }
         }
 
-        if(topslope <= bottomslope) {
+        if(trace->topslope <= trace->bottomslope) {
             return false;    // stop
         }
     }
@@ -266,68 +315,65 @@ dboolean P_CrossSubsector(int num) {
 // Returns true if strace crosses the given node successfully.
 //
 
-dboolean P_CrossBSPNode(int bspnum) {
+static dboolean P_CrossBSPNode(sighttrace_t* trace, int bspnum) {
     node_t* bsp;
     int     side;
 
     if(bspnum & NF_SUBSECTOR) {
         if(bspnum == -1) {
-            return P_CrossSubsector(0);
+            return P_CrossSubsector(trace, 0);
         }
         else {
-            return P_CrossSubsector(bspnum&(~NF_SUBSECTOR));
+            return P_CrossSubsector(trace, bspnum&(~NF_SUBSECTOR));
         }
     }
 
     bsp = &nodes[bspnum];
 
     // decide which side the start point is on
-    side = P_DivlineSide(strace.x, strace.y, (divline_t *)bsp);
+    side = P_DivlineSide(trace->strace.x, trace->strace.y, (divline_t *)bsp);
     if(side == 2) {
         side = 0;    // an "on" should cross both sides
     }
 
     // cross the starting side
-    if(!P_CrossBSPNode(bsp->children[side])) {
+    if(!P_CrossBSPNode(trace, bsp->children[side])) {
         return false;
     }
 
     // the partition plane is crossed here
-    if(side == P_DivlineSide(t2x, t2y,(divline_t *)bsp)) {
+    if(side == P_DivlineSide(trace->t2x, trace->t2y,(divline_t *)bsp)) {
         // the line doesn't touch the other side
         return true;
     }
 
     // cross the ending side
-    return P_CrossBSPNode(bsp->children[side^1]);
+    return P_CrossBSPNode(trace, bsp->children[side^1]);
 }
 
 
 //
-// P_CheckSight
-// Returns true if a straight line between t1 and t2 is unobstructed.
-// Uses REJECT.
+// P_CheckReject
+// Returns true if the REJECT table says nothing in s1 can see s2.
 //
 
-dboolean P_CheckSight(mobj_t* t1, mobj_t* t2) {
-    int     s1;
-    int     s2;
-    int     pnum;
-    int     bytenum;
-    int     bitnum;
+dboolean P_CheckReject(sector_t* s1, sector_t* s2) {
+    int pnum = (s1 - sectors) * numsectors + (s2 - sectors);
 
-    // First check for trivial rejection.
+    return (rejectmatrix[pnum >> 3] & (1 << (pnum & 7))) != 0;
+}
 
-    // Determine subsector entries in REJECT table.
-    s1 = (t1->subsector->sector - sectors);
-    s2 = (t2->subsector->sector - sectors);
-    pnum = s1*numsectors + s2;
-    bytenum = pnum>>3;
-    bitnum = 1 << (pnum&7);
+//
+// P_TraceSight
+// Returns true if a straight line between t1 and t2 is unobstructed.
+// Uses REJECT. Only reads the level, so traces with their own context
+// can run in parallel.
+//
 
-    // Check in REJECT table.
-    if(rejectmatrix[bytenum]&bitnum) {
-        sightcounts[0]++;
+static dboolean P_TraceSight(sighttrace_t* trace, mobj_t* t1, mobj_t* t2) {
+    // First check for trivial rejection.
+    if(P_CheckReject(t1->subsector->sector, t2->subsector->sector)) {
+        trace->sightcounts[0]++;
 
         // can't possibly be connected
         return false;
@@ -335,23 +381,41 @@ dboolean P_CheckSight(mobj_t* t1, mobj_t* t2) {
 
     // An unobstructed LOS is possible.
     // Now look from eyes of t1 to any part of t2.
-    sightcounts[1]++;
+    trace->sightcounts[1]++;
 
-    D_IncValidCount();
+    trace->validcount++;
 
-    sightzstart = t1->z + t1->height - (t1->height>>2);
-    topslope = (t2->z+t2->height) - sightzstart;
-    bottomslope = (t2->z) - sightzstart;
+    trace->sightzstart = t1->z + t1->height - (t1->height>>2);
+    trace->topslope = (t2->z+t2->height) - trace->sightzstart;
+    trace->bottomslope = (t2->z) - trace->sightzstart;
 
-    strace.x = t1->x;
-    strace.y = t1->y;
-    t2x = t2->x;
-    t2y = t2->y;
-    strace.dx = t2->x - t1->x;
-    strace.dy = t2->y - t1->y;
+    trace->strace.x = t1->x;
+    trace->strace.y = t1->y;
+    trace->t2x = t2->x;
+    trace->t2y = t2->y;
+    trace->strace.dx = t2->x - t1->x;
+    trace->strace.dy = t2->y - t1->y;
 
     // the head node is the last node output
-    return P_CrossBSPNode(numnodes-1);
+    return P_CrossBSPNode(trace, numnodes-1);
+}
+
+//
+// P_CheckSight
+//
+
+dboolean P_CheckSight(mobj_t* t1, mobj_t* t2) {
+    dboolean result;
+
+    P_InitSightTrace(&mainsight);
+
+    result = P_TraceSight(&mainsight, t1, t2);
+
+    sightcounts[0] += mainsight.sightcounts[0];
+    sightcounts[1] += mainsight.sightcounts[1];
+    mainsight.sightcounts[0] = mainsight.sightcounts[1] = 0;
+
+    return result;
 }
 
 //
@@ -360,9 +424,20 @@ dboolean P_CheckSight(mobj_t* t1, mobj_t* t2) {
 // in main tick loop rather from multiple
 // mobj action routines
 //
+// The checks are gathered first and traced across the thread pool, each
+// worker with its own trace context. Nothing is written to the level while
+// tracing, and MF_SEETARGET is set afterwards in mobj list order, so the
+// result is the same as tracing them one at a time.
+//
 
 void P_ScanSights(void) {
+    EASY_FUNCTION(profiler::colors::Orange);
     mobj_t* mobj;
+    int     numchecks;
+    int     numcontexts;
+    int     i;
+
+    numchecks = 0;
 
     for(mobj = mobjhead.next; mobj != &mobjhead; mobj = mobj->next) {
         // must be killable
@@ -382,11 +457,72 @@ void P_ScanSights(void) {
             continue;
         }
 
-        if(!P_CheckSight(mobj, mobj->target)) {
+        // rejected pairs don't need a trace
+        if(P_CheckReject(mobj->subsector->sector, mobj->target->subsector->sector)) {
+            sightcounts[0]++;
             continue;
         }
 
-        mobj->flags |= MF_SEETARGET;
+        if(numchecks == maxsightchecks) {
+            maxsightchecks = maxsightchecks ? maxsightchecks * 2 : 128;
+            sightchecks = (sightcheck_t*)Z_Realloc(sightchecks,
+                                                   maxsightchecks * sizeof(sightcheck_t), PU_STATIC, NULL);
+        }
+
+        sightchecks[numchecks].mobj = mobj;
+        sightchecks[numchecks].result = false;
+        numchecks++;
+    }
+
+    if(numchecks == 0) {
+        return;
+    }
+
+    //
+    // Split the checks into contiguous runs, one per context. Small batches
+    // aren't worth waking the pool for.
+    //
+    if(numchecks < SIGHT_MINBATCH) {
+        numcontexts = 1;
+    }
+    else {
+        numcontexts = MIN((int)sys::ThreadPool::global().size() + 1, SIGHT_MAXCONTEXTS);
+        numcontexts = MIN(numcontexts, numchecks / (SIGHT_MINBATCH / 2));
+    }
+
+    for(i = 0; i < numcontexts; i++) {
+        P_InitSightTrace(&sightcontexts[i]);
     }
-}
 
+    auto tracebatch = [numchecks, numcontexts](size_t context) {
+        EASY_BLOCK("P_TraceSight batch", profiler::colors::Orange100);
+        sighttrace_t* trace = &sightcontexts[context];
+        int start = (int)(numchecks * context / numcontexts);
+        int end = (int)(numchecks * (context + 1) / numcontexts);
+        int j;
+
+        for(j = start; j < end; j++) {
+            mobj_t* mo = sightchecks[j].mobj;
+            sightchecks[j].result = P_TraceSight(trace, mo, mo->target);
+        }
+    };
+
+    if(numcontexts == 1) {
+        tracebatch(0);
+    }
+    else {
+        sys::ThreadPool::global().for_each(numcontexts, tracebatch);
+    }
+
+    for(i = 0; i < numchecks; i++) {
+        if(sightchecks[i].result) {
+            sightchecks[i].mobj->flags |= MF_SEETARGET;
+        }
+    }
+
+    for(i = 0; i < numcontexts; i++) {
+        sightcounts[0] += sightcontexts[i].sightcounts[0];
+        sightcounts[1] += sightcontexts[i].sightcounts[1];
+        sightcontexts[i].sightcounts[0] = sightcontexts[i].sightcounts[1] = 0;
+    }
+}
@@ -156,12 +156,6 @@ static void P_InitAnimdef(void) {
 
 animinfo_t* animinfo;
 
-//
-//      Animating line specials
-//
-
-extern line_t** linespeciallist;
-
 //
 // P_InitPicAnims
 //
@@ -472,36 +466,38 @@ fixed_t    P_FindHighestCeilingSurrounding(sector_t* sec) {
 
 
 //
-// P_FindSectorFromLineTag
-// RETURN NEXT SECTOR # THAT LINE TAG REFERS TO
+// P_InitTagLists
+//
+// killough 1/30/98: Hash each sector and line into a chain headed at
+// tag % count, so that tag searches only visit entries that can match.
+// Chains are built back to front so they are walked in ascending order,
+// which keeps the first match the same as a linear scan.
 //
 
-int P_FindSectorFromLineTag(line_t* line, int start) {
-    int    i;
+void P_InitTagLists(void) {
+    int i;
 
-    for(i = start + 1; i < numsectors; i++) {
-        if(sectors[i].tag == line->tag) {
-            return i;
-        }
+    for(i = 0; i < numsectors; i++) {
+        sectors[i].firsttag = -1;
     }
-    return -1;
-}
-
 
-//
-// P_FindLinedefFromTag
-//
+    for(i = numsectors - 1; i >= 0; i--) {
+        int j = (unsigned)sectors[i].tag % (unsigned)numsectors;
 
-int P_FindLinedefFromTag(int tag) {
-    int i = 0;
+        sectors[i].nexttag = sectors[j].firsttag;
+        sectors[j].firsttag = i;
+    }
 
     for(i = 0; i < numlines; i++) {
-        if(lines[i].tag == tag) {
-            return i;
-        }
+        lines[i].firsttag = -1;
     }
 
-    return -1;
+    for(i = numlines - 1; i >= 0; i--) {
+        int j = (unsigned)lines[i].tag % (unsigned)numlines;
+
+        lines[i].nexttag = lines[j].firsttag;
+        lines[j].firsttag = i;
+    }
 }
 
 //
@@ -509,16 +505,55 @@ int P_FindLinedefFromTag(int tag) {
 // Simplier version of P_FindSectorFromLineTag
 //
 
+static int P_FindNextSectorFromTag(int tag, int start) {
+    if(!numsectors) {
+        return -1;
+    }
+
+    start = start >= 0 ? sectors[start].nexttag :
+            sectors[(unsigned)tag % (unsigned)numsectors].firsttag;
+
+    while(start >= 0 && sectors[start].tag != tag) {
+        start = sectors[start].nexttag;
+    }
+
+    return start;
+}
+
 int P_FindSectorFromTag(int tag) {
-    int i = 0;
+    return P_FindNextSectorFromTag(tag, -1);
+}
 
-    for(i = 0; i < numsectors; i++) {
-        if(sectors[i].tag == tag) {
-            return i;
-        }
+//
+// P_FindSectorFromLineTag
+// RETURN NEXT SECTOR # THAT LINE TAG REFERS TO
+//
+
+int P_FindSectorFromLineTag(line_t* line, int start) {
+    return P_FindNextSectorFromTag(line->tag, start);
+}
+
+//
+// P_FindLinedefFromTag
+//
+
+static int P_FindNextLinedefFromTag(int tag, int start) {
+    if(!numlines) {
+        return -1;
+    }
+
+    start = start >= 0 ? lines[start].nexttag :
+            lines[(unsigned)tag % (unsigned)numlines].firsttag;
+
+    while(start >= 0 && lines[start].tag != tag) {
+        start = lines[start].nexttag;
     }
 
-    return -1;
+    return start;
+}
+
+int P_FindLinedefFromTag(int tag) {
+    return P_FindNextLinedefFromTag(tag, -1);
 }
 
 //
@@ -526,12 +561,10 @@ int P_FindSectorFromTag(int tag) {
 //
 
 dboolean P_ActivateLineByTag(int tag, mobj_t* activator) {
-    int i;
+    int i = P_FindLinedefFromTag(tag);
 
-    for(i = 0; i < numlines; i++) {
-        if(lines[i].tag == tag) {
-            return P_UseSpecialLine(activator, &lines[i], 0);
-        }
+    if(i >= 0) {
+        return P_UseSpecialLine(activator, &lines[i], 0);
     }
 
     return 1;
@@ -560,57 +593,56 @@ static int P_ModifyLine(int tag1, int tag2, int type) {
     
     line2 = &lines[linenum];
 
-    for(i = 0; i < numlines; i++) {
+    for(i = -1; (i = P_FindNextLinedefFromTag(tag1, i)) >= 0;) {
         line1 = &lines[i];
-        if(line1->tag == tag1) {
-            switch(type) {
-            case modl_flags:
-                if(line1->flags & ML_TWOSIDED) {
-                    line1->flags = (line2->flags | ML_TWOSIDED);
-                }
-                else {
-                    line1->flags = line2->flags;
-                    line1->flags &= ~ML_TWOSIDED;
-                }
-                break;
-            case modl_texture:
-                sides[line1->sidenum[0]].bottomtexture = sides[line2->sidenum[0]].bottomtexture;
-                sides[line1->sidenum[0]].midtexture = sides[line2->sidenum[0]].midtexture;
-                sides[line1->sidenum[0]].toptexture = sides[line2->sidenum[0]].toptexture;
-
-                if(line1->flags & ML_TWOSIDED || line1->sidenum[1] != NO_SIDE_INDEX) {
-                    sides[line1->sidenum[1]].bottomtexture = sides[line2->sidenum[1]].bottomtexture;
-                    sides[line1->sidenum[1]].midtexture = sides[line2->sidenum[1]].midtexture;
-                    sides[line1->sidenum[1]].toptexture = sides[line2->sidenum[1]].toptexture;
-                }
-
-                if(line1->flags & ML_SWITCHX02 &&
-                        !sides[line1->sidenum[0]].toptexture) {
-                    line1->flags &= ~ML_SWITCHX02;
-                }
+        switch(type) {
+        case modl_flags:
+            if(line1->flags & ML_TWOSIDED) {
+                line1->flags = (line2->flags | ML_TWOSIDED);
+            }
+            else {
+                line1->flags = line2->flags;
+                line1->flags &= ~ML_TWOSIDED;
+            }
+            P_UpdateLineScroller(line1);
+            break;
+        case modl_texture:
+            sides[line1->sidenum[0]].bottomtexture = sides[line2->sidenum[0]].bottomtexture;
+            sides[line1->sidenum[0]].midtexture = sides[line2->sidenum[0]].midtexture;
+            sides[line1->sidenum[0]].toptexture = sides[line2->sidenum[0]].toptexture;
+
+            if(line1->flags & ML_TWOSIDED || line1->sidenum[1] != NO_SIDE_INDEX) {
+                sides[line1->sidenum[1]].bottomtexture = sides[line2->sidenum[1]].bottomtexture;
+                sides[line1->sidenum[1]].midtexture = sides[line2->sidenum[1]].midtexture;
+                sides[line1->sidenum[1]].toptexture = sides[line2->sidenum[1]].toptexture;
+            }
 
-                if(line1->flags & (ML_SWITCHX04 | ML_SWITCHX08) &&
-                        !sides[line1->sidenum[0]].bottomtexture) {
-                    line1->flags &= ~(ML_SWITCHX04 | ML_SWITCHX08);
-                }
+            if(line1->flags & ML_SWITCHX02 &&
+                    !sides[line1->sidenum[0]].toptexture) {
+                line1->flags &= ~ML_SWITCHX02;
+            }
 
-                if(line1->flags & (ML_SWITCHX02 | ML_SWITCHX04) &&
-                        !sides[line1->sidenum[0]].midtexture) {
-                    line1->flags &= ~(ML_SWITCHX02 | ML_SWITCHX04);
-                }
+            if(line1->flags & (ML_SWITCHX04 | ML_SWITCHX08) &&
+                    !sides[line1->sidenum[0]].bottomtexture) {
+                line1->flags &= ~(ML_SWITCHX04 | ML_SWITCHX08);
+            }
 
-                if(line1->flags & (ML_SWITCHX02 | ML_SWITCHX08) &&
-                        !sides[line1->sidenum[0]].toptexture) {
-                    line1->flags &= ~(ML_SWITCHX02 | ML_SWITCHX08);
-                }
+            if(line1->flags & (ML_SWITCHX02 | ML_SWITCHX04) &&
+                    !sides[line1->sidenum[0]].midtexture) {
+                line1->flags &= ~(ML_SWITCHX02 | ML_SWITCHX04);
+            }
 
-                break;
-            case modl_data:
-                line1->special = line2->special;
-                break;
-            default:
-                break;
+            if(line1->flags & (ML_SWITCHX02 | ML_SWITCHX08) &&
+                    !sides[line1->sidenum[0]].toptexture) {
+                line1->flags &= ~(ML_SWITCHX02 | ML_SWITCHX08);
             }
+
+            break;
+        case modl_data:
+            line1->special = line2->special;
+            break;
+        default:
+            break;
         }
     }
 
@@ -666,6 +698,7 @@ static int P_ModifySector(line_t *line, int tag, int type) {
                 break;
             case mods_flags:
                 sec1->flags = sec2->flags;
+                P_UpdateSectorScroller(sec1);
                 break;
             default:
                 break;
@@ -1844,6 +1877,138 @@ void P_PlayerInSpecialSector(player_t* player) {
 }
 
 
+//
+// SCROLLERS
+//
+// Scrolling flats and walls are kept in compact lists so that
+// P_UpdateSpecials only touches the sectors and lines that actually
+// move. The per-tic offsets are worked out from the flags when an entry
+// is added or its flags change, so the update loop is just two adds.
+//
+
+typedef struct {
+    int*        index;  // sector or line number
+    fixed_t*    dx;
+    fixed_t*    dy;
+    int*        slot;   // [size] position in the list, -1 if not scrolling
+    int         count;
+} scrolllist_t;
+
+static scrolllist_t scrollsectors;
+static scrolllist_t scrolllines;
+
+static void P_InitScrollList(scrolllist_t* list, int size) {
+    int i;
+
+    list->index = (int*)Z_Malloc(sizeof(int) * size, PU_LEVEL, 0);
+    list->dx    = (fixed_t*)Z_Malloc(sizeof(fixed_t) * size, PU_LEVEL, 0);
+    list->dy    = (fixed_t*)Z_Malloc(sizeof(fixed_t) * size, PU_LEVEL, 0);
+    list->slot  = (int*)Z_Malloc(sizeof(int) * size, PU_LEVEL, 0);
+    list->count = 0;
+
+    for(i = 0; i < size; i++) {
+        list->slot[i] = -1;
+    }
+}
+
+static void P_SetScroller(scrolllist_t* list, int num, dboolean active, fixed_t dx, fixed_t dy) {
+    int slot = list->slot[num];
+
+    if(!active) {
+        if(slot >= 0) {
+            // move the last entry into the hole
+            list->count--;
+            list->index[slot] = list->index[list->count];
+            list->dx[slot] = list->dx[list->count];
+            list->dy[slot] = list->dy[list->count];
+            list->slot[list->index[slot]] = slot;
+            list->slot[num] = -1;
+        }
+
+        return;
+    }
+
+    if(slot < 0) {
+        slot = list->count++;
+        list->index[slot] = num;
+        list->slot[num] = slot;
+    }
+
+    list->dx[slot] = dx;
+    list->dy[slot] = dy;
+}
+
+//
+// P_UpdateSectorScroller
+// Add, remove or refresh a sector after its flags have changed
+//
+
+void P_UpdateSectorScroller(sector_t* sector) {
+    fixed_t speed;
+    fixed_t dx = 0;
+    fixed_t dy = 0;
+
+    if(sector->flags & MS_SCROLLFAST) {
+        speed = 3*FRACUNIT;
+    }
+    else {
+        speed = FRACUNIT;
+    }
+
+    if(sector->flags & MS_SCROLLLEFT) {
+        dx += speed;
+    }
+    if(sector->flags & MS_SCROLLRIGHT) {
+        dx -= speed;
+    }
+    if(sector->flags & MS_SCROLLUP) {
+        dy += speed;
+    }
+    if(sector->flags & MS_SCROLLDOWN) {
+        dy -= speed;
+    }
+
+    P_SetScroller(&scrollsectors, sector - sectors,
+                  (sector->flags & (MS_SCROLLFLOOR|MS_SCROLLCEILING)) != 0, dx, dy);
+}
+
+//
+// P_UpdateLineScroller
+// Add, remove or refresh a line after its flags have changed
+//
+
+void P_UpdateLineScroller(line_t* line) {
+    fixed_t dx = 0;
+    fixed_t dy = 0;
+
+    if(line->flags & ML_SCROLLRIGHT) {
+        dx += FRACUNIT;
+    }
+    if(line->flags & ML_SCROLLLEFT) {
+        dx -= FRACUNIT;
+    }
+    if(line->flags & ML_SCROLLUP) {
+        dy += FRACUNIT;
+    }
+    if(line->flags & ML_SCROLLDOWN) {
+        dy -= FRACUNIT;
+    }
+
+    P_SetScroller(&scrolllines, line - lines,
+                  (line->flags & (ML_SCROLLRIGHT|ML_SCROLLLEFT|ML_SCROLLUP|ML_SCROLLDOWN)) != 0,
+                  dx, dy);
+}
+
+//
+// P_SpecialStats
+//
+
+void P_SpecialStats(specialstats_t* stats) {
+    stats->scrollsectors = scrollsectors.count;
+    stats->scrolllines = scrolllines.count;
+    stats->buttons = numbuttons;
+}
+
 //
 // P_UpdateSpecials
 // Animate planes, scroll walls, etc.
@@ -1851,13 +2016,10 @@ void P_PlayerInSpecialSector(player_t* player) {
 
 dboolean        levelTimer;
 int             levelTimeCount;
-extern line_t** linespeciallist;
-extern short    numlinespecials;
 
 void P_UpdateSpecials(void) {
     int         i;
-    line_t*     line;
-    sector_t*   sector;
+    button_t*   button;
 
     //    LEVEL TIMER
     if(levelTimer == true) {
@@ -1871,53 +2033,19 @@ void P_UpdateSpecials(void) {
     P_CyclePicAnims();
 
     // ANIMATE LINE SPECIALS
-    for(i = 0; i < numlinespecials; i++) {
-        line = linespeciallist[i];
-        if(line->flags & ML_SCROLLRIGHT) {
-            sides[line->sidenum[0]].textureoffset += FRACUNIT;
-        }
+    for(i = 0; i < scrolllines.count; i++) {
+        side_t* side = &sides[lines[scrolllines.index[i]].sidenum[0]];
 
-        if(line->flags & ML_SCROLLLEFT) {
-            sides[line->sidenum[0]].textureoffset -= FRACUNIT;
-        }
-
-        if(line->flags & ML_SCROLLUP) {
-            sides[line->sidenum[0]].rowoffset += FRACUNIT;
-        }
-
-        if(line->flags & ML_SCROLLDOWN) {
-            sides[line->sidenum[0]].rowoffset -= FRACUNIT;
-        }
+        side->textureoffset += scrolllines.dx[i];
+        side->rowoffset += scrolllines.dy[i];
     }
 
     // UPDATE SCROLLING FLATS
-    for(i = 0; i < numsectors; i++) {
-        sector = &sectors[i];
-
-        if(sector->flags & (MS_SCROLLFLOOR|MS_SCROLLCEILING)) {
-            fixed_t speed;
-
-            if(sector->flags & MS_SCROLLFAST) {
-                speed = 3*FRACUNIT;
-            }
-            else {
-                speed = FRACUNIT;
-            }
-
-            if(sector->flags & MS_SCROLLLEFT) {
-                sector->xoffset += speed;
-            }
-            if(sector->flags & MS_SCROLLRIGHT) {
-                sector->xoffset -= speed;
-            }
-            if(sector->flags & MS_SCROLLUP) {
-                sector->yoffset += speed;
-            }
-            if(sector->flags & MS_SCROLLDOWN) {
-                sector->yoffset -= speed;
-            }
-        }
+    for(i = 0; i < scrollsectors.count; i++) {
+        sector_t* sector = &sectors[scrollsectors.index[i]];
 
+        sector->xoffset += scrollsectors.dx[i];
+        sector->yoffset += scrollsectors.dy[i];
     }
 
     // SKY TICKER
@@ -1926,31 +2054,36 @@ void P_UpdateSpecials(void) {
     }
 
     // DO BUTTONS
-    for(i = 0; i < MAXBUTTONS; i++) {
-        if(buttonlist[i].btimer) {
-            buttonlist[i].btimer--;
-            if(!buttonlist[i].btimer) {
-                switch(buttonlist[i].where) {
-                case top:
-                    sides[buttonlist[i].line->sidenum[0]].toptexture =
-                        swx_start + ((buttonlist[i].btexture - swx_start) ^ 1);
-                    break;
+    for(i = 0; i < numbuttons; i++) {
+        button = &buttonlist[i];
 
-                case middle:
-                    sides[buttonlist[i].line->sidenum[0]].midtexture =
-                        swx_start + ((buttonlist[i].btexture - swx_start) ^ 1);
-                    break;
+        if(--button->btimer) {
+            continue;
+        }
 
-                case bottom:
-                    sides[buttonlist[i].line->sidenum[0]].bottomtexture =
-                        swx_start + ((buttonlist[i].btexture - swx_start) ^ 1);
-                    break;
-                }
+        switch(button->where) {
+        case top:
+            sides[button->line->sidenum[0]].toptexture =
+                swx_start + ((button->btexture - swx_start) ^ 1);
+            break;
 
-                S_StartSound((mobj_t *)&buttonlist[i].line->frontsector->soundorg, sfx_switch1);
-                dmemset(&buttonlist[i],0,sizeof(button_t));
-            }
+        case middle:
+            sides[button->line->sidenum[0]].midtexture =
+                swx_start + ((button->btexture - swx_start) ^ 1);
+            break;
+
+        case bottom:
+            sides[button->line->sidenum[0]].bottomtexture =
+                swx_start + ((button->btexture - swx_start) ^ 1);
+            break;
         }
+
+        S_StartSound((mobj_t *)&button->line->frontsector->soundorg, sfx_switch1);
+
+        // keep the list packed
+        *button = buttonlist[--numbuttons];
+        dmemset(&buttonlist[numbuttons],0,sizeof(button_t));
+        i--;
     }
 
     scrollfrac += (FRACUNIT / 2);
@@ -1968,9 +2101,6 @@ void P_UpdateSpecials(void) {
 // that spawn thinkers
 //
 
-line_t**    linespeciallist;
-short       numlinespecials;
-
 void P_AddSectorSpecial(sector_t* sector) {
     if(!sector->special) {
         return;
@@ -2086,6 +2216,9 @@ void P_SpawnSpecials(void) {
         animinfo[i].isreverse = false;
     }
 
+    // killough 1/30/98: hash sectors and lines by tag
+    P_InitTagLists();
+
     // Init special sectors
     // Might as well count all the secrets while we're at it..
     sector = sectors;
@@ -2135,16 +2268,15 @@ void P_SpawnSpecials(void) {
         }
     }
 
-    //    Init line EFFECTs
-    numlinespecials = 0;
-    linespeciallist = (line_t**) Z_Malloc(sizeof(line_t*) * 1, PU_LEVEL, 0);
+    //    Init scrolling walls and flats
+    P_InitScrollList(&scrolllines, numlines);
     for(i = 0; i < numlines; i++) {
-        if(lines[i].flags & ML_SCROLLRIGHT || lines[i].flags & ML_SCROLLLEFT
-                || lines[i].flags & ML_SCROLLUP || lines[i].flags & ML_SCROLLDOWN) {
-            linespeciallist[numlinespecials++] = &lines[i];
-            linespeciallist = (line_t**)Z_Realloc(linespeciallist,
-                                                  (numlinespecials+1) * sizeof(line_t*), PU_LEVEL, 0);
-        }
+        P_UpdateLineScroller(&lines[i]);
+    }
+
+    P_InitScrollList(&scrollsectors, numsectors);
+    for(i = 0; i < numsectors; i++) {
+        P_UpdateSectorScroller(&sectors[i]);
     }
 
     //    Init other misc stuff
@@ -2159,5 +2291,7 @@ void P_SpawnSpecials(void) {
     for(i = 0; i < MAXBUTTONS; i++) {
         dmemset(&buttonlist[i],0,sizeof(button_t));
     }
+
+    numbuttons = 0;
 }
 
@@ -52,6 +52,17 @@ void        P_SpawnSpecials(void);      // at map load
 void        P_UpdateSpecials(void);     // every tic
 int         P_DoSpecialLine(mobj_t* thing, line_t* line, int side);
 void        P_AddSectorSpecial(sector_t* sector);
+void        P_UpdateSectorScroller(sector_t* sector);
+void        P_UpdateLineScroller(line_t* line);
+
+// Active special list sizes, for the developer stats
+typedef struct {
+    int scrollsectors;
+    int scrolllines;
+    int buttons;
+} specialstats_t;
+
+void        P_SpecialStats(specialstats_t* stats);
 void        P_SpawnDelayTimer(line_t* line, void (*func)(void));
 
 // when needed
@@ -68,6 +79,7 @@ fixed_t     P_FindHighestFloorSurrounding(sector_t* sec);
 fixed_t     P_FindNextHighestFloor(sector_t* sec, int currentheight);
 fixed_t     P_FindLowestCeilingSurrounding(sector_t* sec);
 fixed_t     P_FindHighestCeilingSurrounding(sector_t* sec);
+void        P_InitTagLists(void);
 int         P_FindSectorFromLineTag(line_t* line, int start);
 dboolean    P_ActivateLineByTag(int tag, mobj_t* activator);
 
@@ -204,6 +216,7 @@ typedef struct {
 #define BUTTONTIME      15
 
 extern button_t    buttonlist[MAXBUTTONS];
+extern int         numbuttons;
 
 void P_ChangeSwitchTexture(line_t* line, int useAgain);
 
@@ -39,6 +39,7 @@
 
 
 button_t buttonlist[MAXBUTTONS];
+int      numbuttons;         // active buttons, packed at the front
 
 
 //
@@ -50,28 +51,26 @@ void P_StartButton(line_t* line, bwhere_e w, int texture, int time) {
     int    i;
 
     // See if button is already pressed
-    for(i = 0; i < MAXBUTTONS; i++) {
-        if(buttonlist[i].btimer && buttonlist[i].line == line) {
+    for(i = 0; i < numbuttons; i++) {
+        if(buttonlist[i].line == line) {
             return;
         }
     }
 
-    for(i = 0; i < MAXBUTTONS; i++) {
-        if(!buttonlist[i].btimer) {
-            buttonlist[i].line = line;
-            buttonlist[i].where = w;
-            buttonlist[i].btexture = texture;
-            buttonlist[i].btimer = time;
+    if(numbuttons == MAXBUTTONS) {
+        I_Error("P_StartButton: no button slots left!");
+        return;
+    }
 
-            if(SWITCHMASK(line->flags)) {
-                buttonlist[i].soundorg = (mobj_t *)&line->frontsector->soundorg;
-            }
+    i = numbuttons++;
+    buttonlist[i].line = line;
+    buttonlist[i].where = w;
+    buttonlist[i].btexture = texture;
+    buttonlist[i].btimer = time;
 
-            return;
-        }
+    if(SWITCHMASK(line->flags)) {
+        buttonlist[i].soundorg = (mobj_t *)&line->frontsector->soundorg;
     }
-
-    I_Error("P_StartButton: no button slots left!");
 }
 
 //
@@ -40,6 +40,7 @@
 #include "r_wipe.h"
 #include "p_setup.h"
 #include "g_demo.h"
+#include "d_bench.h"
 
 extern BoolCvar i_interpolateframes;
 extern BoolCvar p_damageindicator;
@@ -428,6 +429,8 @@ bool P_Ticker(void) {
         return 0;
     }
 
+    D_BenchBegin(BS_TICKER);
+
     for(i = 0; i < MAXPLAYERS; i++) {
         if(playeringame[i]) {
             // do player reborns if needed
@@ -451,6 +454,8 @@ bool P_Ticker(void) {
     // for par times
     leveltime++;
 
+    D_BenchEnd(BS_TICKER);
+
     return gameaction;
 }
 
@@ -28,6 +28,7 @@
 #include "doomdef.h"
 #include "doomstat.h"
 #include "d_devstat.h"
+#include "d_bench.h"
 #include "r_local.h"
 #include "gl_texture.h"
 #include "gl_main.h"
@@ -112,6 +113,8 @@ void DL_ProcessDrawList(int tag, dboolean(*procfunc)(vtxlist_t*, int*)) {
 
     dl = &drawlist[tag];
 
+    D_BenchBegin(BS_DRAWLIST);
+
     if(dl->max > 0) {
         int palette = 0;
 
@@ -209,6 +212,8 @@ void DL_ProcessDrawList(int tag, dboolean(*procfunc)(vtxlist_t*, int*)) {
             head->data = NULL;
         }
     }
+
+    D_BenchEnd(BS_DRAWLIST);
 }
 
 //
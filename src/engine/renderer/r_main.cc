@@ -33,6 +33,7 @@
 #include "doomstat.h"
 #include "i_video.h"
 #include "d_devstat.h"
+#include "d_bench.h"
 #include "r_local.h"
 #include "r_sky.h"
 #include "r_clipper.h"
@@ -372,6 +373,11 @@ void R_PrecacheLevel(void) {
     int num;
     mobj_t* mo;
 
+    // nothing to upload to without a renderer
+    if(!usingGL) {
+        return;
+    }
+
     CON_DPrintf("--------R_PrecacheLevel--------\n");
     //GL_DumpTextures();
 
@@ -460,6 +466,9 @@ void R_PrecacheLevel(void) {
 
     CON_DPrintf("%i sprites cached\n", num);
 
+    // wait for the decoders to catch up
+    GL_FlushTextures();
+
     if(GLAD_GL_ARB_multitexture) {
         GL_SetTextureUnit(1, true);
         GL_BindEnvTexture();
@@ -493,6 +502,11 @@ void R_SetupFrame(player_t *player) {
 
     renderplayer = player;
 
+    //
+    // upload textures that finished decoding
+    //
+    GL_UploadTextures();
+
     //
     // reset active textures
     //
@@ -812,6 +826,8 @@ static void R_DrawContextWall(line_t* line) {
 //
 
 void R_RenderPlayerView(player_t *player) {
+    D_BenchBegin(BS_RENDER);
+
     if(!r_fillmode) {
         dglPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     }
@@ -921,6 +937,8 @@ void R_RenderPlayerView(player_t *player) {
         renderTic = (I_GetTimeMS() - renderTic);
     }
 
+    D_BenchEnd(BS_RENDER);
+
     //
     // check for new console commands
     //
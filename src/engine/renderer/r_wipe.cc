@@ -70,6 +70,10 @@ void WIPE_FadeScreen(int fadetics) {
 
     allowmenu = false;
 
+    if(!usingGL) {
+        return;
+    }
+
     wipeFadeAlpha = 0xff;
     wipeMeltTexture = GL_ScreenToTexture();
 
@@ -151,6 +155,10 @@ void WIPE_MeltScreen(void) {
     M_ClearMenus();
     allowmenu = false;
 
+    if(!usingGL) {
+        return;
+    }
+
     wipeMeltTexture = GL_ScreenToTexture();
 
     padw = GL_PadTextureDims(video_width);
@@ -36,6 +36,7 @@
 #include "m_random.h"
 #include "doomdef.h"
 #include "p_local.h"
+#include "g_demo.h"
 #include "doomstat.h"
 #include "tables.h"
 #include "r_local.h"
@@ -183,8 +184,6 @@ void S_StopMusic(void) {
 //
 
 void S_ResetSound(void) {
-    int i;
-
     if(nosound && nomusic) {
         return;
     }
@@ -193,9 +192,7 @@ void S_ResetSound(void) {
 
     // villsa 12282013 - make sure we clear all sound sources
     // during level transition
-    for(i = 0; i < I_GetMaxChannels(); i++) {
-        I_RemoveSoundSource(i);
-    }
+    I_RemoveSoundSource(NULL);
 }
 
 //
@@ -243,18 +240,7 @@ int S_GetActiveSounds(void) {
 //
 
 void S_RemoveOrigin(mobj_t* origin) {
-    int     channels;
-    mobj_t* source;
-    int     i;
-
-    channels = I_GetMaxChannels();
-
-    for(i = 0; i < channels; i++) {
-        source = (mobj_t*)I_GetSoundSource(i);
-        if(origin == source) {
-            I_RemoveSoundSource(i);
-        }
-    }
+    I_RemoveSoundSource((sndsrc_t*)origin);
 }
 
 //
@@ -269,6 +255,8 @@ void S_UpdateSounds(void) {
     mobj_t* source;
     int     channels;
 
+    I_UpdateSound();
+
     channels = I_GetMaxChannels();
 
     for(i = 0; i < channels; i++) {
@@ -308,7 +296,8 @@ void S_StartSound(mobj_t* origin, int sfx_id) {
     int sep;
     int reverb;
 
-    if(nosound) {
+    // stay quiet while fast forwarding a demo
+    if(nosound || G_DemoSeeking()) {
         return;
     }
 
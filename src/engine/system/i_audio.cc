@@ -29,7 +29,10 @@
 
 
 #include <stdlib.h>
+#include <limits.h>
 #include <algorithm>
+#include <atomic>
+#include <deque>
 
 #include "SDL.h"
 #include "fluidsynth.h"
@@ -49,21 +52,6 @@
 // 20120203 villsa - cvar for soundfont location
 StringCvar s_soundfont("s_soundfont", "doomsnd.sf2 location", "doomsnd.sf2");
 
-//
-// Mutex
-//
-static SDL_mutex *lock = NULL;
-#define MUTEX_LOCK()    SDL_mutexP(lock);
-#define MUTEX_UNLOCK()  SDL_mutexV(lock);
-
-//
-// Semaphore stuff
-//
-
-static SDL_sem *semaphore = NULL;
-#define SEMAPHORE_LOCK()    if(SDL_SemWait(semaphore) == 0) {
-#define SEMAPHORE_UNLOCK()  SDL_SemPost(semaphore); }
-
 // 20120205 villsa - bool to determine if sequencer is ready or not
 static dboolean seqready = false;
 
@@ -134,27 +122,29 @@ typedef struct {
     // used primarily by normal sounds
     byte        id;
 
-    // these are both accessed by the
-    // audio thread and the game code
-    // and should lock and unlock
-    // the mutex whenever these need
-    // to be modified..
+    // set by the audio thread when the channel
+    // starts. the game code may update the volume
+    // and pan of a playing channel. the origin is
+    // only compared against, never dereferenced;
+    // the game keeps its own copy (see seqsources)
     float       volume;
     byte        pan;
     sndsrc_t*   origin;
     int         depth;
 
-    // accessed by the audio thread only
+    // accessed by the audio thread only. times
+    // are in output frames; tics count from starttime
     byte        key;
     byte        velocity;
     byte*       pos;
     byte*       jump;
-    dword       tics;
-    dword       nexttic;
-    dword       lasttic;
-    dword       starttic;
-    Uint32      starttime;
-    Uint32      curtime;
+    Uint64      tics;
+    Uint64      nexttic;
+    Uint64      lasttic;
+    Uint64      starttic;
+    Uint64      starttime;
+    Uint64      curtime;
+    dboolean    started;
     chanstate_e state;
     dboolean    paused;
 
@@ -172,23 +162,84 @@ static channel_t playlist[MIDI_CHANNELS];   // channels active in sequencer
 // the backbone of the sequencer system. handles
 // global volume and panning for all sounds/tracks
 // and holds the allocated list of midi songs.
-// all data is modified through the game and read
-// by the audio thread.
+// the game never touches the playlist directly;
+// it queues commands which the audio callback runs
+// before rendering each buffer.
 //
 
-typedef int seqsignal_e;
+typedef int seqcmd_e;
 enum {
-    SEQ_SIGNAL_IDLE     = 0,    // idles. does nothing
-    SEQ_SIGNAL_SHUTDOWN,        // signal the sequencer to shutdown, cleaning up anything in the process
-    SEQ_SIGNAL_READY,           // sequencer will read and play any midi track fed to it
-    SEQ_SIGNAL_RESET,
-    SEQ_SIGNAL_PAUSE,
-    SEQ_SIGNAL_RESUME,
-    SEQ_SIGNAL_STOPALL,
-    SEQ_SIGNAL_SETGAIN,         // signal the sequencer to update output gain
-    MAXSIGNALTYPES
+    SEQ_CMD_RESET       = 0,
+    SEQ_CMD_PAUSE,
+    SEQ_CMD_RESUME,
+    SEQ_CMD_STOPALL,
+    SEQ_CMD_SETGAIN,            // update output gain
+    SEQ_CMD_STARTMUSIC,
+    SEQ_CMD_STARTSOUND,
+    SEQ_CMD_STOPSOUND,
+    SEQ_CMD_REMOVEORIGIN,       // forget an origin, or all of them if NULL
+    MAXSEQCMDS
 };
 
+typedef struct {
+    seqcmd_e    cmd;
+    int         id;         // song to start or stop
+    sndsrc_t*   origin;
+    unsigned    serial;     // game side source of a started sound
+    int         volume;
+    int         pan;
+    int         reverb;
+    float       gain;
+    Uint64      queued;     // performance counter when queued
+} seqcommand_t;
+
+//
+// COMMAND QUEUE
+//
+// Single producer (game thread), single consumer (audio
+// thread) ring. The game thread never waits on the audio
+// thread: if the ring is full, commands are held in a
+// backlog on the game side and moved over on the next push
+// or I_UpdateSound, in order.
+//
+
+#define SEQ_QUEUE_SIZE  256     // must be a power of two
+
+static seqcommand_t             seqqueue[SEQ_QUEUE_SIZE];
+static std::atomic<unsigned>    seqqueuehead(0);    // written by the game thread
+static std::atomic<unsigned>    seqqueuetail(0);    // written by the audio thread
+static std::deque<seqcommand_t> seqbacklog;         // game thread only
+
+//
+// SOUND SOURCES
+//
+// The game only follows origins through its own table,
+// never through the playlist. Each started sound gets a
+// serial; the game stores the origin under it, and the
+// audio thread publishes which serial each channel is
+// playing. Removing an origin clears it from the table
+// at once, which covers sounds that are still queued, and
+// queues SEQ_CMD_REMOVEORIGIN behind them so the audio
+// thread stops matching the pointer before it is reused.
+//
+
+#define SEQ_SOURCES     512     // must be a power of two
+
+typedef struct {
+    unsigned    serial;
+    sndsrc_t*   origin;
+} seqsource_t;
+
+static seqsource_t              seqsources[SEQ_SOURCES];    // game thread only
+static unsigned                 seqserial;                  // game thread only
+static std::atomic<unsigned>    playserial[MIDI_CHANNELS];  // written by the audio thread
+
+// audio thread counters, published once per second
+static std::atomic<int>         seqpeakdepth(0);
+static std::atomic<int>         seqcommands(0);
+static std::atomic<int>         seqlatency(0);
+static std::atomic<int>         seqmaxlatency(0);
+
 typedef union {
     sndsrc_t*   valsrc;
     int         valint;
@@ -202,9 +253,13 @@ typedef struct {
     fluid_synth_t*          synth;
     fluid_audio_driver_t*   driver;
     int                     sfont_id; // 20120112 bkw: needs to be signed
-    SDL_Thread*             thread;
     dword                   playtime;
 
+    // audio thread only. output frames rendered so far,
+    // which is the clock the songs are played against
+    Uint64                  samples;
+    int                     samplerate;
+
     dword                   voices;
 
     // tweakable settings for the sequencer
@@ -217,12 +272,6 @@ typedef struct {
 
     seqmessage_t            message[3];
 
-    // game code signals the sequencer to do stuff. game will
-    // wait (while loop) until the audio thread signals itself
-    // to be ready again
-    // MP2E 12102013 - Only change using Seq_SetStatus
-    seqsignal_e             signal;
-
     // 20120316 villsa - gain property (tweakable)
     float                   gain;
 } doomseq_t;
@@ -230,18 +279,7 @@ typedef struct {
 static doomseq_t doomseq = {0};   // doom sequencer
 
 typedef void(*eventhandler)(doomseq_t*, channel_t*);
-typedef int(*signalhandler)(doomseq_t*);
-
-//
-// Audio_Play
-//
-// Callback for SDL
-//
-static void Audio_Play(void *user, Uint8 *stream, int len)
-{
-    fluid_synth_t *synth = (fluid_synth_t *) user;
-    fluid_synth_write_s16(synth, len / (2 * sizeof(short)) , stream, 0, 2, stream, 1, 2);
-}
+typedef int(*commandhandler)(doomseq_t*, seqcommand_t*);
 
 //
 // Seq_SetGain
@@ -284,27 +322,68 @@ static double Song_GetTimeDivision(song_t* song) {
 }
 
 //
-// Seq_SetStatus
+// Seq_FlushBacklog
+//
+// Move commands held on the game side into the ring,
+// oldest first, for as long as there is room
 //
 
-static void Seq_SetStatus(doomseq_t* seq, int status) {
-    MUTEX_LOCK()
-    seq->signal = status;
-    MUTEX_UNLOCK()
+static void Seq_FlushBacklog(void) {
+    unsigned head;
+    unsigned tail;
+
+    if(seqbacklog.empty()) {
+        return;
+    }
+
+    head = seqqueuehead.load(std::memory_order_relaxed);
+    tail = seqqueuetail.load(std::memory_order_acquire);
+
+    while(!seqbacklog.empty() && head - tail < SEQ_QUEUE_SIZE) {
+        seqqueue[head & (SEQ_QUEUE_SIZE - 1)] = seqbacklog.front();
+        seqbacklog.pop_front();
+        head++;
+    }
+
+    seqqueuehead.store(head, std::memory_order_release);
 }
 
 //
-// Seq_WaitOnSignal
+// Seq_PushCommand
+//
+// Queue a command for the audio thread. Game thread only
 //
 
-/*static void Seq_WaitOnSignal(doomseq_t* seq)
-{
-    while(1)
-    {
-        if(seq->signal == SEQ_SIGNAL_READY)
-            break;
+static void Seq_PushCommand(seqcommand_t* cmd) {
+    unsigned head;
+    unsigned tail;
+
+    cmd->queued = SDL_GetPerformanceCounter();
+
+    Seq_FlushBacklog();
+
+    head = seqqueuehead.load(std::memory_order_relaxed);
+    tail = seqqueuetail.load(std::memory_order_acquire);
+
+    if(!seqbacklog.empty() || head - tail >= SEQ_QUEUE_SIZE) {
+        seqbacklog.push_back(*cmd);
+        return;
     }
-}*/
+
+    seqqueue[head & (SEQ_QUEUE_SIZE - 1)] = *cmd;
+    seqqueuehead.store(head + 1, std::memory_order_release);
+}
+
+//
+// Seq_SetStatus
+//
+
+static void Seq_SetStatus(doomseq_t* seq, seqcmd_e status) {
+    seqcommand_t cmd = {};
+
+    cmd.cmd = status;
+    Seq_PushCommand(&cmd);
+}
 
 //
 // Chan_SetMusicVolume
@@ -364,10 +443,11 @@ static dboolean Chan_CheckTrackEnd(channel_t* chan) {
 //
 // Chan_GetNextTick
 //
-// Read the midi track to get the next delta time
+// Read the midi track to get the next delta time,
+// converted to output frames
 //
 
-static dword Chan_GetNextTick(channel_t* chan) {
+static Uint64 Chan_GetNextTick(doomseq_t* seq, channel_t* chan) {
     dword tic;
     int i;
 
@@ -392,7 +472,8 @@ static dword Chan_GetNextTick(channel_t* chan) {
         }
     }
 
-    return (chan->starttic + (dword)((double)tic * chan->song->timediv));
+    // timediv is in milliseconds per midi tick
+    return (chan->starttic + (Uint64)((double)tic * chan->song->timediv * seq->samplerate / 1000.0));
 }
 
 //
@@ -449,6 +530,7 @@ static dboolean Chan_RemoveTrackFromPlaylist(doomseq_t* seq, channel_t* chan) {
     chan->starttic  = 0;
     chan->curtime   = 0;
     chan->starttime = 0;
+    chan->started   = false;
     chan->pos       = 0;
     chan->key       = 0;
     chan->velocity  = 0;
@@ -461,6 +543,8 @@ static dboolean Chan_RemoveTrackFromPlaylist(doomseq_t* seq, channel_t* chan) {
     chan->pan       = 0;
     chan->origin    = NULL;
 
+    playserial[chan - playlist].store(0, std::memory_order_release);
+
     seq->voices--;
 
     return true;
@@ -502,9 +586,10 @@ static channel_t* Song_AddTrackToPlaylist(doomseq_t* seq, song_t* song, track_t*
             playlist[i].depth       = 0;
             playlist[i].starttime   = 0;
             playlist[i].curtime     = 0;
+            playlist[i].started     = false;
 
             // immediately start reading the midi track
-            playlist[i].nexttic     = Chan_GetNextTick(&playlist[i]);
+            playlist[i].nexttic     = Chan_GetNextTick(seq, &playlist[i]);
 
             seq->voices++;
 
@@ -690,30 +775,13 @@ static const eventhandler seqeventlist[7] = {
 };
 
 //
-// Signal_Idle
-//
-
-static int Signal_Idle(doomseq_t* seq) {
-    return 0;
-}
-
-//
-// Signal_Shutdown
+// Cmd_StopAll
 //
 
-static int Signal_Shutdown(doomseq_t* seq) {
-    return -1;
-}
-
-//
-// Signal_StopAll
-//
-
-static int Signal_StopAll(doomseq_t* seq) {
+static int Cmd_StopAll(doomseq_t* seq, seqcommand_t* cmd) {
     channel_t* c;
     int i;
 
-    SEMAPHORE_LOCK()
     for(i = 0; i < MIDI_CHANNELS; i++) {
         c = &playlist[i];
 
@@ -721,34 +789,29 @@ static int Signal_StopAll(doomseq_t* seq) {
             Chan_RemoveTrackFromPlaylist(seq, c);
         }
     }
-    SEMAPHORE_UNLOCK()
 
-    Seq_SetStatus(seq, SEQ_SIGNAL_READY);
     return 1;
 }
 
 //
-// Signal_Reset
+// Cmd_Reset
 //
 
-static int Signal_Reset(doomseq_t* seq) {
+static int Cmd_Reset(doomseq_t* seq, seqcommand_t* cmd) {
     fluid_synth_system_reset(seq->synth);
-
-    Seq_SetStatus(seq, SEQ_SIGNAL_READY);
     return 1;
 }
 
 //
-// Signal_Pause
+// Cmd_Pause
 //
 // Pause all currently playing songs
 //
 
-static int Signal_Pause(doomseq_t* seq) {
+static int Cmd_Pause(doomseq_t* seq, seqcommand_t* cmd) {
     int i;
     channel_t* c;
 
-    SEMAPHORE_LOCK()
     for(i = 0; i < MIDI_CHANNELS; i++) {
         c = &playlist[i];
 
@@ -757,23 +820,20 @@ static int Signal_Pause(doomseq_t* seq) {
             Chan_StopTrack(seq, c);
         }
     }
-    SEMAPHORE_UNLOCK()
 
-    Seq_SetStatus(seq, SEQ_SIGNAL_READY);
     return 1;
 }
 
 //
-// Signal_Resume
+// Cmd_Resume
 //
 // Resume all songs that were paused
 //
 
-static int Signal_Resume(doomseq_t* seq) {
+static int Cmd_Resume(doomseq_t* seq, seqcommand_t* cmd) {
     int i;
     channel_t* c;
 
-    SEMAPHORE_LOCK()
     for(i = 0; i < MIDI_CHANNELS; i++) {
         c = &playlist[i];
 
@@ -782,38 +842,173 @@ static int Signal_Resume(doomseq_t* seq) {
             fluid_synth_noteon(seq->synth, c->track->channel, c->key, c->velocity);
         }
     }
-    SEMAPHORE_UNLOCK()
 
-    Seq_SetStatus(seq, SEQ_SIGNAL_READY);
     return 1;
 }
 
 //
-// Signal_UpdateGain
+// Cmd_UpdateGain
 //
 
-static int Signal_UpdateGain(doomseq_t* seq) {
-    SEMAPHORE_LOCK()
-
+static int Cmd_UpdateGain(doomseq_t* seq, seqcommand_t* cmd) {
+    seq->gain = cmd->gain;
     Seq_SetGain(seq);
+    return 1;
+}
 
-    SEMAPHORE_UNLOCK()
+//
+// Cmd_StartMusic
+//
+
+static int Cmd_StartMusic(doomseq_t* seq, seqcommand_t* cmd) {
+    song_t* song;
+    channel_t* chan;
+    int i;
+
+    song = &seq->songs[cmd->id];
+    for(i = 0; i < song->ntracks; i++) {
+        chan = Song_AddTrackToPlaylist(seq, song, &song->tracks[i]);
+
+        if(chan == NULL) {
+            break;
+        }
+
+        chan->volume = seq->musicvolume;
+    }
 
-    Seq_SetStatus(seq, SEQ_SIGNAL_READY);
     return 1;
 }
 
-static const signalhandler seqsignallist[MAXSIGNALTYPES] = {
-    Signal_Idle,
-    Signal_Shutdown,
-    NULL,
-    Signal_Reset,
-    Signal_Pause,
-    Signal_Resume,
-    Signal_StopAll,
-    Signal_UpdateGain
+//
+// Cmd_StartSound
+//
+
+static int Cmd_StartSound(doomseq_t* seq, seqcommand_t* cmd) {
+    song_t* song;
+    channel_t* chan;
+    int i;
+
+    song = &seq->songs[cmd->id];
+    for(i = 0; i < song->ntracks; i++) {
+        chan = Song_AddTrackToPlaylist(seq, song, &song->tracks[i]);
+
+        if(chan == NULL) {
+            break;
+        }
+
+        chan->volume = (float)cmd->volume;
+        chan->pan = (byte)(cmd->pan >> 1);
+        chan->origin = cmd->origin;
+        chan->depth = cmd->reverb;
+
+        playserial[chan - playlist].store(cmd->serial, std::memory_order_release);
+    }
+
+    return 1;
+}
+
+//
+// Cmd_StopSound
+//
+
+static int Cmd_StopSound(doomseq_t* seq, seqcommand_t* cmd) {
+    song_t* song;
+    channel_t* c;
+    int i;
+
+    song = &seq->songs[cmd->id];
+    for(i = 0; i < MIDI_CHANNELS; i++) {
+        c = &playlist[i];
+
+        if(song == c->song || (cmd->origin && c->origin == cmd->origin)) {
+            c->stop = true;
+        }
+    }
+
+    return 1;
+}
+
+//
+// Cmd_RemoveOrigin
+//
+
+static int Cmd_RemoveOrigin(doomseq_t* seq, seqcommand_t* cmd) {
+    int i;
+
+    for(i = 0; i < MIDI_CHANNELS; i++) {
+        if(!cmd->origin || playlist[i].origin == cmd->origin) {
+            playlist[i].origin = NULL;
+        }
+    }
+
+    return 1;
+}
+
+static const commandhandler seqcommandlist[MAXSEQCMDS] = {
+    Cmd_Reset,
+    Cmd_Pause,
+    Cmd_Resume,
+    Cmd_StopAll,
+    Cmd_UpdateGain,
+    Cmd_StartMusic,
+    Cmd_StartSound,
+    Cmd_StopSound,
+    Cmd_RemoveOrigin
 };
 
+//
+// Seq_RunCommands
+//
+// Run everything the game has queued since the last
+// audio callback
+//
+
+static void Seq_RunCommands(doomseq_t* seq) {
+    static Uint64 window = 0;
+    static Uint64 total = 0;
+    static int count = 0;
+    static int maxlatency = 0;
+    static int peak = 0;
+    unsigned tail = seqqueuetail.load(std::memory_order_relaxed);
+    unsigned head = seqqueuehead.load(std::memory_order_acquire);
+    Uint64 now = SDL_GetPerformanceCounter();
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    seqcommand_t* cmd;
+    int latency;
+
+    if((int)(head - tail) > peak) {
+        peak = head - tail;
+    }
+
+    while(tail != head) {
+        cmd = &seqqueue[tail & (SEQ_QUEUE_SIZE - 1)];
+        seqcommandlist[cmd->cmd](seq, cmd);
+
+        latency = (int)((now - cmd->queued) * 1000000 / freq);
+        total += latency;
+        count++;
+        maxlatency = std::max(maxlatency, latency);
+
+        tail++;
+    }
+
+    seqqueuetail.store(tail, std::memory_order_release);
+
+    // publish the counters for the last second
+    if(now - window >= freq) {
+        seqpeakdepth.store(peak, std::memory_order_relaxed);
+        seqcommands.store(count, std::memory_order_relaxed);
+        seqlatency.store(count ? (int)(total / count) : 0, std::memory_order_relaxed);
+        seqmaxlatency.store(maxlatency, std::memory_order_relaxed);
+
+        window = now;
+        total = 0;
+        count = 0;
+        maxlatency = 0;
+        peak = 0;
+    }
+}
+
 //
 // Chan_CheckState
 //
@@ -846,7 +1041,7 @@ static dboolean Chan_CheckState(doomseq_t* seq, channel_t* chan) {
 // Main midi parsing routine
 //
 
-static void Chan_RunSong(doomseq_t* seq, channel_t* chan, dword msecs) {
+static void Chan_RunSong(doomseq_t* seq, channel_t* chan, Uint64 frames) {
     byte event;
     byte c;
     song_t* song;
@@ -859,13 +1054,14 @@ static void Chan_RunSong(doomseq_t* seq, channel_t* chan, dword msecs) {
     //
     // get next tic
     //
-    if(chan->starttime == 0) {
-        chan->starttime = msecs;
+    if(!chan->started) {
+        chan->starttime = frames;
+        chan->started = true;
     }
 
     // villsa 12292013 - try to get precise timing to avoid de-syncs
-    chan->curtime = msecs;
-    chan->tics += ((chan->curtime - chan->starttime) - chan->tics);
+    chan->curtime = frames;
+    chan->tics = chan->curtime - chan->starttime;
 
     if(Chan_CheckState(seq, chan)) {
         return;
@@ -933,7 +1129,7 @@ static void Chan_RunSong(doomseq_t* seq, channel_t* chan, dword msecs) {
                 chan->state = CHAN_STATE_ENDED;
             }
             else {
-                chan->nexttic = Chan_GetNextTick(chan);
+                chan->nexttic = Chan_GetNextTick(seq, chan);
             }
         }
     }
@@ -942,14 +1138,17 @@ static void Chan_RunSong(doomseq_t* seq, channel_t* chan, dword msecs) {
 //
 // Seq_RunSong
 //
+// Returns the frame at which the next event is due on
+// any channel, or ULLONG_MAX if nothing is playing
+//
 
-static void Seq_RunSong(doomseq_t* seq, dword msecs) {
+static Uint64 Seq_RunSong(doomseq_t* seq, Uint64 frames) {
     int i;
     channel_t* chan;
+    Uint64 next = ULLONG_MAX;
 
-    seq->playtime = msecs;
+    seq->playtime = (dword)(frames * 1000 / seq->samplerate);
 
-    SEMAPHORE_LOCK()
     for(i = 0; i < MIDI_CHANNELS; i++) {
         chan = &playlist[i];
 
@@ -959,12 +1158,17 @@ static void Seq_RunSong(doomseq_t* seq, dword msecs) {
 
         if(chan->stop) {
             Chan_RemoveTrackFromPlaylist(seq, chan);
+            continue;
         }
-        else {
-            Chan_RunSong(seq, chan, msecs);
+
+        Chan_RunSong(seq, chan, frames);
+
+        if(chan->song && chan->state == CHAN_STATE_READY) {
+            next = std::min(next, chan->starttime + chan->nexttic);
         }
     }
-    SEMAPHORE_UNLOCK()
+
+    return next;
 }
 
 //
@@ -1079,16 +1283,6 @@ static bool Seq_RegisterSongs(doomseq_t* seq) {
 //
 
 static void Seq_Shutdown(doomseq_t* seq) {
-    //
-    // signal the sequencer to shut down
-    //
-    Seq_SetStatus(seq, SEQ_SIGNAL_SHUTDOWN);
-
-    //
-    // wait until the audio thread is finished
-    //
-    SDL_WaitThread(seq->thread, NULL);
-
     //
     // prevent calls to Audio_Play()
     //
@@ -1106,55 +1300,40 @@ static void Seq_Shutdown(doomseq_t* seq) {
 }
 
 //
-// Thread_PlayerHandler
+// Audio_Play
 //
-// Main routine of the audio thread
+// Callback for SDL. Runs the sequencer against the number of
+// frames rendered so far and splits the render at every event.
+// fluidsynth still applies events at the start of its next
+// 64 frame block, so timing is only as fine as that
 //
 
-static int SDLCALL Thread_PlayerHandler(void *param) {
-    doomseq_t* seq = (doomseq_t*)param;
-    long start = SDL_GetTicks();
-    long delay = 0;
-    int status;
-    dword count = 0;
-    signalhandler signal;
+static void Audio_Play(void *user, Uint8 *stream, int len) {
+    doomseq_t* seq = (doomseq_t*)user;
+    short* out = (short*)stream;
+    int frames = len / (2 * sizeof(short));
+    int pos = 0;
+    int count;
+    Uint64 due;
 
-    while(1) {
-        //
-        // check status of the sequencer
-        //
-        signal = seqsignallist[seq->signal];
+    Seq_RunCommands(seq);
 
-        if(signal) {
-            status = signal(seq);
+    while(pos < frames) {
+        due = Seq_RunSong(seq, seq->samples);
+        count = frames - pos;
 
-            if(status == 0) {
-                // villsa 12292013 - add a delay here so we don't
-                // thrash the loop while idling
-                SDL_Delay(1);
-                continue;
-            }
-
-            if(status == -1) {
-                return 1;
-            }
+        if(due <= seq->samples) {
+            count = 1;
+        }
+        else if(due - seq->samples < (Uint64)count) {
+            count = (int)(due - seq->samples);
         }
 
-        //
-        // play some songs
-        //
-        Seq_RunSong(seq, SDL_GetTicks() - start);
-        count++;
-
-        // try to avoid incremental time de-syncs
-        delay = count - (SDL_GetTicks() - start);
+        fluid_synth_write_s16(seq->synth, count, out, pos * 2, 2, out, pos * 2 + 1, 2);
 
-        if(delay > 0) {
-            SDL_Delay(delay);
-        }
+        pos += count;
+        seq->samples += count;
     }
-
-    return 0;
 }
 
 //
@@ -1168,43 +1347,8 @@ void I_InitSequencer(void) {
 
     CON_DPrintf("--------Initializing Software Synthesizer--------\n");
 
-    //
-    // init mutex
-    //
-    lock = SDL_CreateMutex();
-    if(lock == NULL) {
-        CON_Warnf("I_InitSequencer: failed to create mutex");
-        return;
-    }
-
-    //
-    // init semaphore
-    //
-    semaphore = SDL_CreateSemaphore(1);
-    if(semaphore == NULL) {
-        CON_Warnf("I_InitSequencer: failed to create semaphore");
-        return;
-    }
-
     dmemset(&doomseq, 0, sizeof(doomseq_t));
 
-    //
-    // init sequencer thread
-    //
-
-    // villsa 12292013 - I can't guarantee that this will resolve
-    // the issue of the titlemap/intermission/finale music to be
-    // off-sync when uncapped framerates are enabled but for some
-    // reason, calling SDL_GetTicks before initalizing the thread
-    // will reduce the chances of it happening
-    SDL_GetTicks();
-
-    doomseq.thread = SDL_CreateThread(Thread_PlayerHandler, "SynthPlayer", &doomseq);
-    if(doomseq.thread == NULL) {
-        CON_Warnf("I_InitSequencer: failed to create audio thread");
-        return;
-    }
-
     //
     // init settings
     //
@@ -1266,7 +1410,6 @@ void I_InitSequencer(void) {
     //
     doomseq.gain = 1.0f;
 
-    Seq_SetStatus(&doomseq, SEQ_SIGNAL_READY);
     Seq_SetGain(&doomseq);
     Seq_SetReverb(&doomseq, 0.65f, 0.0f, 2.0f, 1.0f);
 
@@ -1300,12 +1443,25 @@ void I_InitSequencer(void) {
 
     spec.format = AUDIO_S16;
     spec.freq = 44100;
-    spec.samples = 2048;
+    // commands from the game are picked up once per buffer,
+    // so keep it short (about 12 ms)
+    spec.samples = 512;
     spec.channels = 2;
     spec.callback = Audio_Play;
-    spec.userdata = doomseq.synth;
+    spec.userdata = &doomseq;
+
+    if(SDL_OpenAudio(&spec, &obtained) < 0) {
+        CON_Warnf("I_InitSequencer: failed to open audio device\n");
+        Seq_Shutdown(&doomseq);
+        return;
+    }
+
+    doomseq.samples = 0;
+    doomseq.samplerate = obtained.freq;
+
+    // 20120205 villsa - sequencer is now ready
+    seqready = true;
 
-    SDL_OpenAudio(&spec, &obtained);
     SDL_PauseAudio(SDL_FALSE);
 
     log::debug("SDL_OpenAudio settings:");
@@ -1313,9 +1469,6 @@ void I_InitSequencer(void) {
     log::debug("\t freq     (spec: {:<5}, got: {:<5})", spec.freq, obtained.freq);
     log::debug("\t samples  (spec: {:<5}, got: {:<5})", spec.samples, obtained.samples);
     log::debug("\t channels (spec: {:<5}, got: {:<5})", spec.channels, obtained.channels);
-
-    // 20120205 villsa - sequencer is now ready
-    seqready = true;
 }
 
 //
@@ -1337,21 +1490,48 @@ int I_GetVoiceCount(void) {
 //
 // I_GetSoundSource
 //
+// Origin of the sound playing on a channel, from the game
+// side table. NULL if the origin was removed or the entry
+// has since been given to a newer sound
+//
 
 sndsrc_t* I_GetSoundSource(int c) {
-    if(playlist[c].song == NULL) {
+    unsigned serial;
+    seqsource_t* src;
+
+    serial = playserial[c].load(std::memory_order_acquire);
+    if(serial == 0) {
         return NULL;
     }
 
-    return playlist[c].origin;
+    src = &seqsources[serial & (SEQ_SOURCES - 1)];
+    return src->serial == serial ? src->origin : NULL;
 }
 
 //
 // I_RemoveSoundSource
 //
+// Forget an origin, or every origin if NULL. Sounds from it
+// keep playing, but are no longer positioned
+//
+
+void I_RemoveSoundSource(sndsrc_t* origin) {
+    seqcommand_t cmd = {};
+    int i;
+
+    for(i = 0; i < SEQ_SOURCES; i++) {
+        if(!origin || seqsources[i].origin == origin) {
+            seqsources[i].origin = NULL;
+        }
+    }
 
-void I_RemoveSoundSource(int c) {
-    playlist[c].origin = NULL;
+    if(!seqready) {
+        return;
+    }
+
+    cmd.cmd = SEQ_CMD_REMOVEORIGIN;
+    cmd.origin = origin;
+    Seq_PushCommand(&cmd);
 }
 
 //
@@ -1392,6 +1572,34 @@ void I_SetSoundVolume(float volume) {
     doomseq.soundvolume = (volume * 0.925f);
 }
 
+//
+// I_UpdateSound
+//
+// Hand over any commands that did not fit in the queue
+//
+
+void I_UpdateSound(void) {
+    if(!seqready) {
+        return;
+    }
+
+    Seq_FlushBacklog();
+}
+
+//
+// I_GetSequencerStats
+//
+
+void I_GetSequencerStats(seqstats_t* stats) {
+    stats->depth = seqqueuehead.load(std::memory_order_relaxed) -
+                   seqqueuetail.load(std::memory_order_relaxed);
+    stats->peakdepth = seqpeakdepth.load(std::memory_order_relaxed);
+    stats->backlog = seqbacklog.size();
+    stats->commands = seqcommands.load(std::memory_order_relaxed);
+    stats->latency = seqlatency.load(std::memory_order_relaxed);
+    stats->maxlatency = seqmaxlatency.load(std::memory_order_relaxed);
+}
+
 //
 // I_ResetSound
 //
@@ -1401,8 +1609,7 @@ void I_ResetSound(void) {
         return;
     }
 
-    Seq_SetStatus(&doomseq, SEQ_SIGNAL_RESET);
-    //Seq_WaitOnSignal(&doomseq);
+    Seq_SetStatus(&doomseq, SEQ_CMD_RESET);
 }
 
 //
@@ -1414,8 +1621,7 @@ void I_PauseSound(void) {
         return;
     }
 
-    Seq_SetStatus(&doomseq, SEQ_SIGNAL_PAUSE);
-    //Seq_WaitOnSignal(&doomseq);
+    Seq_SetStatus(&doomseq, SEQ_CMD_PAUSE);
 }
 
 //
@@ -1427,8 +1633,7 @@ void I_ResumeSound(void) {
         return;
     }
 
-    Seq_SetStatus(&doomseq, SEQ_SIGNAL_RESUME);
-    //Seq_WaitOnSignal(&doomseq);
+    Seq_SetStatus(&doomseq, SEQ_CMD_RESUME);
 }
 
 //
@@ -1436,14 +1641,15 @@ void I_ResumeSound(void) {
 //
 
 void I_SetGain(float db) {
+    seqcommand_t cmd = {};
+
     if(!seqready) {
         return;
     }
 
-    doomseq.gain = db;
-
-    Seq_SetStatus(&doomseq, SEQ_SIGNAL_SETGAIN);
-    //Seq_WaitOnSignal(&doomseq);
+    cmd.cmd = SEQ_CMD_SETGAIN;
+    cmd.gain = db;
+    Seq_PushCommand(&cmd);
 }
 
 //
@@ -1451,26 +1657,15 @@ void I_SetGain(float db) {
 //
 
 void I_StartMusic(int mus_id) {
-    song_t* song;
-    channel_t* chan;
-    int i;
+    seqcommand_t cmd = {};
 
     if(!seqready) {
         return;
     }
 
-    SEMAPHORE_LOCK()
-    song = &doomseq.songs[mus_id];
-    for(i = 0; i < song->ntracks; i++) {
-        chan = Song_AddTrackToPlaylist(&doomseq, song, &song->tracks[i]);
-
-        if(chan == NULL) {
-            break;
-        }
-
-        chan->volume = doomseq.musicvolume;
-    }
-    SEMAPHORE_UNLOCK()
+    cmd.cmd = SEQ_CMD_STARTMUSIC;
+    cmd.id = mus_id;
+    Seq_PushCommand(&cmd);
 }
 
 //
@@ -1478,24 +1673,16 @@ void I_StartMusic(int mus_id) {
 //
 
 void I_StopSound(sndsrc_t* origin, int sfx_id) {
-    song_t* song;
-    channel_t* c;
-    int i;
+    seqcommand_t cmd = {};
 
     if(!seqready) {
         return;
     }
 
-    SEMAPHORE_LOCK()
-    song = &doomseq.songs[sfx_id];
-    for(i = 0; i < MIDI_CHANNELS; i++) {
-        c = &playlist[i];
-
-        if(song == c->song || (origin && c->origin == origin)) {
-            c->stop = true;
-        }
-    }
-    SEMAPHORE_UNLOCK()
+    cmd.cmd = SEQ_CMD_STOPSOUND;
+    cmd.id = sfx_id;
+    cmd.origin = origin;
+    Seq_PushCommand(&cmd);
 }
 
 //
@@ -1503,9 +1690,7 @@ void I_StopSound(sndsrc_t* origin, int sfx_id) {
 //
 
 void I_StartSound(int sfx_id, sndsrc_t* origin, int volume, int pan, int reverb) {
-    song_t* song;
-    channel_t* chan;
-    int i;
+    seqcommand_t cmd = {};
 
     if(!seqready) {
         return;
@@ -1515,20 +1700,20 @@ void I_StartSound(int sfx_id, sndsrc_t* origin, int volume, int pan, int reverb)
         return;
     }
 
-    SEMAPHORE_LOCK()
-    song = &doomseq.songs[sfx_id];
-    for(i = 0; i < song->ntracks; i++) {
-        chan = Song_AddTrackToPlaylist(&doomseq, song, &song->tracks[i]);
-
-        if(chan == NULL) {
-            break;
-        }
-
-        chan->volume = (float)volume;
-        chan->pan = (byte)(pan >> 1);
-        chan->origin = origin;
-        chan->depth = reverb;
+    // zero means no source
+    if(++seqserial == 0) {
+        seqserial = 1;
     }
-    SEMAPHORE_UNLOCK()
-}
 
+    seqsources[seqserial & (SEQ_SOURCES - 1)].serial = seqserial;
+    seqsources[seqserial & (SEQ_SOURCES - 1)].origin = origin;
+
+    cmd.cmd = SEQ_CMD_STARTSOUND;
+    cmd.id = sfx_id;
+    cmd.origin = origin;
+    cmd.serial = seqserial;
+    cmd.volume = volume;
+    cmd.pan = pan;
+    cmd.reverb = reverb;
+    Seq_PushCommand(&cmd);
+}
@@ -39,6 +39,16 @@ typedef struct {
     fixed_t z;
 } sndsrc_t;
 
+// Sequencer command queue statistics
+typedef struct {
+    int depth;          // commands waiting for the audio thread
+    int peakdepth;      // deepest the queue got during the last second
+    int backlog;        // commands held by the game while the queue was full
+    int commands;       // commands run during the last second
+    int latency;        // average microseconds from queue to run, last second
+    int maxlatency;     // worst latency during the last second
+} seqstats_t;
+
 int I_GetMaxChannels(void);
 int I_GetVoiceCount(void);
 sndsrc_t* I_GetSoundSource(int c);
@@ -46,13 +56,15 @@ sndsrc_t* I_GetSoundSource(int c);
 void I_InitSequencer(void);
 void I_ShutdownSound(void);
 void I_UpdateChannel(int c, int volume, int pan);
-void I_RemoveSoundSource(int c);
+void I_RemoveSoundSource(sndsrc_t* origin);
 void I_SetMusicVolume(float volume);
 void I_SetSoundVolume(float volume);
 void I_ResetSound(void);
 void I_PauseSound(void);
 void I_ResumeSound(void);
 void I_SetGain(float db);
+void I_UpdateSound(void);
+void I_GetSequencerStats(seqstats_t* stats);
 void I_StopSound(sndsrc_t* origin, int sfx_id);
 void I_StartMusic(int mus_id);
 void I_StartSound(int sfx_id, sndsrc_t* origin, int volume, int pan, int reverb);
@@ -31,6 +31,7 @@
 #ifdef _WIN32
 #include <direct.h>
 #include <io.h>
+#include <windows.h>
 #endif
 
 #include <stdarg.h>
@@ -233,6 +234,22 @@ char *I_GetUserFile(const char *file) {
     return path;
 }
 
+/**
+ * @brief Move a file over another, replacing it in one step.
+ *
+ * Readers see either the old or the new file, never a missing one.
+ *
+ * @return true on success.
+ */
+
+dboolean I_ReplaceFile(const char *from, const char *to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
 //
 // I_GetTime
 // returns time in 1/70th second tics
@@ -277,7 +294,10 @@ void I_Init(void) {
     //I_SpawnLauncher(hwndMain);
 #endif
 
-    I_InitVideo();
+    if(!nodrawers) {
+        I_InitVideo();
+    }
+
     I_InitClockRate();
 }
 
@@ -320,7 +340,10 @@ void I_Quit(void) {
         G_CheckDemoStatus();
     }
 
-    M_SaveDefaults();
+    // benchmark runs shouldn't touch the user's config
+    if(!timingdemo) {
+        M_SaveDefaults();
+    }
 
 #ifdef USESYSCONSOLE
     // I_DestroySysConsole();
@@ -86,6 +86,7 @@ void I_BeginRead(void);
 char *I_GetUserDir(void);
 char *I_GetBaseDir(void);
 char *I_GetUserFile(const char *file);
+dboolean I_ReplaceFile(const char *from, const char *to);
 char *I_FindDataFile(const char *file);
 
 dboolean I_FileExists(const char *path);
@@ -54,6 +54,11 @@ void I_InitScreen(void) {
     video_height = mode.height;
     video_ratio = static_cast<float>(video_width) / video_height;
 
+    // don't let vsync pace a timedemo
+    if(timingdemo) {
+        SDL_GL_SetSwapInterval(0);
+    }
+
     // if(M_CheckParm("-window")) {
     //     InWindow = true;
     // }
@@ -118,6 +123,10 @@ void I_InitVideo(void) {
 //
 
 void I_StartTic(void) {
+    if(!Video) {
+        return;
+    }
+
     Video->poll_events();
 }
 
@@ -0,0 +1,134 @@
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "mapped_file.hh"
+
+namespace {
+  bool map_file_(const String& path, const char*& data, size_t& size)
+  {
+#ifdef _WIN32
+      auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (file == INVALID_HANDLE_VALUE)
+          return false;
+
+      LARGE_INTEGER file_size;
+      if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+          CloseHandle(file);
+          return false;
+      }
+
+      auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      CloseHandle(file);
+      if (!mapping)
+          return false;
+
+      // The view keeps a reference to the mapping object, so it can be closed here.
+      auto ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+      if (!ptr)
+          return false;
+
+      data = static_cast<const char*>(ptr);
+      size = static_cast<size_t>(file_size.QuadPart);
+      return true;
+#else
+      auto fd = ::open(path.c_str(), O_RDONLY);
+      if (fd < 0)
+          return false;
+
+      struct stat st;
+      if (fstat(fd, &st) != 0 || st.st_size == 0) {
+          ::close(fd);
+          return false;
+      }
+
+      auto ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (ptr == MAP_FAILED)
+          return false;
+
+      data = static_cast<const char*>(ptr);
+      size = static_cast<size_t>(st.st_size);
+      return true;
+#endif
+  }
+
+  void unmap_file_(const char* data, size_t size)
+  {
+#ifdef _WIN32
+      UnmapViewOfFile(data);
+#else
+      munmap(const_cast<char*>(data), size);
+#endif
+  }
+}
+
+sys::MappedFile::MappedFile(sys::MappedFile&& other)
+{
+    *this = std::move(other);
+}
+
+sys::MappedFile& sys::MappedFile::operator=(sys::MappedFile&& other)
+{
+    if (this == &other)
+        return *this;
+
+    m_close();
+
+    m_mapped = other.m_mapped;
+    m_size = other.m_size;
+    m_buffer = std::move(other.m_buffer);
+    m_data = m_mapped ? other.m_data : m_buffer.data();
+
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_mapped = false;
+
+    return *this;
+}
+
+void sys::MappedFile::m_close()
+{
+    if (m_mapped)
+        unmap_file_(m_data, m_size);
+
+    m_data = nullptr;
+    m_size = 0;
+    m_buffer.clear();
+    m_mapped = false;
+}
+
+bool sys::MappedFile::open(StringView path)
+{
+    m_close();
+
+    auto spath = path.to_string();
+    if (map_file_(spath, m_data, m_size)) {
+        m_mapped = true;
+        return true;
+    }
+
+    // Fall back to reading the whole file. This also handles empty files,
+    // which can't be mapped.
+    std::ifstream file(spath, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file.seekg(0, std::ios::end);
+    m_buffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0, std::ios::beg);
+    file.read(&m_buffer[0], m_buffer.size());
+
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+    return true;
+}
@@ -0,0 +1,72 @@
+// -*- mode: c++ -*-
+#ifndef __MAPPED_FILE__81520374
+#define __MAPPED_FILE__81520374
+
+#include <prelude.hh>
+
+namespace imp {
+  namespace sys {
+    /*!
+     * Read-only view of an entire file.
+     *
+     * The file is memory-mapped where the platform supports it, otherwise it's
+     * read into memory in one go. Either way the view stays valid and immutable
+     * until the object is destroyed, so it can be shared between threads.
+     */
+    class MappedFile {
+        const char* m_data {};
+        size_t m_size {};
+        String m_buffer {};
+        bool m_mapped {};
+
+        void m_close();
+
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other);
+
+        /*!
+         * Opens path for reading
+         * @param path System path to the file
+         */
+        explicit MappedFile(StringView path)
+        { open(path); }
+
+        ~MappedFile()
+        { m_close(); }
+
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile& operator=(MappedFile&& other);
+
+        bool open(StringView path);
+
+        bool is_open() const
+        { return m_data != nullptr; }
+
+        size_t size() const
+        { return m_size; }
+
+        const char* data() const
+        { return m_data; }
+
+        /*!
+         * @return The entire contents of the file
+         */
+        StringView view() const
+        { return { m_data, m_size }; }
+
+        /*!
+         * @return A slice of the file, or an empty view if it's out of bounds
+         */
+        StringView view(size_t offset, size_t size) const
+        {
+            if (offset > m_size || size > m_size - offset)
+                return {};
+            return { m_data + offset, size };
+        }
+    };
+  }
+}
+
+#endif //__MAPPED_FILE__81520374
@@ -40,7 +40,7 @@ namespace {
   static_assert(sizeof(Header) == 64, "N64 ROM header struct must be sizeof 64");
 }
 
-std::istringstream sys::N64Rom::m_load(const sys::N64Loc &loc)
+std::string sys::N64Rom::m_read(const sys::N64Loc &loc)
 {
     assert(m_file.is_open());
     assert(m_rom_version != nullptr);
@@ -57,8 +57,13 @@ std::istringstream sys::N64Rom::m_load(const sys::N64Loc &loc)
         }
     }
 
+    return buf;
+}
+
+std::istringstream sys::N64Rom::m_load(const sys::N64Loc &loc)
+{
     std::istringstream iss;
-    iss.str(buf);
+    iss.str(m_read(loc));
     iss.exceptions(std::ios_base::eofbit | std::ios_base::failbit | std::ios_base::badbit);
     return iss;
 }
@@ -112,6 +117,11 @@ bool sys::N64Rom::open(StringView path)
     return true;
 }
 
+std::string sys::N64Rom::iwad_bytes()
+{
+    return m_read(m_rom_version->iwad);
+}
+
 std::istringstream sys::N64Rom::iwad()
 {
     return m_load(m_rom_version->iwad);
@@ -27,6 +27,7 @@ namespace imp {
         bool m_swapped {};
         const N64Version* m_rom_version {};
 
+        std::string m_read(const N64Loc& loc);
         std::istringstream m_load(const N64Loc& loc);
 
     public:
@@ -61,6 +62,11 @@ namespace imp {
         const std::string& version() const
         { return m_version; }
 
+        /**!
+         * @return The raw IWAD without the stream wrapper
+         */
+        std::string iwad_bytes();
+
         std::istringstream iwad();
         std::istringstream sn64();
         std::istringstream sseq();
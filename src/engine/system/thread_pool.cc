@@ -0,0 +1,84 @@
+#include <easy/profiler.h>
+
+#include "thread_pool.hh"
+
+sys::ThreadPool::ThreadPool(size_t num_threads)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t i {}; i < num_threads; ++i)
+        m_threads.emplace_back(&ThreadPool::m_worker, this, i);
+}
+
+sys::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_task_cond.notify_all();
+
+    for (auto& t : m_threads)
+        t.join();
+}
+
+void sys::ThreadPool::m_worker(size_t id)
+{
+    auto name = fmt::format("Worker {}", id);
+    EASY_THREAD(name.c_str());
+
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_task_cond.wait(lock, [this] { return m_quit || !m_tasks.empty(); });
+
+            if (m_tasks.empty())
+                return;
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            ++m_busy;
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_busy;
+            if (m_busy == 0 && m_tasks.empty())
+                m_idle_cond.notify_all();
+        }
+    }
+}
+
+void sys::ThreadPool::push(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.emplace_back(std::move(task));
+    }
+    m_task_cond.notify_one();
+}
+
+void sys::ThreadPool::m_push_front(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.emplace_front(std::move(task));
+    }
+    m_task_cond.notify_one();
+}
+
+void sys::ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle_cond.wait(lock, [this] { return m_busy == 0 && m_tasks.empty(); });
+}
+
+sys::ThreadPool& sys::ThreadPool::global()
+{
+    static ThreadPool pool;
+    return pool;
+}
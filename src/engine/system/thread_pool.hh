@@ -0,0 +1,148 @@
+// -*- mode: c++ -*-
+#ifndef __THREAD_POOL__20931584
+#define __THREAD_POOL__20931584
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <prelude.hh>
+
+namespace imp {
+  namespace sys {
+    /*!
+     * A fixed set of worker threads that run queued tasks in FIFO order.
+     * Helpers started by for_each go to the front of the queue.
+     */
+    class ThreadPool {
+        Vector<std::thread> m_threads;
+        std::deque<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_task_cond;
+        std::condition_variable m_idle_cond;
+        size_t m_busy {};
+        bool m_quit {};
+
+        void m_worker(size_t id);
+
+        void m_push_front(std::function<void()> task);
+
+    public:
+        /*!
+         * @param num_threads Number of workers. If 0, one per available core.
+         */
+        explicit ThreadPool(size_t num_threads = 0);
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool();
+
+        size_t size() const
+        { return m_threads.size(); }
+
+        /*!
+         * Queue a task to run on one of the workers
+         */
+        void push(std::function<void()> task);
+
+        /*!
+         * Block until the queue is empty and every worker is idle
+         */
+        void wait();
+
+        /*!
+         * Call func(i) for every i in [0, count) using the workers and the
+         * calling thread, and return once all calls have finished.
+         *
+         * The helpers are queued ahead of other tasks. The calling thread
+         * doesn't wait for helpers that haven't started by the time it runs
+         * out of work, so a busy pool can't hold it up.
+         *
+         * If a call throws, no further indices are handed out and the first
+         * exception is rethrown here once every running call has finished.
+         * @note func must be safe to call concurrently
+         * @note Must not be called from one of this pool's own tasks
+         */
+        template <class Func>
+        void for_each(size_t count, Func&& func)
+        {
+            if (count == 0)
+                return;
+
+            struct State {
+                std::atomic<size_t> next { 0 };
+                size_t active {};
+                bool closed {};
+                std::exception_ptr error;
+                std::mutex mutex;
+                std::condition_variable cond;
+
+                void fail(size_t count)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!error)
+                        error = std::current_exception();
+                    next = count;
+                }
+            };
+
+            // Helpers that start late outlive this call, so they share the
+            // state and only touch func while they're counted as active.
+            auto state = std::make_shared<State>();
+            auto funcp = &func;
+
+            auto helpers = std::min(size(), count - 1);
+            for (size_t i {}; i < helpers; ++i) {
+                m_push_front([state, funcp, count] {
+                        {
+                            std::lock_guard<std::mutex> lock(state->mutex);
+                            if (state->closed)
+                                return;
+                            ++state->active;
+                        }
+
+                        try {
+                            size_t i;
+                            while ((i = state->next++) < count)
+                                (*funcp)(i);
+                        } catch (...) {
+                            state->fail(count);
+                        }
+
+                        std::lock_guard<std::mutex> lock(state->mutex);
+                        if (--state->active == 0)
+                            state->cond.notify_all();
+                    });
+            }
+
+            try {
+                size_t i;
+                while ((i = state->next++) < count)
+                    func(i);
+            } catch (...) {
+                state->fail(count);
+            }
+
+            // Every index has been handed out; wait for the ones still running
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->closed = true;
+            state->cond.wait(lock, [&] { return state->active == 0; });
+
+            if (state->error)
+                std::rethrow_exception(state->error);
+        }
+
+        /*!
+         * @return Pool shared by the whole engine
+         */
+        static ThreadPool& global();
+    };
+  }
+}
+
+#endif //__THREAD_POOL__20931584
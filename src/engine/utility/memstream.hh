@@ -0,0 +1,93 @@
+// -*- mode: c++ -*-
+#ifndef __IMP_MEMSTREAM__40617958
+#define __IMP_MEMSTREAM__40617958
+
+#include <istream>
+#include <streambuf>
+#include "string_view.hh"
+
+namespace imp {
+  /**
+   * \brief A read-only streambuf over memory it doesn't own
+   */
+  class MemStreamBuf : public std::streambuf {
+  public:
+      MemStreamBuf() = default;
+
+      MemStreamBuf(const MemStreamBuf&) = default;
+
+      explicit MemStreamBuf(StringView view)
+      {
+          auto p = const_cast<char*>(view.data());
+          setg(p, p, p + view.size());
+      }
+
+      MemStreamBuf& operator=(const MemStreamBuf&) = default;
+
+  protected:
+      pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+      {
+          if (!(which & std::ios_base::in))
+              return pos_type(off_type(-1));
+
+          off_type pos {};
+          switch (dir) {
+          case std::ios_base::beg:
+              pos = off;
+              break;
+
+          case std::ios_base::cur:
+              pos = gptr() - eback() + off;
+              break;
+
+          case std::ios_base::end:
+              pos = egptr() - eback() + off;
+              break;
+
+          default:
+              return pos_type(off_type(-1));
+          }
+
+          if (pos < 0 || pos > egptr() - eback())
+              return pos_type(off_type(-1));
+
+          setg(eback(), eback() + pos, egptr());
+          return pos_type(pos);
+      }
+
+      pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+      { return seekoff(off_type(pos), std::ios_base::beg, which); }
+  };
+
+  /**
+   * \brief An istream that reads directly from memory it doesn't own
+   *
+   * Unlike std::istringstream, the data isn't copied. The memory must outlive
+   * the stream.
+   */
+  class IMemStream : public std::istream {
+      StringView view_;
+      MemStreamBuf buf_;
+
+  public:
+      explicit IMemStream(StringView view):
+          std::istream(nullptr),
+          view_(view),
+          buf_(view)
+      { rdbuf(&buf_); }
+
+      IMemStream(IMemStream&& other):
+          std::istream(std::move(other)),
+          view_(other.view_),
+          buf_(other.buf_)
+      { set_rdbuf(&buf_); }
+
+      /*!
+       * @return The entire underlying memory
+       */
+      StringView view() const
+      { return view_; }
+  };
+}
+
+#endif //__IMP_MEMSTREAM__40617958
@@ -1,4 +1,5 @@
 #include <map>
+#include <unordered_map>
 #include <platform/app.hh>
 #include <imp/Image>
 #include <algorithm>
@@ -15,6 +16,24 @@ namespace {
 
   Array<Vector<ILumpPtr>, num_sections> section_lumps_;
 
+  /* Lookup tables built by wad::merge() */
+  struct LumpRef {
+      size_t section;
+      size_t offset;
+  };
+
+  template <class Key, class T, class Hash = boost::hash<Key>>
+  using HashMap = std::unordered_map<Key, T, Hash>;
+
+  // section_index -> offset into section_lumps_
+  Array<Vector<size_t>, num_sections> section_index_table_;
+
+  // lump_index -> section and offset into section_lumps_
+  Vector<LumpRef> lump_index_table_;
+
+  // lump name -> offset into section_lumps_
+  Array<HashMap<String, size_t>, num_sections> name_table_;
+
   app::StringParam iwad_path_("iwad");
 }
 
@@ -61,19 +80,32 @@ bool wad::add_device_loader(IDeviceLoader& device_loader)
 
 void wad::merge()
 {
+    lump_index_table_.clear();
+
     // Use a stable sort to allow multiple versions of the same lumps.
     size_t lump_index {};
     for (size_t i {}; i < num_sections; ++i) {
         auto& lumps = section_lumps_[i];
         std::stable_sort(lumps.begin(), lumps.end(), [](const ILumpPtr& a, const ILumpPtr& b) { return a->name() < b->name(); });
 
+        auto& index_table = section_index_table_[i];
+        auto& name_table = name_table_[i];
+        index_table.clear();
+        name_table.clear();
+        name_table.reserve(lumps.size());
+
         size_t section_index {};
         ILump *prev_lump{};
-        for (auto &l : lumps) {
+        for (size_t offset {}; offset < lumps.size(); ++offset) {
+            auto& l = lumps[offset];
             if (!prev_lump || prev_lump->name() != l->name()) {
                 l->set_section_index(section_index++);
                 l->set_lump_index(lump_index++);
                 prev_lump = l.get();
+
+                index_table.push_back(offset);
+                lump_index_table_.push_back({ i, offset });
+                name_table.emplace(l->name(), offset);
             } else {
                 l->set_section_index(prev_lump->section_index());
                 l->set_lump_index(prev_lump->lump_index());
@@ -88,6 +120,15 @@ Optional<Lump> wad::open(Section section, StringView name)
 {
     auto& lumps = section_lumps_[static_cast<size_t>(section)];
 
+    if (!dirty_) {
+        auto& name_table = name_table_[static_cast<size_t>(section)];
+        auto it = name_table.find(name.to_string());
+        if (it == name_table.end())
+            return nullopt;
+
+        return make_optional<Lump>(it->second, *lumps[it->second]);
+    }
+
     auto it = std::lower_bound(lumps.begin(), lumps.end(), name,
                                [](const ILumpPtr& a, const StringView& b) {
                                    return a->name() < b;
@@ -104,34 +145,23 @@ Optional<Lump> wad::open(Section section, size_t index)
 {
     assert(!dirty_);
 
-    auto& lumps = section_lumps_[static_cast<size_t>(section)];
-
-    for (auto& lump : lumps) {
-        if (lump->section_index() == index) {
-            auto offset = std::distance(lumps.data(), &lump);
-            return make_optional<Lump>(offset, *lump);
-        }
-    }
+    auto& index_table = section_index_table_[static_cast<size_t>(section)];
+    if (index >= index_table.size())
+        return nullopt;
 
-    return nullopt;
+    auto offset = index_table[index];
+    return make_optional<Lump>(offset, *section_lumps_[static_cast<size_t>(section)][offset]);
 }
 
 Optional<Lump> wad::open(size_t index)
 {
     assert(!dirty_);
 
-    for (size_t i {}; i < num_sections; ++i) {
-        auto &lumps = section_lumps_[i];
-
-        for (auto &lump : lumps) {
-            if (lump->lump_index() == index) {
-                auto offset = std::distance(lumps.data(), &lump);
-                return make_optional<Lump>(offset, *lump);
-            }
-        }
-    }
+    if (index >= lump_index_table_.size())
+        return nullopt;
 
-    return nullopt;
+    auto& ref = lump_index_table_[index];
+    return make_optional<Lump>(ref.offset, *section_lumps_[ref.section][ref.offset]);
 }
 
 ArrayView<ILumpPtr> wad::list_section(wad::Section section)
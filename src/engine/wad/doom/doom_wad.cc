@@ -1,5 +1,6 @@
 #include <fstream>
-#include <sstream>
+#include <system/mapped_file.hh>
+#include <utility/memstream.hh>
 #include "../idevice.hh"
 #include "../wad_loaders.hh"
 
@@ -57,17 +58,20 @@ namespace {
 
       UniquePtr<std::istream> stream() override;
 
+      StringView read_view() override;
+
       IDevice& device() override;
   };
 
   class DoomDevice : public IDevice {
-      std::ifstream stream_;
+      sys::MappedFile file_;
 
   public:
       DoomDevice(StringView path):
-          stream_(path.to_string(), std::ios::binary)
+          file_(path)
       {
-          stream_.exceptions(stream_.failbit | stream_.badbit);
+          if (!file_.is_open())
+              throw std::runtime_error(fmt::format("Could not open '{}'", path));
       }
 
       Vector<ILumpPtr> read_all() override
@@ -75,14 +79,17 @@ namespace {
           Vector<ILumpPtr> lumps;
           Section section {};
           Header header;
-          read_into(stream_, header);
 
-          stream_.seekg(header.infotableofs);
+          IMemStream stream { file_.view() };
+          stream.exceptions(stream.failbit | stream.badbit);
+          read_into(stream, header);
+
+          stream.seekg(header.infotableofs);
           size_t numlumps = header.numlumps;
 
           for (size_t i = 0; i < numlumps; ++i) {
               Directory dir;
-              read_into(stream_, dir);
+              read_into(stream, dir);
 
               std::size_t size {};
               while (size < 8 && dir.name[size]) ++size;
@@ -124,24 +131,26 @@ namespace {
           return lumps;
       }
 
-      std::istream& stream()
-      { return stream_; }
+      const sys::MappedFile& file() const
+      { return file_; }
   };
 }
 
 UniquePtr<std::istream> DoomLump::stream()
 {
-    auto iss = std::make_unique<std::istringstream>();
-
-    if (info_.size) {
-        auto& s = device_.stream();
-        s.seekg(info_.filepos);
-        String buff(info_.size, 0);
-        s.read(&buff[0], info_.size);
-        iss->str(buff);
-    }
+    return std::make_unique<IMemStream>(read_view());
+}
+
+StringView DoomLump::read_view()
+{
+    if (!info_.size)
+        return {};
+
+    auto view = device_.file().view(info_.filepos, info_.size);
+    if (view.empty())
+        throw std::runtime_error(fmt::format("Lump '{}' is outside of the WAD", info_.name));
 
-    return iss;
+    return view;
 }
 
 IDevice& DoomLump::device()
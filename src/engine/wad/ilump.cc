@@ -1,44 +1,67 @@
 #include <imp/Image>
 #include "ilump.hh"
 #include <utility/convert.hh>
+#include <utility/memstream.hh>
 
 using namespace imp::wad;
 
-String ILump::read_bytes()
+StringView ILump::read_view()
 {
-    auto is = stream();
-    is->seekg(0, is->end);
-    auto pos = is->tellg();
-    is->seekg(0, is->beg);
-    auto size = to_size(is->tellg() - pos);
+    return p_cache([this] {
+            auto is = stream();
+            is->seekg(0, is->end);
+            auto size = to_size(static_cast<std::streamoff>(is->tellg()));
+            is->seekg(0, is->beg);
 
-    String bytes(size, '\0');
-    is->read(&bytes[0], size);
+            String bytes(size, '\0');
+            is->read(&bytes[0], size);
+            return bytes;
+        });
+}
 
-    return bytes;
+String ILump::read_bytes()
+{
+    return read_view().to_string();
 }
 
 char* ILump::read_bytes_ccompat(size_t *size_out = nullptr)
 {
-    auto is = stream();
-    is->seekg(0, is->end);
-    auto end_pos = is->tellg();
-    is->seekg(0, is->beg);
-    auto size = to_size(end_pos - is->tellg());
+    auto view = read_view();
 
-    auto bytes = new char[size];
-    is->read(&bytes[0], size);
+    auto bytes = new char[view.size()];
+    std::copy(view.begin(), view.end(), bytes);
 
     if (size_out)
-        *size_out = size;
+        *size_out = view.size();
 
     return bytes;
 }
 
 Optional<Image> ILump::read_image()
 {
-    auto is = stream();
-    return make_optional<Image>(*is);
+    IMemStream is { read_view() };
+    return make_optional<Image>(is);
+}
+
+bool ILump::read_image_size(uint16& width, uint16& height)
+{
+    auto view = read_view();
+
+    // PNG keeps the size in the IHDR chunk, which always comes first
+    if (view.size() >= 24 && view.substr(0, 8) == StringView("\x89PNG\r\n\x1a\n", 8)) {
+        auto p = reinterpret_cast<const uint8*>(view.data());
+        width = static_cast<uint16>(p[18] << 8 | p[19]);
+        height = static_cast<uint16>(p[22] << 8 | p[23]);
+        return true;
+    }
+
+    auto image = read_image();
+    if (!image)
+        return false;
+
+    width = image->width();
+    height = image->height();
+    return true;
 }
 
 Optional<Palette> ILump::read_palette()
@@ -1,6 +1,7 @@
 #ifndef __ILUMP__55802067
 #define __ILUMP__55802067
 
+#include <mutex>
 #include <prelude.hh>
 #include "section.hh"
 
@@ -14,6 +15,22 @@ namespace imp {
     class ILump {
         size_t section_index_ {};
         size_t lump_index_ {};
+        std::once_flag cache_flag_ {};
+        String cache_ {};
+
+    protected:
+        /*!
+         * Decode the lump once and keep the result around for read_view()
+         * @param decode Callable returning the lump contents as a String
+         * @return View of the cached contents
+         */
+        template <class Decoder>
+        StringView p_cache(Decoder&& decode)
+        {
+            std::call_once(cache_flag_, [&] { cache_ = decode(); });
+            return cache_;
+        }
+
     public:
         virtual ~ILump() {}
 
@@ -48,6 +65,15 @@ namespace imp {
          */
         virtual UniquePtr<std::istream> stream() = 0;
 
+        /*!
+         * Get a read-only view of the lump's contents. The view is either
+         * backed directly by the device's file mapping or by a decoded copy
+         * that's cached in the lump, so it's valid for the lifetime of the
+         * lump and safe to read from multiple threads.
+         * @return View of the entire lump
+         */
+        virtual StringView read_view();
+
         /*!
          * Interpret the lump as raw bytes.
          * @return The entire contents of the lump as a byte string
@@ -68,6 +94,13 @@ namespace imp {
          */
         virtual Optional<Image> read_image();
 
+        /*!
+         * Get the dimensions of the image without decoding all of it.
+         * Can be overriden by device to support custom image types
+         * @return false if the lump isn't an image
+         */
+        virtual bool read_image_size(uint16& width, uint16& height);
+
         /*!
          * Interpret the lump as a palette.
          * Can be overriden by device to support custom palette types
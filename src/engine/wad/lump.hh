@@ -87,6 +87,13 @@ namespace imp {
             return *m_stream;
         }
 
+        /*!
+         * Get a read-only view of the lump's contents
+         * @return View valid for the lifetime of the lump's device
+         */
+        StringView read_view()
+        { return m_context->read_view(); }
+
         /*!
          * Interpret the lump as raw bytes
          * @return
@@ -124,6 +131,13 @@ namespace imp {
          */
         Optional<Image> read_image();
 
+        /*!
+         * Get the dimensions of the image without decoding all of it
+         * @return false if the lump isn't an image
+         */
+        bool read_image_size(uint16& width, uint16& height)
+        { return m_context->read_image_size(width, height); }
+
         /*!
          * Interpret the lump as a palette.
          * @return An optional palette object
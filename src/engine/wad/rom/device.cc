@@ -1,14 +1,19 @@
+#include <cstdio>
 #include <fstream>
-#include <sstream>
 #include <utility>
 #include <algorithm>
+#include <unordered_map>
 #include <imp/detail/Image.hh>
 #include <set>
 #include <easy/profiler.h>
 #include <utility/endian.hh>
+#include <platform/app.hh>
+#include <common/md5.h>
 #include "rom_private.hh"
 #include "../wad_loaders.hh"
 #include <system/n64_rom.hh>
+#include <system/mapped_file.hh>
+#include <system/thread_pool.hh>
 
 using namespace imp::wad;
 
@@ -16,6 +21,8 @@ Vector<String> rom_textures;
 std::set<String> rom_weapon_sprites;
 
 std::string get_midi(size_t midi);
+char* I_GetUserFile(const char* file);
+dboolean I_ReplaceFile(const char* from, const char* to);
 namespace {
   template<class T>
   void read_into(std::istream &s, T &x) {
@@ -34,6 +41,38 @@ namespace {
       char name[8];
   };
 
+  /*
+    Decompressed lumps are cached in the user directory, so that they don't
+    have to be decoded again on the next start. The cache is keyed by the MD5
+    of the IWAD inside the ROM. Bump cache_version_ whenever the decoders
+    change their output.
+
+    A directory of prebuilt caches can be given with -romcachedir, e.g. on a
+    read-only install. A valid cache found there is used as is, otherwise we
+    fall back to the one in the user directory.
+  */
+  constexpr uint32 cache_version_ = 1;
+
+  struct CacheHeader {
+      char id[4];
+      uint32 version;
+      uint8 md5[16];
+      uint32 numlumps;
+  };
+
+  struct CacheDir {
+      uint32 dirpos; /**< Position of the lump's WadDir in the IWAD */
+      uint32 filepos;
+      uint32 size;
+      char name[8];
+  };
+
+  static_assert(sizeof(CacheHeader) == 28, "ROM cache header must have a sizeof of 28 bytes");
+  static_assert(sizeof(CacheDir) == 20, "ROM cache directory must have a sizeof of 20 bytes");
+
+  app::BoolParam no_rom_cache_param_("noromcache");
+  app::StringParam rom_cache_dir_param_("romcachedir");
+
   /*
     Graphics lumps aren't located in the graphics directory, so we have to
     manually put them there.
@@ -103,20 +142,225 @@ namespace {
 }
 
 class imp::wad::rom::Device : public IDevice {
-    std::istringstream rom_ {};
+    String iwad_ {};
     WadHeader wad_header_ {};
     String palette_name {};
 
-public:
-    Device(std::istringstream&& iwad):
-        rom_(std::move(iwad))
+    /* Decompressed lumps, either mapped from the cache file or kept in
+     * memory if the cache couldn't be written */
+    sys::MappedFile cache_file_ {};
+    Vector<String> cache_memory_ {};
+    std::unordered_map<std::streamoff, StringView> cache_ {};
+    md5_digest_t iwad_md5_ {};
+
+    String cache_name_()
     {
-        rom_.exceptions(rom_.failbit | rom_.badbit);
-        read_into(rom_, wad_header_);
+        md5_context_t ctx;
+        MD5_Init(&ctx);
+        MD5_Update(&ctx, reinterpret_cast<const byte*>(iwad_.data()), static_cast<unsigned>(iwad_.size()));
+        MD5_Final(iwad_md5_, &ctx);
+
+        String name = "rom-";
+        for (auto c : iwad_md5_)
+            name += fmt::format("{:02x}", c);
+        name += ".cache";
+        return name;
+    }
+
+    String user_cache_path_(const String& name)
+    {
+        auto path = I_GetUserFile(name.c_str());
+        if (!path)
+            return {};
+
+        String retval = path;
+        free(path);
+        return retval;
+    }
+
+    String prebuilt_cache_path_(const String& name)
+    {
+        if (!rom_cache_dir_param_)
+            return {};
+
+        String dir = rom_cache_dir_param_.get();
+        if (dir.empty())
+            return {};
+
+        if (dir.back() != '/' && dir.back() != '\\')
+            dir += '/';
+
+        return dir + name;
+    }
+
+    /*! Map the cache file and check that it belongs to this IWAD */
+    bool map_cache_(const String& path, const Vector<Info>& infos)
+    {
+        sys::MappedFile file;
+        if (!file.open(path))
+            return false;
+
+        CacheHeader header;
+        auto header_view = file.view(0, sizeof(header));
+        if (header_view.size() != sizeof(header))
+            return false;
+        memcpy(&header, header_view.data(), sizeof(header));
+
+        if (memcmp(header.id, "D64C", 4) != 0 || header.version != cache_version_)
+            return false;
+
+        if (memcmp(header.md5, iwad_md5_, sizeof(iwad_md5_)) != 0)
+            return false;
+
+        auto dir_view = file.view(sizeof(header), header.numlumps * sizeof(CacheDir));
+        if (dir_view.size() != header.numlumps * sizeof(CacheDir))
+            return false;
+
+        std::unordered_map<std::streamoff, StringView> cache;
+        for (size_t i {}; i < header.numlumps; ++i) {
+            CacheDir dir;
+            memcpy(&dir, dir_view.data() + i * sizeof(dir), sizeof(dir));
+
+            auto data = file.view(dir.filepos, dir.size);
+            if (data.size() != dir.size)
+                return false;
+
+            cache.emplace(dir.dirpos, data);
+        }
+
+        // Every compressed lump must be accounted for
+        for (const auto& info : infos) {
+            bool compressed {};
+            raw(info, compressed);
+            if (compressed && !cache.count(static_cast<std::streamoff>(info.pos)))
+                return false;
+        }
+
+        cache_file_ = std::move(file);
+        cache_ = std::move(cache);
+        return true;
+    }
+
+    /*! Decompress every compressed lump and write them to the cache file */
+    void build_cache_(const String& path, const Vector<Info>& infos)
+    {
+        EASY_FUNCTION(profiler::colors::Green);
+
+        Vector<CacheDir> dirs;
+        Vector<std::pair<const Info*, StringView>> jobs;
+        for (const auto& info : infos) {
+            bool compressed {};
+            auto data = raw(info, compressed);
+            if (!compressed)
+                continue;
 
-        if (memcmp(wad_header_.id, "IWAD", 4) != 0) {
+            CacheDir dir {};
+            dir.dirpos = static_cast<uint32>(static_cast<std::streamoff>(info.pos));
+            std::copy_n(info.name.begin(), std::min<size_t>(info.name.size(), 8), dir.name);
+
+            jobs.emplace_back(&info, data);
+            dirs.push_back(dir);
+        }
+
+        // Every compressed lump is independent, so decode them in parallel.
+        // Each result goes into its own slot, so the order stays the same.
+        cache_memory_.resize(jobs.size());
+        sys::ThreadPool::global().for_each(jobs.size(), [&](size_t i) {
+                EASY_BLOCK("Decode ROM lump", profiler::colors::Green50);
+                cache_memory_[i] = decompress(*jobs[i].first, jobs[i].second);
+            });
+
+        uint32 filepos = sizeof(CacheHeader) + dirs.size() * sizeof(CacheDir);
+        for (size_t i {}; i < dirs.size(); ++i) {
+            dirs[i].filepos = filepos;
+            dirs[i].size = static_cast<uint32>(cache_memory_[i].size());
+            filepos += dirs[i].size;
+        }
+
+        auto write = [&] {
+            if (path.empty())
+                return false;
+
+            // Write to a temporary file first, so that a partially written
+            // cache is never picked up.
+            auto tmp_path = path + ".tmp";
+            {
+                std::ofstream f(tmp_path, std::ios::binary);
+                if (!f.is_open())
+                    return false;
+
+                CacheHeader header {};
+                memcpy(header.id, "D64C", 4);
+                header.version = cache_version_;
+                header.numlumps = static_cast<uint32>(dirs.size());
+                memcpy(header.md5, iwad_md5_, sizeof(iwad_md5_));
+
+                f.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                f.write(reinterpret_cast<const char*>(dirs.data()), dirs.size() * sizeof(CacheDir));
+                for (const auto& data : cache_memory_)
+                    f.write(data.data(), data.size());
+
+                if (!f.good())
+                    return false;
+            }
+
+            if (!I_ReplaceFile(tmp_path.c_str(), path.c_str())) {
+                std::remove(tmp_path.c_str());
+                return false;
+            }
+
+            return true;
+        };
+
+        if (write() && map_cache_(path, infos)) {
+            log::info("Wrote ROM cache to '{}'", path);
+            cache_memory_.clear();
+            return;
+        }
+
+        log::warn("Couldn't write ROM cache to '{}'", path);
+        for (size_t i {}; i < dirs.size(); ++i)
+            cache_.emplace(dirs[i].dirpos, cache_memory_[i]);
+    }
+
+    /*! Use the cache if it's valid, otherwise build it */
+    void load_cache_(const Vector<Info>& infos)
+    {
+        EASY_FUNCTION(profiler::colors::Green);
+
+        if (no_rom_cache_param_)
+            return;
+
+        auto name = cache_name_();
+
+        auto prebuilt_path = prebuilt_cache_path_(name);
+        if (!prebuilt_path.empty()) {
+            if (map_cache_(prebuilt_path, infos)) {
+                log::info("Using prebuilt ROM cache '{}'", prebuilt_path);
+                return;
+            }
+
+            log::warn("No valid ROM cache at '{}'", prebuilt_path);
+        }
+
+        auto path = user_cache_path_(name);
+        if (!path.empty() && map_cache_(path, infos)) {
+            log::info("Using ROM cache '{}'", path);
+            return;
+        }
+
+        build_cache_(path, infos);
+    }
+
+public:
+    Device(String&& iwad):
+        iwad_(std::move(iwad))
+    {
+        if (iwad_.size() < sizeof(wad_header_) || memcmp(iwad_.data(), "IWAD", 4) != 0) {
             log::fatal("Not an IWAD");
         }
+
+        memcpy(&wad_header_, iwad_.data(), sizeof(wad_header_));
     }
 
     Vector<ILumpPtr> read_all() override
@@ -138,6 +382,9 @@ public:
         SharedPtr<Palette> sprite_pal {};
 
         SpriteLump* sprite_lump_ptr {};
+        Vector<Info> infos {};
+        IMemStream rom_ { iwad_ };
+        rom_.exceptions(rom_.failbit | rom_.badbit);
         rom_.seekg(wad_header_.infotableofs);
         for (std::size_t i = 0; i < wad_header_.numlumps; ++i) {
             auto lump_pos = static_cast<std::streampos>(rom_.tellg());
@@ -250,6 +497,7 @@ public:
             }
 
             lumps.emplace_back(std::move(lump_ptr));
+            infos.push_back(lump_info);
             section = section1;
             format = format1;
 
@@ -267,62 +515,83 @@ public:
             lumps.emplace_back(std::move(lump_ptr));
         }
 
+        load_cache_(infos);
+
         return lumps;
     }
 
-    /*! Load a lump's data at a given position */
-    std::istringstream load(Info info)
+    /*!
+     * Get a view of a lump's raw data at a given position
+     * @param compressed Set to whether the data needs to be decompressed
+     */
+    StringView raw(const Info& info, bool& compressed) const
     {
-        std::istringstream iss, raw;
-        rom_.seekg(info.pos);
-
         WadDir dir;
-        read_into(rom_, dir);
-
-        {
-            String rawstr;
-            rawstr.resize(dir.size);
-            rom_.seekg(static_cast<std::streamoff>(dir.filepos));
-            rom_.read(&rawstr[0], dir.size);
-            raw.str(std::move(rawstr));
-        }
+        auto pos = static_cast<size_t>(static_cast<std::streamoff>(info.pos));
+        if (pos + sizeof(dir) > iwad_.size())
+            throw std::runtime_error(fmt::format("Lump '{}' is outside of the IWAD", info.name));
+        memcpy(&dir, iwad_.data() + pos, sizeof(dir));
+
+        if (dir.filepos > iwad_.size() || dir.size > iwad_.size() - dir.filepos)
+            throw std::runtime_error(fmt::format("Lump '{}' is outside of the IWAD", info.name));
+
+        // If the sign bit of the first char is set (ie. it's negative),
+        // then the lump is compressed.
+        compressed = dir.name[0] < 0;
+        return { iwad_.data() + dir.filepos, dir.size };
+    }
 
-        if (dir.name[0] < 0) {
-            // If the sign bit of the first char is set (ie. it's negative),
-            // then the lump is compressed.
-            if (info.section == Section::textures || info.name.substr(0, 3) == "MAP") {
-                iss.str(deflate(raw));
-            } else {
-                auto data = lzss(raw);
+    /*! Get a lump's decompressed data from the cache */
+    Optional<StringView> cached(const Info& info) const
+    {
+        auto it = cache_.find(static_cast<std::streamoff>(info.pos));
+        if (it == cache_.end())
+            return nullopt;
+        return it->second;
+    }
 
-                if (info.hack == Hack::cloud) {
-                    /*
-                     * CLOUD lump has an invalid header, but is otherwise an 8bpp
-                     * image with Rgba5551 palette just like the other Graphics
-                     * images.
-                     */
+    /*! Decompress a lump's raw data */
+    String decompress(const Info& info, StringView raw) const
+    {
+        IMemStream raw_stream { raw };
 
-                    /* word 0: compression (0xffff is -1) */
-                    /* word 1: unused (zeroes) */
-                    /* word 2: width 64px (big endian 0x40) */
-                    /* word 3: height 64px (big endian 0x40) */
+        if (info.section == Section::textures || info.name.substr(0, 3) == "MAP") {
+            return deflate(raw_stream);
+        }
 
-                    data.replace(0, 8, "\xff\xff\0\0\0\x40\0\x40"s);
-                }
+        auto data = lzss(raw_stream);
 
-                iss.str(data);
-            }
-        } else {
-            iss = std::move(raw);
+        if (info.hack == Hack::cloud) {
+            /*
+             * CLOUD lump has an invalid header, but is otherwise an 8bpp
+             * image with Rgba5551 palette just like the other Graphics
+             * images.
+             */
+
+            /* word 0: compression (0xffff is -1) */
+            /* word 1: unused (zeroes) */
+            /* word 2: width 64px (big endian 0x40) */
+            /* word 3: height 64px (big endian 0x40) */
+
+            data.replace(0, 8, "\xff\xff\0\0\0\x40\0\x40"s);
         }
 
-        return iss;
+        return data;
     }
 };
 
-std::istringstream wad::rom::Lump::p_stream()
+StringView wad::rom::Lump::read_view()
 {
-    return device_.load(info_);
+    if (auto data = device_.cached(info_))
+        return *data;
+
+    bool compressed {};
+    auto raw = device_.raw(info_, compressed);
+
+    if (!compressed)
+        return raw;
+
+    return p_cache([&] { return device_.decompress(info_, raw); });
 }
 
 IDevice& wad::rom::Lump::device()
@@ -341,5 +610,5 @@ IDevicePtr wad::rom_loader(StringView path)
     if (!rom.is_open())
         return nullptr;
 
-    return std::make_unique<rom::Device>(rom.iwad());
+    return std::make_unique<rom::Device>(rom.iwad_bytes());
 }
@@ -57,7 +57,7 @@ Optional<Palette> wad::rom::PaletteLump::read_palette()
 {
     auto s = p_stream();
     s.ignore(8);
-    log::debug("{} size = {}", name(), s.str().size());
+    log::debug("{} size = {}", name(), s.view().size());
     auto pal = wad::rom::read_n64palette(s, 256);
     return boost::make_optional<Palette>(std::move(pal));
 }
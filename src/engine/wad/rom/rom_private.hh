@@ -28,6 +28,7 @@
 
 #include <wad.hh>
 #include <imp/Image>
+#include <utility/memstream.hh>
 
 namespace imp {
   namespace wad {
@@ -61,7 +62,8 @@ namespace imp {
           Info info_;
 
       protected:
-          std::istringstream p_stream();
+          IMemStream p_stream()
+          { return IMemStream { read_view() }; }
 
           const Info& info() const
           { return info_; }
@@ -74,6 +76,8 @@ namespace imp {
           UniquePtr<std::istream> stream() override
           { throw std::logic_error(fmt::format("rom::Lump::stream() Not implemented for '{}'", info_.name)); }
 
+          StringView read_view() override;
+
           IDevice& device() override;
 
           String name() const override
@@ -90,6 +94,7 @@ namespace imp {
       public:
           using Lump::Lump;
           Optional<Image> read_image() override;
+          bool read_image_size(uint16& width, uint16& height) override;
       };
 
       class SpriteLump : public Lump {
@@ -130,6 +135,9 @@ namespace imp {
               track_(track) {}
 
           UniquePtr<std::istream> stream() override;
+
+          StringView read_view() override
+          { return ILump::read_view(); }
       };
 
       class NormalLump : public Lump {
@@ -137,7 +145,7 @@ namespace imp {
           using Lump::Lump;
 
           UniquePtr<std::istream> stream() override
-          { return std::make_unique<std::istringstream>(p_stream()); }
+          { return std::make_unique<IMemStream>(p_stream()); }
       };
 
       Rgba5551Palette read_n64palette(std::istream &s, size_t count);
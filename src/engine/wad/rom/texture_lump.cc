@@ -37,6 +37,19 @@ namespace {
   };
 }
 
+bool TextureLump::read_image_size(uint16& width, uint16& height)
+{
+    auto s = this->p_stream();
+
+    Header header;
+    if (!s.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+
+    width = static_cast<uint16>(1 << big_endian(header.wshift));
+    height = static_cast<uint16>(1 << big_endian(header.hshift));
+    return true;
+}
+
 Optional<Image> TextureLump::read_image()
 {
     auto s = this->p_stream();
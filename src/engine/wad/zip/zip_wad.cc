@@ -2,9 +2,9 @@
  * Incorporated from Eternity engine's w_zip.cpp
  */
 
-#include <fstream>
-#include <sstream>
 #include <zlib.h>
+#include <system/mapped_file.hh>
+#include <utility/memstream.hh>
 
 #include "wad/idevice.hh"
 #include "wad/wad_loaders.hh"
@@ -155,35 +155,39 @@ namespace {
       IDevice& device() override;
 
       UniquePtr<std::istream> stream() override;
+
+      StringView read_view() override;
   };
 
   class ZipDevice : public IDevice {
-      std::ifstream stream_;
+      sys::MappedFile file_;
       size_t central_dir_pos_ {};
 
   public:
-      explicit ZipDevice(std::ifstream&& stream):
-          stream_(std::move(stream)) {}
+      explicit ZipDevice(sys::MappedFile&& file):
+          file_(std::move(file)) {}
 
       Vector<ILumpPtr> read_all() override
       {
-          _find_first_central_dir(stream_);
-          central_dir_pos_ = static_cast<size_t>(stream_.tellg());
+          IMemStream stream { file_.view() };
+          stream.exceptions(stream.badbit | stream.failbit);
+          _find_first_central_dir(stream);
+          central_dir_pos_ = static_cast<size_t>(stream.tellg());
           Vector<ILumpPtr> lumps;
 
-          while (!stream_.eof()) {
+          while (!stream.eof()) {
               char sig[4];
-              stream_.read(sig, 4);
+              stream.read(sig, 4);
 
               if (memcmp(sig, _central_dir_sig, 4) == 0) {
                   CentralDirEntry entry;
-                  read_into(stream_, entry);
+                  read_into(stream, entry);
 
                   String filename(entry.name_length, 0);
-                  stream_.read(&filename[0], entry.name_length);
+                  stream.read(&filename[0], entry.name_length);
 
                   // We don't care about no comments.
-                  stream_.seekg(entry.comment_length + entry.extra_length, std::ios::cur);
+                  stream.seekg(entry.comment_length + entry.extra_length, std::ios::cur);
 
                   if (entry.method != 0 && entry.method != 8) {
                       log::error("Unsupported compression method for '{}'", filename);
@@ -227,8 +231,8 @@ namespace {
           return lumps;
       }
 
-      std::istream& stream()
-      { return stream_; }
+      const sys::MappedFile& file() const
+      { return file_; }
   };
 }
 
@@ -237,60 +241,78 @@ IDevice& ZipLump::device()
 
 UniquePtr<std::istream> ZipLump::stream()
 {
-        auto& s = device_.stream();
-
-        // Check file signature
-        char sig[4];
-        s.seekg(info_.filepos);
-        s.read(sig, 4);
-        if (memcmp(sig, _local_file_sig, 4) != 0)
-            throw std::runtime_error("Not a LocalFileHeader");
-
-        LocalFileHeader header {};
-        read_into(s, header);
-
-        s.seekg(header.name_length + header.extra_length, std::ios::cur);
-
-        String bytes(header.uncompressed, 0);
-        z_stream zs {};
-        char buffer[32] {};
-
-        inflateInit2(&zs, -MAX_WBITS);
-        zs.next_out = reinterpret_cast<Bytef*>(&bytes[0]);
-        zs.avail_out = header.uncompressed;
-
-        int code {};
-        do {
-            if (zs.avail_in == 0) {
-                s.read(buffer, sizeof(buffer));
-                zs.next_in = reinterpret_cast<Bytef*>(buffer);
-                zs.avail_in = sizeof(buffer);
-            }
-            code = inflate(&zs, Z_SYNC_FLUSH);
-        } while(code == Z_OK && zs.avail_out);
-
-        inflateEnd(&zs);
-
-        if (code != Z_OK && code != Z_STREAM_END)
-            throw std::runtime_error("invalid inflate stream");
-
-        if (zs.avail_out != 0)
-            throw std::runtime_error("truncated deflate stream");
+    return std::make_unique<IMemStream>(read_view());
+}
 
-        return std::make_unique<std::istringstream>(std::move(bytes));
+StringView ZipLump::read_view()
+{
+    auto& file = device_.file();
+
+    // Check file signature
+    auto sig = file.view(info_.filepos, 4);
+    if (sig.size() != 4 || memcmp(sig.data(), _local_file_sig, 4) != 0)
+        throw std::runtime_error("Not a LocalFileHeader");
+
+    LocalFileHeader header {};
+    auto header_view = file.view(info_.filepos + 4, sizeof(header));
+    if (header_view.size() != sizeof(header))
+        throw std::runtime_error("Truncated LocalFileHeader");
+    memcpy(&header, header_view.data(), sizeof(header));
+
+    auto data_pos = info_.filepos + 4 + sizeof(header) + header.name_length + header.extra_length;
+
+    // Stored lumps can be read straight from the mapping
+    if (!info_.compressed) {
+        auto data = file.view(data_pos, header.uncompressed);
+        if (data.size() != header.uncompressed)
+            throw std::runtime_error("truncated stored file");
+        return data;
+    }
+
+    return p_cache([&] {
+            auto data = file.view(data_pos, header.compressed);
+            if (data.size() != header.compressed)
+                throw std::runtime_error("truncated deflate stream");
+
+            String bytes(header.uncompressed, 0);
+            z_stream zs {};
+
+            inflateInit2(&zs, -MAX_WBITS);
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+            zs.avail_in = header.compressed;
+            zs.next_out = reinterpret_cast<Bytef*>(&bytes[0]);
+            zs.avail_out = header.uncompressed;
+
+            int code {};
+            do {
+                code = inflate(&zs, Z_SYNC_FLUSH);
+            } while(code == Z_OK && zs.avail_out && zs.avail_in);
+
+            inflateEnd(&zs);
+
+            if (code != Z_OK && code != Z_STREAM_END)
+                throw std::runtime_error("invalid inflate stream");
+
+            if (zs.avail_out != 0)
+                throw std::runtime_error("truncated deflate stream");
+
+            return bytes;
+        });
 }
 
 IDevicePtr wad::zip_loader(StringView name)
 {
-    std::ifstream file(name.to_string(), std::ios::binary);
-    file.exceptions(file.badbit | file.failbit);
-
-    char signature[4];
-    read_into(file, signature);
+    sys::MappedFile file { name };
+    if (!file.is_open())
+        throw std::runtime_error(fmt::format("Could not open '{}'", name));
 
     // The ZIP file either starts with a LocalFileHeader if there are files in it,
     // or EndOfCentralDir if it's empty. Therefore we check both.
-    if (memcmp(signature, _local_file_sig, 4) != 0 && memcmp(signature, _end_of_dir_sig, 4) != 0)
+    auto signature = file.view(0, 4);
+    if (signature.size() != 4)
+        return nullptr;
+
+    if (memcmp(signature.data(), _local_file_sig, 4) != 0 && memcmp(signature.data(), _end_of_dir_sig, 4) != 0)
         return nullptr;
 
     return std::make_unique<ZipDevice>(std::move(file));
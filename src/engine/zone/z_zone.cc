@@ -29,20 +29,27 @@
 
 #include <stdlib.h>
 
+#include <easy/profiler.h>
+
 #include "z_zone.h"
 #include "i_system.h"
 #include "doomdef.h"
 #include "doomstat.h"
+#include "con_console.h"
+#include "g_actions.h"
 
 #define ZONEID    0x1d4a11
+#define ZONEID_FREE 0x1d4a12
 //#define ZONEFILE
 
 typedef struct memblock_s memblock_t;
 
 struct memblock_s {
     int id; // = ZONEID
-    int tag;
+    short tag;
+    short arena;    // true if the block lives in the level arena
     int size;
+    int site;       // index into zonesites
     void **user;
     memblock_t *prev;
     memblock_t *next;
@@ -90,6 +97,193 @@ static void Z_LogPuts(const char *msg) {
 
 static memblock_t *allocated_blocks[PU_MAX];
 
+// Bytes in use by each tag type
+
+static int tag_usage[PU_MAX];
+
+// Live blocks and allocations made, for each tag type
+
+static int tag_blocks[PU_MAX];
+static int tag_allocs[PU_MAX];
+
+//
+// Call site statistics
+//
+// Every allocation is charged to the file and line that made it. Sites are
+// kept in a fixed open-addressed table; once it fills up, new sites are
+// lumped together in slot 0. Live bytes are kept apart for the level tags,
+// since those can be thrown away without walking their chains.
+//
+
+#define ZONE_MAXSITES       2048
+
+typedef struct {
+    const char *file;
+    int line;
+    int live[2];        // live bytes, indexed by Z_IsLevelTag
+    int blocks[2];      // live blocks, indexed by Z_IsLevelTag
+    int allocs;         // allocations made since startup
+    int64 bytes;        // bytes allocated since startup
+} zonesite_t;
+
+static zonesite_t zonesites[ZONE_MAXSITES] = { { "(other)", 0 } };
+static int numzonesites = 1;
+
+static zonestats_t zonestats;
+
+static int zonestattic;     // tic that ticallocs/ticbytes are counting
+static int ticallocs;
+static int ticbytes;
+
+//
+// Level arena
+//
+// Blocks tagged PU_LEVEL or PU_LEVSPEC are carved out of large chunks instead
+// of being malloc'd one at a time. When such a block is freed it goes onto a
+// free list for its size class, so that fixed-size objects such as mobjs and
+// thinkers get recycled. Freeing both level tags releases the chunks at once.
+//
+// Blocks too big for a size class, and blocks that get reallocated, are
+// malloc'd as usual, since the arena could never hand their memory out
+// again before the level ends.
+//
+
+#define ARENA_ALIGN         16
+#define ARENA_ROUND(x)      (((x) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#define ARENA_CHUNKSIZE     (1024 * 1024)
+#define ARENA_NUMCLASSES    64
+
+#define Z_IsLevelTag(tag)   ((tag) == PU_LEVEL || (tag) == PU_LEVSPEC)
+#define Z_ArenaFits(size)   (ARENA_ROUND((int)sizeof(memblock_t) + (size)) / ARENA_ALIGN < ARENA_NUMCLASSES)
+
+typedef struct arenachunk_s arenachunk_t;
+
+struct arenachunk_s {
+    arenachunk_t *next;
+    int size;   // usable bytes after the header
+    int used;
+};
+
+#define ARENA_CHUNKHEADER   ARENA_ROUND((int)sizeof(arenachunk_t))
+
+static struct {
+    arenachunk_t *chunks;       // chunk being bumped from is always first
+    memblock_t *freelist[ARENA_NUMCLASSES];
+    zonearenastats_t stats;
+    int userblocks;             // live blocks with an owner
+    int mallocblocks;           // live malloc'd blocks in a level tag
+    int mallocbytes;            // and their size
+} levelarena;
+
+//
+// Z_FindSite
+//
+
+static int Z_FindSite(const char *file, int line) {
+    unsigned int hash;
+    zonesite_t *site;
+    int i;
+
+    hash = (unsigned int)line * 2654435761u;
+    for(i = 0; file[i]; i++) {
+        hash = (hash ^ (unsigned char)file[i]) * 16777619u;
+    }
+
+    i = 1 + hash % (ZONE_MAXSITES - 1);
+
+    for(;;) {
+        site = &zonesites[i];
+
+        if(site->file == NULL) {
+            break;
+        }
+
+        //
+        // The same __FILE__ may be a different pointer depending on
+        // which translation unit it came from.
+        //
+        if(site->line == line && (site->file == file || !dstrcmp(site->file, file))) {
+            return i;
+        }
+
+        if(++i == ZONE_MAXSITES) {
+            i = 1;
+        }
+    }
+
+    // Keep the probes short; anything past 3/4 full goes to the overflow slot
+    if(numzonesites >= ZONE_MAXSITES * 3 / 4) {
+        return 0;
+    }
+
+    site->file = file;
+    site->line = line;
+    numzonesites++;
+
+    return i;
+}
+
+//
+// Z_CountAlloc
+// Charge an allocation to its site and to the current tic.
+//
+
+static void Z_CountAlloc(memblock_t *block) {
+    zonesite_t *site = &zonesites[block->site];
+
+    if(gametic != zonestattic) {
+        //
+        // Only a full tic's worth gets reported, so a gap of idle tics
+        // reads as zero rather than as the last busy tic.
+        //
+        if(gametic == zonestattic + 1) {
+            zonestats.ticallocs = ticallocs;
+            zonestats.ticbytes = ticbytes;
+        }
+        else {
+            zonestats.ticallocs = zonestats.ticbytes = 0;
+        }
+
+        EASY_VALUE("Zone allocs per tic", zonestats.ticallocs);
+        EASY_VALUE("Zone bytes per tic", zonestats.ticbytes);
+        EASY_VALUE("Zone live bytes", zonestats.live);
+
+        zonestattic = gametic;
+        ticallocs = ticbytes = 0;
+    }
+
+    site->allocs++;
+    site->bytes += block->size;
+
+    tag_allocs[block->tag]++;
+    zonestats.allocs++;
+    ticallocs++;
+    ticbytes += block->size;
+}
+
+//
+// Z_AddUsage
+// Count a block in (dir = 1) or out of (dir = -1) the live totals.
+//
+
+static void Z_AddUsage(memblock_t *block, int dir) {
+    zonesite_t *site = &zonesites[block->site];
+    int level = Z_IsLevelTag(block->tag);
+
+    tag_usage[block->tag] += dir * block->size;
+    tag_blocks[block->tag] += dir;
+
+    site->live[level] += dir * block->size;
+    site->blocks[level] += dir;
+
+    zonestats.live += dir * block->size;
+    zonestats.blocks += dir;
+
+    if(zonestats.live > zonestats.peak) {
+        zonestats.peak = zonestats.live;
+    }
+}
+
 //
 // Z_InsertBlock
 // Add a block into the linked list for its type.
@@ -103,6 +297,19 @@ static void Z_InsertBlock(memblock_t *block) {
     if(block->next != NULL) {
         block->next->prev = block;
     }
+
+    Z_AddUsage(block, 1);
+
+    if(Z_IsLevelTag(block->tag)) {
+        if(block->user != NULL) {
+            levelarena.userblocks++;
+        }
+
+        if(!block->arena) {
+            levelarena.mallocblocks++;
+            levelarena.mallocbytes += block->size;
+        }
+    }
 }
 
 //
@@ -122,6 +329,117 @@ static void Z_RemoveBlock(memblock_t *block) {
     if(block->next != NULL) {
         block->next->prev = block->prev;
     }
+
+    Z_AddUsage(block, -1);
+
+    if(Z_IsLevelTag(block->tag)) {
+        if(block->user != NULL) {
+            levelarena.userblocks--;
+        }
+
+        if(!block->arena) {
+            levelarena.mallocblocks--;
+            levelarena.mallocbytes -= block->size;
+        }
+    }
+}
+
+//
+// Z_ArenaAlloc
+// Get a block from the level arena. Recycled blocks of the same size class
+// are used first. The size must pass Z_ArenaFits.
+//
+
+static memblock_t *Z_ArenaAlloc(int size) {
+    arenachunk_t *chunk;
+    memblock_t *block;
+    int total;
+    int sizeclass;
+
+    total = ARENA_ROUND((int)sizeof(memblock_t) + size);
+    sizeclass = total / ARENA_ALIGN;
+
+    if(sizeclass < ARENA_NUMCLASSES && levelarena.freelist[sizeclass] != NULL) {
+        block = levelarena.freelist[sizeclass];
+        levelarena.freelist[sizeclass] = block->next;
+        levelarena.stats.recycled -= total;
+        return block;
+    }
+
+    chunk = levelarena.chunks;
+
+    if(chunk == NULL || chunk->used + total > chunk->size) {
+        chunk = (arenachunk_t*)malloc(ARENA_CHUNKHEADER + ARENA_CHUNKSIZE);
+        if(chunk == NULL) {
+            return NULL;
+        }
+
+        chunk->size = ARENA_CHUNKSIZE;
+        chunk->used = 0;
+        chunk->next = levelarena.chunks;
+        levelarena.chunks = chunk;
+
+        levelarena.stats.reserved += ARENA_CHUNKSIZE;
+        levelarena.stats.chunks++;
+    }
+
+    block = (memblock_t*)((byte*)chunk + ARENA_CHUNKHEADER + chunk->used);
+    chunk->used += total;
+    levelarena.stats.used += total;
+
+    return block;
+}
+
+//
+// Z_ArenaRelease
+// Put an arena block on the free list for its size class.
+//
+
+static void Z_ArenaRelease(memblock_t *block) {
+    int total;
+    int sizeclass;
+
+    total = ARENA_ROUND((int)sizeof(memblock_t) + block->size);
+    sizeclass = total / ARENA_ALIGN;
+
+    block->id = ZONEID_FREE;
+    block->user = NULL;
+    block->prev = NULL;
+
+    block->next = levelarena.freelist[sizeclass];
+    levelarena.freelist[sizeclass] = block;
+    levelarena.stats.recycled += total;
+}
+
+//
+// Z_ArenaReset
+// Give all of the level arena's memory back to the system.
+//
+
+static void Z_ArenaReset(void) {
+    arenachunk_t *chunk;
+    arenachunk_t *next;
+
+    for(chunk = levelarena.chunks; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+
+    dmemset(&levelarena, 0, sizeof(levelarena));
+}
+
+//
+// Z_FreeBlock
+// Give a block that has been unlinked back to wherever it came from.
+//
+
+static void Z_FreeBlock(memblock_t *block) {
+    if(block->arena) {
+        Z_ArenaRelease(block);
+    }
+    else {
+        free(block);
+    }
 }
 
 //
@@ -130,6 +448,9 @@ static void Z_RemoveBlock(memblock_t *block) {
 
 void Z_Init(void) {
     dmemset(allocated_blocks, 0, sizeof(allocated_blocks));
+    dmemset(tag_usage, 0, sizeof(tag_usage));
+    dmemset(tag_blocks, 0, sizeof(tag_blocks));
+    Z_ArenaReset();
 
 #ifdef ZONEFILE
     atexit(Z_CloseLogFile); // exit handler
@@ -160,8 +481,8 @@ void (Z_Free)(void* ptr, const char *file, int line) {
 
     Z_RemoveBlock(block);
 
-    // Free back to system
-    free(block);
+    // Free back to system, or to the level arena
+    Z_FreeBlock(block);
 
 #ifdef ZONEFILE
     Z_LogPrintf("* Z_Free(ptr=%p, file=%s:%d)\n", ptr, file, line);
@@ -237,6 +558,7 @@ void *(Z_Malloc)(int size, int tag, void *user, const char *file, int line) {
     memblock_t *newblock;
     unsigned char *data;
     void *result;
+    int arena;
 
     if(tag < 0 || tag >= PU_MAX) {
         I_Error("Z_Malloc: tag out of range: %i (%s:%d)", tag, file, line);
@@ -246,11 +568,19 @@ void *(Z_Malloc)(int size, int tag, void *user, const char *file, int line) {
         I_Error("Z_Malloc: an owner is required for purgable blocks (%s:%d)", file, line);
     }
 
-    // Malloc a block of the required size
+    // Malloc a block of the required size, or take it from the level arena
 
     newblock = NULL;
+    arena = Z_IsLevelTag(tag) && Z_ArenaFits(size);
 
-    if(!(newblock = (memblock_t*)malloc(sizeof(memblock_t) + size))) {
+    if(arena) {
+        if(!(newblock = Z_ArenaAlloc(size))) {
+            if(Z_ClearCache(sizeof(memblock_t) + size)) {
+                newblock = Z_ArenaAlloc(size);
+            }
+        }
+    }
+    else if(!(newblock = (memblock_t*)malloc(sizeof(memblock_t) + size))) {
         if(Z_ClearCache(sizeof(memblock_t) + size)) {
             newblock = (memblock_t*)malloc(sizeof(memblock_t) + size);
         }
@@ -262,12 +592,15 @@ void *(Z_Malloc)(int size, int tag, void *user, const char *file, int line) {
 
     // Hook into the linked list for this tag type
 
+    newblock->arena = arena;
     newblock->tag = tag;
     newblock->id = ZONEID;
     newblock->user = (void**) user;
     newblock->size = size;
+    newblock->site = Z_FindSite(file, line);
 
     Z_InsertBlock(newblock);
+    Z_CountAlloc(newblock);
 
     data = (unsigned char*)newblock;
     result = data + sizeof(memblock_t);
@@ -330,7 +663,24 @@ void *(Z_Realloc)(void *ptr, int size, int tag, void *user, const char *file, in
         *block->user = NULL;
     }
 
-    if(!(newblock = (memblock_t*)realloc(block, sizeof(memblock_t) + size))) {
+    if(block->arena) {
+        //
+        // Arena blocks can't grow in place. A block that is reallocated
+        // once tends to be again, so it moves to a malloc'd block which
+        // later calls can grow, and the arena block is recycled.
+        //
+        if(!(newblock = (memblock_t*)malloc(sizeof(memblock_t) + size))) {
+            if(Z_ClearCache(sizeof(memblock_t) + size)) {
+                newblock = (memblock_t*)malloc(sizeof(memblock_t) + size);
+            }
+        }
+
+        if(newblock) {
+            dmemcpy((byte*)newblock + sizeof(memblock_t), ptr, MIN(origsize, size));
+            Z_ArenaRelease(block);
+        }
+    }
+    else if(!(newblock = (memblock_t*)realloc(block, sizeof(memblock_t) + size))) {
         if(Z_ClearCache(sizeof(memblock_t) + size)) {
             newblock = (memblock_t*)realloc(block, sizeof(memblock_t) + size);
         }
@@ -340,12 +690,15 @@ void *(Z_Realloc)(void *ptr, int size, int tag, void *user, const char *file, in
         I_Error("Z_Realloc: failed on allocation of %u bytes (%s:%d)", size, file, line);
     }
 
+    newblock->arena = false;
     newblock->tag = tag;
     newblock->id = ZONEID;
     newblock->user = (void**) user;
     newblock->size = size;
+    newblock->site = Z_FindSite(file, line);
 
     Z_InsertBlock(newblock);
+    Z_CountAlloc(newblock);
 
     data = (unsigned char*)newblock;
     result = data + sizeof(memblock_t);
@@ -373,11 +726,30 @@ void *(Z_Realloc)(void *ptr, int size, int tag, void *user, const char *file, in
 
 void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line) {
     int i;
+    dboolean resetarena;
+
+    //
+    // If both level tags go away, the arena can be dropped as a whole.
+    // The chains only need to be walked if a block has an owner to
+    // clear, or if it was malloc'd rather than taken from the arena.
+    //
+    resetarena = (lowtag <= PU_LEVEL && hightag >= PU_LEVSPEC);
 
     for(i = lowtag; i <= hightag; ++i) {
         memblock_t *block;
         memblock_t *next;
 
+        zonestats.live -= tag_usage[i];
+        zonestats.blocks -= tag_blocks[i];
+
+        if(resetarena && Z_IsLevelTag(i) &&
+            levelarena.userblocks == 0 && levelarena.mallocblocks == 0) {
+            allocated_blocks[i] = NULL;
+            tag_usage[i] = 0;
+            tag_blocks[i] = 0;
+            continue;
+        }
+
         // Free all in this chain
 
         for(block = allocated_blocks[i]; block != NULL;) {
@@ -393,7 +765,18 @@ void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line) {
                 *block->user = NULL;
             }
 
-            free(block);
+            // Level sites are cleared in one go below when the arena is reset
+            if(!(resetarena && Z_IsLevelTag(i))) {
+                zonesites[block->site].live[Z_IsLevelTag(i)] -= block->size;
+                zonesites[block->site].blocks[Z_IsLevelTag(i)]--;
+            }
+
+            if(!block->arena) {
+                free(block);
+            }
+            else if(!resetarena) {
+                Z_ArenaRelease(block);
+            }
 
             // Jump to the next in the chain
 
@@ -402,6 +785,36 @@ void (Z_FreeTags)(int lowtag, int hightag, const char *file, int line) {
 
         // This chain is empty now
         allocated_blocks[i] = NULL;
+        tag_usage[i] = 0;
+        tag_blocks[i] = 0;
+    }
+
+    if(resetarena) {
+        Z_ArenaReset();
+
+        for(i = 0; i < ZONE_MAXSITES; i++) {
+            zonesites[i].live[1] = 0;
+            zonesites[i].blocks[1] = 0;
+        }
+    }
+    else {
+        // Recount what's left in the level tags
+        levelarena.userblocks = levelarena.mallocblocks = levelarena.mallocbytes = 0;
+
+        for(i = PU_LEVEL; i <= PU_LEVSPEC; ++i) {
+            memblock_t *block;
+
+            for(block = allocated_blocks[i]; block != NULL; block = block->next) {
+                if(block->user != NULL) {
+                    levelarena.userblocks++;
+                }
+
+                if(!block->arena) {
+                    levelarena.mallocblocks++;
+                    levelarena.mallocbytes += block->size;
+                }
+            }
+        }
     }
 
 #ifdef ZONEFILE
@@ -553,6 +966,10 @@ void (Z_ChangeTag)(void *ptr, int tag, const char *file, int line) {
         I_Error("Z_ChangeTag: an owner is required for purgable blocks (%s:%d)", file, line);
     }
 
+    if(block->arena && !Z_IsLevelTag(tag)) {
+        I_Error("Z_ChangeTag: level blocks can only be moved to another level tag (%s:%d)", file, line);
+    }
+
     //
     // Remove the block from its current list, and rehook it into
     // its new list.
@@ -572,35 +989,151 @@ void (Z_ChangeTag)(void *ptr, int tag, const char *file, int line) {
 //
 
 int Z_TagUsage(int tag) {
-    int bytes = 0;
-    memblock_t *block;
-
     if(tag < 0 || tag >= PU_MAX) {
         I_Error("Z_TagUsage: tag out of range: %i", tag);
     }
 
-    for(block = allocated_blocks[tag]; block != NULL; block = block->next) {
-        bytes += block->size;
-    }
-
-    return bytes;
+    return tag_usage[tag];
 }
 
 //
 // Z_FreeMemory
 //
+// Returns the number of bytes held by the zone. Arena blocks in the level
+// tags are counted by what the arena has reserved rather than by their
+// live blocks.
+//
 
 int Z_FreeMemory(void) {
     int bytes = 0;
     int i;
-    memblock_t *block;
 
     for(i = 0; i < PU_MAX; i++) {
-        for(block = allocated_blocks[i]; block != NULL; block = block->next) {
-            bytes += block->size;
+        if(Z_IsLevelTag(i)) {
+            continue;
+        }
+
+        bytes += tag_usage[i];
+    }
+
+    return bytes + levelarena.stats.reserved + levelarena.mallocbytes;
+}
+
+//
+// Z_ArenaStats
+//
+
+void Z_ArenaStats(zonearenastats_t *stats) {
+    *stats = levelarena.stats;
+}
+
+//
+// Z_Stats
+//
+
+void Z_Stats(zonestats_t *stats) {
+    *stats = zonestats;
+
+    // Nothing has been allocated since the last full tic
+    if(gametic != zonestattic) {
+        stats->ticallocs = stats->ticbytes = 0;
+    }
+}
+
+//
+// Z_CompareSites
+// Most live bytes first, then most allocations.
+//
+
+static int Z_CompareSites(const void *a, const void *b) {
+    const zonesite_t *sa = *(const zonesite_t**)a;
+    const zonesite_t *sb = *(const zonesite_t**)b;
+    int la = sa->live[0] + sa->live[1];
+    int lb = sb->live[0] + sb->live[1];
+
+    if(la != lb) {
+        return la < lb ? 1 : -1;
+    }
+
+    if(sa->allocs != sb->allocs) {
+        return sa->allocs < sb->allocs ? 1 : -1;
+    }
+
+    return 0;
+}
+
+//
+// CMD_ZoneStats
+// Print the zone totals, per-tag usage and the top call sites by live bytes.
+//
+
+static CMD(ZoneStats) {
+    static const char *tagnames[PU_MAX] = {
+        "static", "maplump", "auto", "audio", "level", "levspec", "cache"
+    };
+    static zonesite_t *sorted[ZONE_MAXSITES];
+    zonestats_t stats;
+    const char *file;
+    const char *p;
+    int count;
+    int top;
+    int i;
+
+    top = param[0] ? datoi(param[0]) : 10;
+    if(top <= 0) {
+        top = 10;
+    }
+
+    Z_Stats(&stats);
+
+    CON_Printf(WHITE, "Zone: %i kb live in %i blocks, peak %i kb\n",
+               stats.live >> 10, stats.blocks, stats.peak >> 10);
+    CON_Printf(WHITE, "Last tic: %i allocs, %i kb; %i allocs total\n",
+               stats.ticallocs, stats.ticbytes >> 10, stats.allocs);
+
+    for(i = 0; i < PU_MAX; i++) {
+        CON_Printf(WHITE, " %-8s %8i kb %8i blocks %10i allocs\n",
+                   tagnames[i], tag_usage[i] >> 10, tag_blocks[i], tag_allocs[i]);
+    }
+
+    count = 0;
+    for(i = 0; i < ZONE_MAXSITES; i++) {
+        if(zonesites[i].allocs != 0) {
+            sorted[count++] = &zonesites[i];
         }
     }
 
-    return bytes;
+    qsort(sorted, count, sizeof(zonesite_t*), Z_CompareSites);
+
+    if(top > count) {
+        top = count;
+    }
+
+    CON_Printf(WHITE, "Top %i of %i call sites:\n", top, count);
+
+    for(i = 0; i < top; i++) {
+        zonesite_t *site = sorted[i];
+
+        // Just the file name, the full path is mostly noise
+        file = site->file;
+        for(p = file; *p; p++) {
+            if(*p == '/' || *p == '\\') {
+                file = p + 1;
+            }
+        }
+
+        CON_Printf(WHITE, " %s:%i: %i kb in %i blocks, %i allocs, %i kb total\n",
+                   file, site->line,
+                   (site->live[0] + site->live[1]) >> 10,
+                   site->blocks[0] + site->blocks[1],
+                   site->allocs, (int)(site->bytes >> 10));
+    }
 }
 
+//
+// Z_RegisterCommands
+//
+
+void Z_RegisterCommands(void) {
+    G_AddCommand("zonestats", CMD_ZoneStats, 0);
+}
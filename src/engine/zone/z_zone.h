@@ -91,8 +91,29 @@ void (Z_Touch)(void *ptr, const char *, int);
 
 #define strdup(s)           (Z_Strdup) (s, PU_STATIC,0,__FILE__,__LINE__)
 
+// Level arena statistics, in bytes
+typedef struct {
+    int reserved;   // memory taken from the system
+    int used;       // memory handed out, including block headers
+    int recycled;   // freed blocks waiting to be reused
+    int chunks;
+} zonearenastats_t;
+
+// Allocation statistics
+typedef struct {
+    int live;       // bytes in live blocks
+    int peak;       // highest that live has been
+    int blocks;     // number of live blocks
+    int ticallocs;  // allocations made during the last full tic
+    int ticbytes;   // bytes allocated during the last full tic
+    int allocs;     // allocations made since startup
+} zonestats_t;
+
 int Z_TagUsage(int tag);
 int Z_FreeMemory(void);
+void Z_ArenaStats(zonearenastats_t *stats);
+void Z_Stats(zonestats_t *stats);
+void Z_RegisterCommands(void);
 
 #endif
 
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+
+#include "doomdef.h"
+#include "z_zone.h"
+
+namespace {
+  struct vertex_list {
+      byte data[32];
+  };
+
+  /* Append one element at a time, the way DL_AddVertexList grows its list */
+  vertex_list* grow_list(vertex_list* list, int& max, int count)
+  {
+      while (max < count) {
+          max++;
+          list = static_cast<vertex_list*>(Z_Realloc(list, max * sizeof(vertex_list), PU_LEVEL, NULL));
+      }
+
+      return list;
+  }
+}
+
+TEST(ZoneArena, realloc_reuses_memory)
+{
+    Z_Init();
+
+    int base = Z_FreeMemory();
+    int max = 0;
+    auto list = grow_list(nullptr, max, 4000);
+
+    // Leaving every old copy in the arena would hold about 256 MB
+    ASSERT_EQ(4000 * static_cast<int>(sizeof(vertex_list)), Z_TagUsage(PU_LEVEL));
+    ASSERT_LT(Z_FreeMemory() - base, 2 * 1024 * 1024);
+
+    Z_Free(list);
+    Z_FreeTags(PU_LEVEL, PU_LEVSPEC);
+}
+
+TEST(ZoneArena, level_usage_flat_over_frames)
+{
+    Z_Init();
+
+    int max = 0;
+    vertex_list* list = nullptr;
+    int usage = -1;
+    int memory = -1;
+
+    for (int frame = 0; frame < 100; frame++) {
+        // The first frames see more of the level, then it settles
+        list = grow_list(list, max, frame < 10 ? 200 * (frame + 1) : 2000);
+
+        // Short lived level allocations, as in a busy frame
+        for (int i = 0; i < 50; i++)
+            Z_Free(Z_Malloc(16 * (i + 1), PU_LEVEL, NULL));
+
+        if (frame == 10) {
+            usage = Z_TagUsage(PU_LEVEL);
+            memory = Z_FreeMemory();
+        }
+        else if (frame > 10) {
+            ASSERT_EQ(usage, Z_TagUsage(PU_LEVEL));
+            ASSERT_EQ(memory, Z_FreeMemory());
+        }
+    }
+
+    Z_FreeTags(PU_LEVEL, PU_LEVSPEC);
+    ASSERT_EQ(0, Z_TagUsage(PU_LEVEL));
+}
+
+TEST(ZoneArena, large_blocks_are_not_kept)
+{
+    Z_Init();
+
+    int base = Z_FreeMemory();
+
+    // Too big for any size class, so nothing could ever reuse them
+    for (int i = 0; i < 1000; i++)
+        Z_Free(Z_Malloc(64 * 1024, PU_LEVEL, NULL));
+
+    ASSERT_EQ(0, Z_TagUsage(PU_LEVEL));
+    ASSERT_EQ(base, Z_FreeMemory());
+}